@@ -13,6 +13,10 @@
 // - Vertex and color attributes are interleaved for better memory usage.
 // - Modern OpenGL (Core Profile) is used with Vertex Array Objects (VAOs)
 //   for efficient rendering.
+// - Culling, the scene graph, animation, the render queue, the mesh pool and
+//   the software rasterizer live in their own headers, each describing its
+//   design. --software, --present, --fps, --profile, --meshes and --direct
+//   select between them.
 //
 // Time Complexity:
 // - Creating the mesh (pyramid) has a time complexity of O(1) since the
@@ -24,7 +28,10 @@
 // - Initialize GLFW, GLEW, and create a window.
 // - Create a pyramid mesh with positions and colors, using VAOs and VBOs.
 // - Compile and link shader programs for vertex and fragment shaders.
-// - The main loop continuously renders the rotating pyramid.
+// - A simulation thread advances the animation clock at a fixed 60 Hz and
+//   publishes snapshots through a lock-free triple buffer.
+// - The main loop continuously renders the rotating pyramid, interpolating
+//   between the two most recent simulation ticks.
 // - Pressing ESC closes the window.
 //
 // Instructions:
@@ -45,7 +52,24 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
-#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "scene_culling.h"
+#include "scene_graph.h"
+#include "animation.h"
+#include "soft_rasterizer.h"
+#include "dynamic_resolution.h"
+#include "gpu_profiler.h"
+#include "gl_state_cache.h"
+#include "render_queue.h"
+#include "mesh_pool.h"
+#include "triple_buffer.h"
+#include "frame_pacer.h"
+#include "thread_pool.h"
 
 using namespace std;
 
@@ -57,16 +81,82 @@ namespace {
     const char* const WINDOW_TITLE = "Unique Chambers";
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
+    const float CAMERA_NEAR = 0.1f;
+    const float CAMERA_FAR = 100.0f;
 
     struct GLMesh {
         GLuint vao;
         GLuint vbos[2];
         GLuint nIndices;
+        BoundingBox bounds;  // local-space box computed from the vertex data
+        const GLfloat* vertices;  // CPU copy, for the software rasterizer
+        int poolMesh;        // index in gMeshPool when drawing indirect
+    };
+
+    // One drawable instance of a mesh in the scene. Its model matrix is the
+    // world matrix of its scene graph node.
+    struct SceneObject {
+        GLMesh* mesh;
+        int node;
+    };
+
+    // Uniform locations, looked up once when the program is linked
+    struct ProgramUniforms {
+        GLint model;
+        GLint view;
+        GLint projection;
     };
 
     GLFWwindow* gWindow = nullptr;
-    GLMesh gMesh;
     GLuint gProgramId;
+    ProgramUniforms gProgramUniforms;
+    GLStateCache gGLState;
+
+    // Draws for the frame in key order. Scenes with more visible objects
+    // than a grain are queued from every thread of the pool.
+    const int QUEUE_SUBMIT_GRAIN = 1024;
+    RenderQueue gRenderQueue;
+    ThreadPool gSubmitPool;
+
+    // Scene objects, the BVH over their world bounds, and the indices that
+    // survived culling this frame. Use --objects N to lay out a grid of N.
+    vector<SceneObject> gObjects;
+    SceneGraph gSceneGraph;
+    vector<int> gObjectOfNode;  // scene graph node id -> gObjects index, -1 if none
+    AnimationSampler gAnimation;
+    vector<int> gRotationTrack; // gObjects index -> rotation track
+    SceneBVH gSceneBVH;
+    vector<int> gVisibleObjects;
+    int gObjectCount = 1;
+
+    // The animation clock is simulated on its own thread at a fixed rate
+    // and handed to the render loop through a triple buffer.
+    const double SIM_TICK = 1.0 / 60.0;
+
+    struct SceneSnapshot {
+        float prevTime;    // animation time at the previous tick
+        float time;        // animation time at the current tick
+        double tickTime;   // when the current tick was simulated
+    };
+
+    TripleBuffer<SceneSnapshot> gSnapshots;
+    atomic<bool> gSimRunning(true);
+
+    // Presentation mode; the loop used to run unthrottled
+    FramePacer gFramePacer(PRESENT_UNCAPPED);
+    double gTargetFps = 60.0;
+    double gBackgroundFps = 10.0;
+
+    // Offscreen target and the controller that sizes it from frame times
+    bool gDynamicResolution = true;
+    ResolutionController gResolution;
+    RenderTarget gRenderTarget;
+
+    // Pass timings for --profile N; the scopes stay -1 (no-ops) without it
+    FrameProfiler gProfiler;
+    bool gProfiling = false;
+    int gProfileInterval = 0;
+    int gScopeFrame = -1, gScopeUpdate = -1, gScopeClear = -1, gScopeDraw = -1, gScopeBlit = -1, gScopeSwap = -1;
 
     // Vertex Shader Source Code
     const GLchar* vertexShaderSource = GLSL(440,
@@ -109,42 +199,228 @@ namespace {
     //For each face of the pyramid, a different color is selected from the colors[] array based on the currentColorIndex.
 
     int currentColorIndex = 0;
+
+    // Pyramid geometry, shared by the OpenGL path (UCreateMesh) and the
+    // software rasterizer
+    const GLuint floatsPerVertex = 3;
+
+    const GLfloat pyramidVertices[] = {
+        0.5f,  0.5f, 0.0f,
+        0.5f, -0.5f, 0.0f,
+       -0.5f, -0.5f, 0.0f,
+       -0.5f,  0.5f, 0.0f,
+        0.0f,  0.0f, 1.0f,
+    };
+
+    // One RGBA per vertex for the OpenGL path: the four base corners and
+    // the apex take the first five of colors[]
+    const GLfloat pyramidColors[] = {
+        1.0f, 0.0f, 0.0f, 1.0f,
+        0.0f, 1.0f, 0.0f, 1.0f,
+        0.0f, 0.0f, 1.0f, 1.0f,
+        1.0f, 1.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 1.0f, 1.0f,
+    };
+
+    const GLushort pyramidIndices[] = {
+        0, 1, 2,
+        0, 3, 2,
+        0, 1, 4,
+        1, 2, 4,
+        2, 3, 4,
+        3, 0, 4,
+    };
+
+    // --software N renders N frames on the CPU instead of opening a window
+    int gSoftwareFrames = 0;
+
+    // Shapes of the scene (--meshes N): shape 0 is pyramidVertices, the
+    // rest vary its base size and height. Objects take them in turn.
+    int gMeshCount = 1;
+    vector<vector<GLfloat> > gMeshShapes;
+    vector<GLMesh> gMeshes;
+
+    // All shapes in shared buffers, drawn with one multi-draw-indirect
+    // call per frame; --direct (or a pre-4.3 context) draws per object
+    bool gIndirect = true;
+    MeshPool gMeshPool;
+    GLuint gIndirectProgramId;
+    ProgramUniforms gIndirectUniforms;
+
+    // The model matrix comes from the per-draw instanced attribute
+    const GLchar* indirectVertexShaderSource = GLSL(440,
+        layout(location = 0) in vec3 position;
+    layout(location = 1) in vec4 color;
+    layout(location = 2) in mat4 model;
+    out vec4 vertexColor;
+
+    uniform mat4 view;
+    uniform mat4 projection;
+
+    void main()
+    {
+        gl_Position = projection * view * model * vec4(position, 1.0f);
+        vertexColor = color;
+    }
+    );
 }
 
+void UParseArguments(int argc, char* argv[]);
 bool UInitialize(int, char* [], GLFWwindow** window);
 void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
-void UCreateMesh(GLMesh& mesh);
+void UCreateMeshShapes(int count);
+void UDescribeMesh(GLMesh& mesh, const GLfloat* vertices);
+void UCreateMesh(GLMesh& mesh, const GLfloat* vertices);
 void UDestroyMesh(GLMesh& mesh);
+void UCreateScene(vector<GLMesh>& meshes, int count);
+void UUpdateScene(float time);
+void USimulationThread();
+void UCameraMatrices(glm::mat4& view, glm::mat4& projection);
+void UQueueVisibleObjects(const glm::mat4& view, GLint modelLoc);
+void UReportResolution();
 void URender();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+int URenderSoftware(int frames);
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId,
+                          ProgramUniforms& uniforms);
 void UDestroyShaderProgram(GLuint programId);
 
 int main(int argc, char* argv[])
 {
+    UParseArguments(argc, argv);
+    if (gSoftwareFrames > 0)
+        return URenderSoftware(gSoftwareFrames);
+
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
-    UCreateMesh(gMesh);
+    if (gIndirect && !GLEW_VERSION_4_3 && !(GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance))
+    {
+        cout << "Multi-draw indirect not supported, drawing objects one by one" << endl;
+        gIndirect = false;
+    }
+
+    // Each shape gets its own VAO, or a range of the shared buffers
+    UCreateMeshShapes(gMeshCount);
+    gMeshes.resize(gMeshCount);
+    for (int i = 0; i < gMeshCount; i++)
+        UCreateMesh(gMeshes[i], gMeshShapes[i].data());
+    if (gIndirect)
+        gMeshPool.Upload(gGLState);
+    UCreateScene(gMeshes, gObjectCount);
 
-    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId))
+    if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId, gProgramUniforms))
         return EXIT_FAILURE;
+    if (gIndirect && !UCreateShaderProgram(indirectVertexShaderSource, fragmentShaderSource, gIndirectProgramId,
+                                           gIndirectUniforms))
+        return EXIT_FAILURE;
+
+    gGLState.ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    if (gProfiling)
+    {
+        gScopeFrame = gProfiler.AddScope("frame");
+        gScopeUpdate = gProfiler.AddScope("update", false);
+        gScopeClear = gProfiler.AddScope("clear");
+        gScopeDraw = gProfiler.AddScope("draw");
+        gScopeBlit = gProfiler.AddScope("blit");
+        gScopeSwap = gProfiler.AddScope("swap");
+        if (!gProfiler.Create())
+            cout << "Timer queries not supported, profiling the CPU side only" << endl;
+    }
+
+    thread simulation(USimulationThread);
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    gFramePacer.SetRates(gTargetFps, gBackgroundFps);
+    glfwSwapInterval(gFramePacer.SwapInterval());
+    gResolution.SetTarget(1.0 / gTargetFps);
 
     while (!glfwWindowShouldClose(gWindow))
     {
+        // Low-latency mode waits here instead of before the swap. The scene
+        // animates on its own thread and the only input is Escape, so what
+        // it shortens is the time from reading the newest snapshot in
+        // URender to presenting it.
+        gFramePacer.WaitBeforeInput(glfwGetWindowAttrib(gWindow, GLFW_FOCUSED) != 0);
+        glfwPollEvents();
         UProcessInput(gWindow);
         URender();
-        glfwPollEvents();
+        gFramePacer.FrameDone();
+
+        if (gProfiling && gProfileInterval > 0 && gProfiler.ResolvedFrames() > 0 &&
+            gProfiler.ResolvedFrames() % gProfileInterval == 0)
+            gProfiler.PrintLatest(cout);
+
+        // The frame's cost without the pacer's waits drives the scale
+        if (gDynamicResolution)
+            gResolution.Update(gFramePacer.LastBusySeconds());
     }
 
-    UDestroyMesh(gMesh);
+    gSimRunning.store(false);
+    simulation.join();
+    gFramePacer.Report(cout);
+    gGLState.Report(cout);
+    if (gIndirect)
+        gMeshPool.Report(cout);
+    else
+        gRenderQueue.Report(cout);
+    if (gDynamicResolution)
+        UReportResolution();
+    if (gProfiling)
+        gProfiler.Report(cout);
+
+    gProfiler.Destroy();
+    gRenderTarget.Destroy();
+    for (size_t i = 0; i < gMeshes.size(); i++)
+        UDestroyMesh(gMeshes[i]);
+    gMeshPool.Destroy();
     UDestroyShaderProgram(gProgramId);
+    if (gIndirect)
+        UDestroyShaderProgram(gIndirectProgramId);
 
     exit(EXIT_SUCCESS);
 }
 
+// Command line: --objects N (grid of N pyramids), --software N (render N
+// frames with the CPU rasterizer and report throughput), --present MODE,
+// --fps HZ, --background-fps HZ (frame pacing, see frame_pacer.h),
+// --fixed-resolution (always render at the window size), --profile N
+// (pass timings, the latest frame every N frames; 0 for the summary only),
+// --meshes N (distinct pyramid shapes), --direct (no multi-draw indirect)
+void UParseArguments(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; i++)
+    {
+        PRESENTMODE mode;
+        if (strcmp(argv[i], "--objects") == 0 && i + 1 < argc)
+            gObjectCount = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--software") == 0 && i + 1 < argc)
+            gSoftwareFrames = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--present") == 0 && i + 1 < argc)
+        {
+            if (FramePacer::ParseMode(argv[++i], mode))
+                gFramePacer.SetMode(mode);
+            else
+                cout << "Unknown presentation mode " << argv[i] << ", keeping " << FramePacer::ModeName(gFramePacer.Mode()) << endl;
+        }
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc)
+            gTargetFps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--background-fps") == 0 && i + 1 < argc)
+            gBackgroundFps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--fixed-resolution") == 0)
+            gDynamicResolution = false;
+        else if (strcmp(argv[i], "--meshes") == 0 && i + 1 < argc)
+            gMeshCount = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--direct") == 0)
+            gIndirect = false;
+        else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+        {
+            gProfiling = true;
+            gProfileInterval = max(0, atoi(argv[++i]));
+        }
+    }
+}
+
 bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 {
     glfwInit();
@@ -191,96 +467,414 @@ void UResizeWindow(GLFWwindow* window, int width, int height)
 // Render frame function
 void URender()
 {
+    if (gProfiling)
+        gProfiler.BeginFrame();
+    gProfiler.BeginScope(gScopeFrame);
+    gGLState.BeginFrame();
+
+    // With dynamic resolution, draw into the offscreen target at the
+    // controller's scale; it is (re)allocated when the window size changes
+    int windowWidth, windowHeight;
+    glfwGetFramebufferSize(gWindow, &windowWidth, &windowHeight);
+    if (gDynamicResolution && windowWidth > 0 && windowHeight > 0 &&
+        (gRenderTarget.Width() != windowWidth || gRenderTarget.Height() != windowHeight) &&
+        !gRenderTarget.Create(windowWidth, windowHeight))
+    {
+        cout << "Offscreen target incomplete, rendering at full resolution" << endl;
+        gDynamicResolution = false;
+    }
+    bool offscreen = gDynamicResolution && gRenderTarget.Valid();
+    if (offscreen)
+    {
+        int renderWidth, renderHeight;
+        gResolution.RenderSize(windowWidth, windowHeight, renderWidth, renderHeight);
+        gRenderTarget.Begin(renderWidth, renderHeight);
+    }
+
     // Enable depth testing for 3D rendering
-    glEnable(GL_DEPTH_TEST);
+    gGLState.Enable(GL_DEPTH_TEST);
 
     // Set clear color (background color) to white
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    gGLState.ClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
     // Clear the color buffer and depth buffer
+    gProfiler.BeginScope(gScopeClear);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gProfiler.EndScope(gScopeClear);
+
+    // Interpolate the animation clock between the last two simulated ticks,
+    // then animate every object and refit the BVH around its new bounds
+    gProfiler.BeginScope(gScopeUpdate);
+    gSnapshots.Consume();
+    const SceneSnapshot& snapshot = gSnapshots.ReadSlot();
+    float alpha = (float)((glfwGetTime() - snapshot.tickTime) / SIM_TICK);
+    alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+    UUpdateScene(snapshot.prevTime + (snapshot.time - snapshot.prevTime) * alpha);
+
+    // View and projection matrices
+    glm::mat4 view, projection;
+    UCameraMatrices(view, projection);
+
+    // Only objects inside the view frustum are submitted
+    gVisibleObjects.clear();
+    gSceneBVH.Cull(UExtractFrustum(projection * view), gVisibleObjects);
+
+    auto setupProgram = [&view, &projection](GLuint program)
+    {
+        const ProgramUniforms& uniforms = program == gProgramId ? gProgramUniforms : gIndirectUniforms;
+        glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, glm::value_ptr(view));
+        glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, glm::value_ptr(projection));
+    };
+    if (gIndirect)
+    {
+        // One indirect command per visible object, all in one call
+        gMeshPool.BeginFrame();
+        for (size_t i = 0; i < gVisibleObjects.size(); i++)
+        {
+            const SceneObject& object = gObjects[gVisibleObjects[i]];
+            gMeshPool.AddDraw(object.mesh->poolMesh, gSceneGraph.WorldMatrix(object.node));
+        }
+        gProfiler.EndScope(gScopeUpdate);
+
+        gProfiler.BeginScope(gScopeDraw);
+        gGLState.UseProgram(gIndirectProgramId);
+        setupProgram(gIndirectProgramId);
+        gMeshPool.Draw(gGLState);
+    }
+    else
+    {
+        // Queue the visible objects and put them in key order
+        gRenderQueue.Reset();
+        UQueueVisibleObjects(view, gProgramUniforms.model);
+        gRenderQueue.Sort();
+        gProfiler.EndScope(gScopeUpdate);
+
+        // Draw them; each program gets the view and projection matrices
+        // when its group starts
+        gProfiler.BeginScope(gScopeDraw);
+        gRenderQueue.Execute(gGLState, setupProgram);
+    }
+
+    // The VAO stays bound: all VAO binds go through gGLState, so there is
+    // nothing for a stale binding to break
+    gProfiler.EndScope(gScopeDraw);
+
+    // Stretch the offscreen image over the window
+    if (offscreen)
+    {
+        gProfiler.BeginScope(gScopeBlit);
+        gRenderTarget.BlitToWindow(windowWidth, windowHeight);
+        gProfiler.EndScope(gScopeBlit);
+    }
 
-    // Rotation and translation matrices for model, view, and projection
-    glm::mat4 model = glm::rotate((float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
-    glm::mat4 view = glm::translate(glm::vec3(0.0f, 0.0f, -5.0f)) *
+    // Swap the front and back buffers to display the rendered image, when
+    // the presentation mode says so
+    gFramePacer.WaitBeforeSwap();
+    gProfiler.BeginScope(gScopeSwap);
+    glfwSwapBuffers(gWindow);
+    gProfiler.EndScope(gScopeSwap);
+    gProfiler.EndScope(gScopeFrame);
+}
+
+// Camera shared by the OpenGL and software render paths
+void UCameraMatrices(glm::mat4& view, glm::mat4& projection)
+{
+    view = glm::translate(glm::vec3(0.0f, 0.0f, -5.0f)) *
         glm::rotate(-glm::radians(45.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f),
+    projection = glm::perspective(glm::radians(45.0f),
         (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT,
-        0.1f,
-        100.0f);
+        CAMERA_NEAR,
+        CAMERA_FAR);
+}
 
-    // Use the shader program
-    glUseProgram(gProgramId);
+// Turn every visible object into a draw item keyed by program, VAO and
+// the view depth of its origin, so each state group draws front to back
+void UQueueVisibleObjects(const glm::mat4& view, GLint modelLoc)
+{
+    auto submit = [&view, modelLoc](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const SceneObject& object = gObjects[gVisibleObjects[i]];
+            const GLfloat* model = gSceneGraph.WorldMatrix(object.node);
+            float depth = -(view[0][2] * model[12] + view[1][2] * model[13] + view[2][2] * model[14] + view[3][2]);
+
+            DrawItem item;
+            item.program = gProgramId;
+            item.vertexArray = object.mesh->vao;
+            item.indexCount = object.mesh->nIndices;
+            item.indexType = GL_UNSIGNED_SHORT;
+            item.modelLocation = modelLoc;
+            item.model = model;
+            gRenderQueue.Submit(MakeSortKey(0, item.program, item.vertexArray, 0,
+                (depth - CAMERA_NEAR) / (CAMERA_FAR - CAMERA_NEAR)), item);
+        }
+    };
+    gSubmitPool.ParallelFor((int)gVisibleObjects.size(), QUEUE_SUBMIT_GRAIN, submit);
+}
 
-    // Pass transformation matrices to the shader
-    glUniformMatrix4fv(glGetUniformLocation(gProgramId, "model"), 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(glGetUniformLocation(gProgramId, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(gProgramId, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+// Render the scene on the CPU without creating a window or GL context.
+// Each frame advances the animation by one simulation tick, goes through
+// the same BVH culling as URender, and is rasterized in parallel tiles.
+int URenderSoftware(int frames)
+{
+    UCreateMeshShapes(gMeshCount);
+    gMeshes.resize(gMeshCount);
+    for (int i = 0; i < gMeshCount; i++)
+        UDescribeMesh(gMeshes[i], gMeshShapes[i].data());
+    UCreateScene(gMeshes, gObjectCount);
+
+    glm::mat4 view, projection;
+    UCameraMatrices(view, projection);
+    glm::mat4 viewProjection = projection * view;
+    Frustum frustum = UExtractFrustum(viewProjection);
+
+    SoftRasterizer raster(WINDOW_WIDTH, WINDOW_HEIGHT);
+    gResolution.SetTarget(1.0 / gTargetFps);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        chrono::steady_clock::time_point frameStart = chrono::steady_clock::now();
+        int renderWidth = WINDOW_WIDTH, renderHeight = WINDOW_HEIGHT;
+        if (gDynamicResolution)
+            gResolution.RenderSize(WINDOW_WIDTH, WINDOW_HEIGHT, renderWidth, renderHeight);
+        raster.SetViewport(renderWidth, renderHeight);
+        UUpdateScene((float)(frame * SIM_TICK));
+        gVisibleObjects.clear();
+        gSceneBVH.Cull(frustum, gVisibleObjects);
+
+        raster.Clear(0xFF000000);
+        for (size_t i = 0; i < gVisibleObjects.size(); i++)
+        {
+            const SceneObject& object = gObjects[gVisibleObjects[i]];
+            raster.DrawIndexed(object.mesh->vertices, floatsPerVertex, pyramidIndices, object.mesh->nIndices,
+                               viewProjection * glm::make_mat4(gSceneGraph.WorldMatrix(object.node)), colors, 6);
+        }
+        raster.Flush();
+        if (gDynamicResolution)
+            gResolution.Update(chrono::duration<double>(chrono::steady_clock::now() - frameStart).count());
+    }
 
-    // Bind the pyramid's VAO
-    glBindVertexArray(gMesh.vao);
+    const RasterStats& stats = raster.Stats();
+    cout << "INFO: Software rasterizer: " << frames << " frames in " << stats.seconds * 1000.0 << " ms" << endl;
+    cout << "INFO: " << stats.triangles / stats.seconds << " triangles/sec, "
+         << stats.pixels / stats.seconds << " pixels/sec, "
+         << frames / stats.seconds << " frames/sec" << endl;
 
-    // Draw the pyramid using indexed rendering
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL);
+    if (gDynamicResolution)
+        UReportResolution();
 
-    // Unbind the VAO
-    glBindVertexArray(0);
+    // Frames are not displayed, so only the one written out is upscaled
+    bool written;
+    if (raster.Width() == WINDOW_WIDTH && raster.Height() == WINDOW_HEIGHT)
+        written = raster.WritePPM("pyramid.ppm");
+    else
+    {
+        vector<unsigned> presented(WINDOW_WIDTH * WINDOW_HEIGHT);
+        UpscaleBilinear(raster.Pixels(), raster.Width(), raster.Height(), raster.Pitch(), presented.data(), WINDOW_WIDTH, WINDOW_HEIGHT);
+        written = SoftRasterizer::WritePPM("pyramid.ppm", presented.data(), WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_WIDTH);
+    }
+    if (written)
+        cout << "INFO: Last frame written to pyramid.ppm" << endl;
+    return EXIT_SUCCESS;
+}
 
-    // Swap the front and back buffers to display the rendered image
-    glfwSwapBuffers(gWindow);
+void UReportResolution()
+{
+    int width, height;
+    gResolution.RenderSize(WINDOW_WIDTH, WINDOW_HEIGHT, width, height);
+    cout << "INFO: Dynamic resolution for " << gTargetFps << " fps: scale " << gResolution.Scale()
+         << " (" << width << "x" << height << " of " << WINDOW_WIDTH << "x" << WINDOW_HEIGHT << "), lowest "
+         << gResolution.LowestScale() << ", " << gResolution.Adjustments() << " adjustments" << endl;
 }
 
-void UCreateMesh(GLMesh& mesh)
+// Advance the animation clock at a fixed rate and publish one snapshot per
+// tick. Runs independently of the render loop, so a slow frame never holds
+// it up.
+void USimulationThread()
 {
-    GLfloat vertices[] = {
-        0.5f,  0.5f, 0.0f,
-        0.5f, -0.5f, 0.0f,
-       -0.5f, -0.5f, 0.0f,
-       -0.5f,  0.5f, 0.0f,
-        0.0f,  0.0f, 1.0f,
-    };
+    float time = (float)glfwGetTime();
+    double nextTick = glfwGetTime();
 
-    GLushort indices[] = {
-        0, 1, 2,
-        0, 3, 2,
-        0, 1, 4,
-        1, 2, 4,
-        2, 3, 4,
-        3, 0, 4,
-    };
+    while (gSimRunning.load())
+    {
+        double now = glfwGetTime();
+        if (now < nextTick)
+        {
+            this_thread::sleep_for(chrono::duration<double>(nextTick - now));
+            continue;
+        }
+
+        SceneSnapshot& snapshot = gSnapshots.WriteSlot();
+        snapshot.prevTime = time;
+        time += (float)SIM_TICK;
+        snapshot.time = time;
+        snapshot.tickTime = now;
+        gSnapshots.Publish();
+
+        // Don't try to catch up on more than a quarter second of ticks
+        nextTick += SIM_TICK;
+        if (now - nextTick > 0.25)
+            nextTick = now;
+    }
+}
 
-    const GLuint floatsPerVertex = 3;
+// Shape 0 is the original pyramid; shape k scales its base by 0.6-1.4 and
+// its apex height by 0.6-1.4, stepping through the range differently for
+// each so neighbouring shapes differ
+void UCreateMeshShapes(int count)
+{
+    const int pyramidFloats = sizeof(pyramidVertices) / sizeof(pyramidVertices[0]);
+    gMeshShapes.assign(count, vector<GLfloat>(pyramidVertices, pyramidVertices + pyramidFloats));
+    for (int k = 1; k < count; k++)
+    {
+        float base = 0.6f + 0.8f * ((k * 37) % 101) / 100.0f;
+        float height = 0.6f + 0.8f * ((k * 61) % 101) / 100.0f;
+        for (int v = 0; v < pyramidFloats; v += floatsPerVertex)
+        {
+            gMeshShapes[k][v] *= base;
+            gMeshShapes[k][v + 1] *= base;
+            gMeshShapes[k][v + 2] *= height;
+        }
+    }
+}
 
-    glGenVertexArrays(1, &mesh.vao);
-    glBindVertexArray(mesh.vao);
+// The CPU-side description of a shape: bounds, index count, vertex data
+void UDescribeMesh(GLMesh& mesh, const GLfloat* vertices)
+{
+    mesh.vertices = vertices;
+    mesh.bounds = UComputeMeshBounds(vertices, sizeof(pyramidVertices) / (sizeof(pyramidVertices[0]) * floatsPerVertex), floatsPerVertex);
+    mesh.nIndices = sizeof(pyramidIndices) / sizeof(pyramidIndices[0]);
+    mesh.vao = 0;
+    mesh.poolMesh = -1;
+}
 
-    glGenBuffers(2, mesh.vbos);
+// Drawing indirect, the shape is added to the pool (uploaded by the
+// caller once all are in); otherwise it gets its own VAO and buffers
+void UCreateMesh(GLMesh& mesh, const GLfloat* vertices)
+{
+    UDescribeMesh(mesh, vertices);
+    if (gIndirect)
+    {
+        mesh.poolMesh = gMeshPool.Add(vertices, pyramidColors,
+                                      sizeof(pyramidVertices) / (sizeof(pyramidVertices[0]) * floatsPerVertex),
+                                      pyramidIndices, mesh.nIndices);
+        return;
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glGenVertexArrays(1, &mesh.vao);
+    gGLState.BindVertexArray(mesh.vao);
 
-    mesh.nIndices = sizeof(indices) / sizeof(indices[0]);
+    glGenBuffers(2, mesh.vbos);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // Positions, then colors, in one buffer, as in the pool
+    gGLState.BindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidVertices) + sizeof(pyramidColors), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(pyramidVertices), vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(pyramidVertices), sizeof(pyramidColors), pyramidColors);
 
-    GLint stride = sizeof(float) * floatsPerVertex;
+    gGLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(pyramidIndices), pyramidIndices, GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
+    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, 0, 0);
     glEnableVertexAttribArray(0);
 
-    // This line enables interleaved attributes for color
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (char*)(sizeof(float) * floatsPerVertex));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, (char*)sizeof(pyramidVertices));
     glEnableVertexAttribArray(1);
 }
 
 void UDestroyMesh(GLMesh& mesh)
 {
+    if (!mesh.vao)
+        return;
     glDeleteVertexArrays(1, &mesh.vao);
     glDeleteBuffers(2, mesh.vbos);
+
+    // Deleting bound objects rebinds 0 behind the cache's back
+    gGLState.Invalidate();
 }
 
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+// Lay out count objects on a square grid in the XZ plane, taking the
+// meshes in turn, each a child of one root node, give each a rotation
+// track, and build the BVH over their world bounds. A single object sits
+// at the origin.
+void UCreateScene(vector<GLMesh>& meshes, int count)
+{
+    const float spacing = 2.0f;
+    int side = 1;
+    while (side * side < count)
+        side++;
+
+    gSceneGraph = SceneGraph();
+    int root = gSceneGraph.AddNode(-1);
+    gObjects.clear();
+    for (int i = 0; i < count; i++)
+    {
+        SceneObject object;
+        object.mesh = &meshes[i % meshes.size()];
+        object.node = gSceneGraph.AddNode(root);
+        gObjects.push_back(object);
+    }
+    gSceneGraph.Finalize();
+
+    gObjectOfNode.assign(gSceneGraph.NodeCount(), -1);
+    for (int i = 0; i < count; i++)
+    {
+        gSceneGraph.SetTranslation(gObjects[i].node, (i % side - (side - 1) * 0.5f) * spacing, 0.0f,
+                                   (i / side - (side - 1) * 0.5f) * spacing);
+        gObjectOfNode[gObjects[i].node] = i;
+    }
+    gSceneGraph.UpdateWorld();
+
+    // One full turn about Y every 2*pi seconds (one radian per second, as
+    // before), keyed every quarter turn and slerped in between
+    const int turnKeys = 5;
+    float keyTimes[turnKeys];
+    quat keyRotations[turnKeys];
+    vec3 axis = { 0.0f, 1.0f, 0.0f };
+    for (int k = 0; k < turnKeys; k++)
+    {
+        keyTimes[k] = k * 1.57079633f; // pi / 2
+        quat_rotate(keyRotations[k], keyTimes[k], axis);
+    }
+    gAnimation = AnimationSampler();
+    gRotationTrack.clear();
+    for (int i = 0; i < count; i++)
+        gRotationTrack.push_back(gAnimation.AddRotationTrack(keyTimes, &keyRotations[0][0], turnKeys, ANIM_SLERP));
+
+    vector<BoundingBox> worldBoxes;
+    for (int i = 0; i < count; i++)
+        worldBoxes.push_back(UTransformBounds(gObjects[i].mesh->bounds, glm::make_mat4(gSceneGraph.WorldMatrix(gObjects[i].node))));
+    gSceneBVH.Build(worldBoxes);
+}
+
+// Sample every animation track at time, hand the results to the scene
+// graph, then refresh the world matrices and BVH bounds of only the nodes
+// the scene graph reports as changed.
+void UUpdateScene(float time)
+{
+    gAnimation.Sample(time);
+    for (size_t i = 0; i < gObjects.size(); i++)
+    {
+        quat rotation;
+        gAnimation.GetRotation(gRotationTrack[i], rotation);
+        gSceneGraph.SetRotation(gObjects[i].node, rotation);
+    }
+
+    gSceneGraph.UpdateWorld();
+
+    const vector<int>& changed = gSceneGraph.ChangedNodes();
+    for (size_t i = 0; i < changed.size(); i++)
+    {
+        int object = gObjectOfNode[changed[i]];
+        if (object >= 0)
+            gSceneBVH.UpdateObject(object, UTransformBounds(gObjects[object].mesh->bounds,
+                glm::make_mat4(gSceneGraph.WorldMatrix(changed[i]))));
+    }
+    gSceneBVH.Refit();
+}
+
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId,
+                          ProgramUniforms& uniforms)
 {
     int success = 0;
     char infoLog[512];
@@ -322,7 +916,12 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
         return false;
     }
 
-    glUseProgram(programId);
+    // -1 for a uniform the program does not use, which glUniform ignores
+    uniforms.model = glGetUniformLocation(programId, "model");
+    uniforms.view = glGetUniformLocation(programId, "view");
+    uniforms.projection = glGetUniformLocation(programId, "projection");
+
+    gGLState.UseProgram(programId);
     return true;
 }
 
@@ -0,0 +1,344 @@
+//=============================================================================
+// File Name: animation.h
+// Version: 1.0
+//
+// Description: Keyframe animation for the pyramid scene. Translation,
+// rotation and scale tracks are sampled in batches and the results are fed
+// to the scene graph. Rotation keys are linmath.h quats and can be
+// interpolated with nlerp or slerp; translation and scale use lerp.
+//
+// Data Structures:
+// - AnimationChannel holds every track of one kind. Keys of all tracks are
+//   stored back to back, one array per component (SoA).
+// - Each track keeps a cursor on its current key and a copy of the two keys
+//   around it (the "segment") in per-track SoA arrays, padded to a multiple
+//   of four tracks. Sampling reads those arrays linearly, four tracks per
+//   SSE operation (scalar fallback otherwise).
+//
+// Time Complexity:
+// - Sample(): O(T) for T tracks during playback. A cursor only moves forward
+//   one key at a time and the segment is copied only when it does; a binary
+//   search is needed only when time jumps backwards past the first segment.
+// - Slerp needs acos and 1/sin of the key angle; both are computed when the
+//   segment is loaded, so a frame only evaluates two sines per track, as a
+//   polynomial that runs in the same SSE lanes as the lerp.
+//=============================================================================
+
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <cmath> // linmath.h uses sqrtf, sinf and cosf without including it
+#include "linmath.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ANIMATION_SSE 1
+#endif
+
+enum ANIMINTERP { ANIM_LERP, ANIM_NLERP, ANIM_SLERP };
+
+// sin(x) for x in [0, pi/2], odd Taylor series to x^11 (error < 1e-7).
+// Used by both paths so SSE and scalar builds sample the same values.
+inline float UAnimSin(float x)
+{
+    float x2 = x * x;
+    return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f +
+           x2 * (1.0f / 362880.0f + x2 * (-1.0f / 39916800.0f))))));
+}
+
+#ifdef ANIMATION_SSE
+inline __m128 UAnimSin4(__m128 x)
+{
+    __m128 x2 = _mm_mul_ps(x, x);
+    __m128 p = _mm_set1_ps(-1.0f / 39916800.0f);
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f / 362880.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 5040.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f / 120.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 6.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, x);
+}
+#endif
+
+class AnimationChannel
+{
+public:
+    // components is 3 for translation/scale, 4 for rotation (quat xyzw).
+    // Padding lanes hold the identity so they never produce NaNs.
+    explicit AnimationChannel(int components) : components(components), trackCount(0) {}
+
+    // Add a track of keyCount keys (keyCount >= 1) with increasing times.
+    // values holds keyCount * components floats. Looping tracks wrap from
+    // their last key time back to their first.
+    int AddTrack(const float* times, const float* values, int keyCount, ANIMINTERP interp, bool loop)
+    {
+        int track = trackCount++;
+        firstKey.push_back((int)keyTime.size());
+        keyCounts.push_back(keyCount);
+        cursor.push_back(-1); // seek on the first Sample()
+        looping.push_back(loop ? 1 : 0);
+        interpolation.push_back((unsigned char)interp);
+        for (int k = 0; k < keyCount; k++)
+        {
+            keyTime.push_back(times[k]);
+            for (int c = 0; c < components; c++)
+                keyValue[c].push_back(values[k * components + c]);
+        }
+
+        size_t padded = (size_t)(trackCount + 3) & ~(size_t)3;
+        segStart.resize(padded, 0.0f);
+        segInvLength.resize(padded, 0.0f);
+        factor.resize(padded, 0.0f);
+        theta.resize(padded, 0.0f);
+        invSinTheta.resize(padded, 0.0f);
+        slerpMask.resize(padded, 0.0f);
+        for (int c = 0; c < components; c++)
+        {
+            float identity = (components == 4 && c == 3) ? 1.0f : 0.0f;
+            from[c].resize(padded, identity);
+            to[c].resize(padded, identity);
+            out[c].resize(padded, identity);
+        }
+        return track;
+    }
+
+    // Evaluate every track at time (seconds).
+    void Sample(float time)
+    {
+        for (int i = 0; i < trackCount; i++)
+            Seek(i, time);
+
+        int padded = (int)factor.size();
+#ifdef ANIMATION_SSE
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (int i = 0; i < padded; i += 4)
+        {
+            __m128 w1 = _mm_loadu_ps(&factor[i]);
+            __m128 w0 = _mm_sub_ps(one, w1);
+            if (components == 4)
+            {
+                __m128 mask = _mm_cmpgt_ps(_mm_loadu_ps(&slerpMask[i]), _mm_setzero_ps());
+                if (_mm_movemask_ps(mask))
+                {
+                    __m128 th = _mm_loadu_ps(&theta[i]);
+                    __m128 inv = _mm_loadu_ps(&invSinTheta[i]);
+                    __m128 s0 = _mm_mul_ps(UAnimSin4(_mm_mul_ps(w0, th)), inv);
+                    __m128 s1 = _mm_mul_ps(UAnimSin4(_mm_mul_ps(w1, th)), inv);
+                    w0 = _mm_or_ps(_mm_and_ps(mask, s0), _mm_andnot_ps(mask, w0));
+                    w1 = _mm_or_ps(_mm_and_ps(mask, s1), _mm_andnot_ps(mask, w1));
+                }
+            }
+
+            __m128 r[4];
+            __m128 lengthSq = _mm_setzero_ps();
+            for (int c = 0; c < components; c++)
+            {
+                r[c] = _mm_add_ps(_mm_mul_ps(w0, _mm_loadu_ps(&from[c][i])),
+                                  _mm_mul_ps(w1, _mm_loadu_ps(&to[c][i])));
+                lengthSq = _mm_add_ps(lengthSq, _mm_mul_ps(r[c], r[c]));
+            }
+            if (components == 4)
+            {
+                // nlerp needs it; for slerp it only removes rounding drift
+                __m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSq));
+                for (int c = 0; c < 4; c++)
+                    r[c] = _mm_mul_ps(r[c], invLength);
+            }
+            for (int c = 0; c < components; c++)
+                _mm_storeu_ps(&out[c][i], r[c]);
+        }
+#else
+        for (int i = 0; i < padded; i++)
+        {
+            float w1 = factor[i];
+            float w0 = 1.0f - w1;
+            if (components == 4 && slerpMask[i] > 0.0f)
+            {
+                float s0 = UAnimSin(w0 * theta[i]) * invSinTheta[i];
+                w1 = UAnimSin(w1 * theta[i]) * invSinTheta[i];
+                w0 = s0;
+            }
+
+            float r[4];
+            float lengthSq = 0.0f;
+            for (int c = 0; c < components; c++)
+            {
+                r[c] = w0 * from[c][i] + w1 * to[c][i];
+                lengthSq += r[c] * r[c];
+            }
+            float scale = components == 4 ? 1.0f / sqrtf(lengthSq) : 1.0f;
+            for (int c = 0; c < components; c++)
+                out[c][i] = r[c] * scale;
+        }
+#endif
+    }
+
+    // Result of the last Sample() for one track
+    void Get(int track, float* r) const
+    {
+        for (int c = 0; c < components; c++)
+            r[c] = out[c][track];
+    }
+
+    int TrackCount() const { return trackCount; }
+
+private:
+    int components;
+    int trackCount;
+
+    // Keys of all tracks, back to back
+    std::vector<float> keyTime;
+    std::vector<float> keyValue[4];
+
+    // Per track
+    std::vector<int> firstKey;
+    std::vector<int> keyCounts;
+    std::vector<int> cursor;      // index of the segment's first key, -1 before the first seek
+    std::vector<unsigned char> looping;
+    std::vector<unsigned char> interpolation;
+
+    // Per track, padded to a multiple of four: the cached segment and the
+    // interpolation factor for the current sample
+    std::vector<float> segStart;
+    std::vector<float> segInvLength;
+    std::vector<float> factor;
+    std::vector<float> theta;       // angle between the segment's quats (slerp)
+    std::vector<float> invSinTheta;
+    std::vector<float> slerpMask;   // 1 where slerp weights are used
+    std::vector<float> from[4];
+    std::vector<float> to[4];
+    std::vector<float> out[4];
+
+    // Move the cursor of track i to the segment containing time and set
+    // its interpolation factor.
+    void Seek(int i, float time)
+    {
+        int count = keyCounts[i];
+        const float* times = &keyTime[firstKey[i]];
+        float start = times[0];
+        float end = times[count - 1];
+
+        float local = time;
+        if (looping[i] && end > start)
+        {
+            local = fmodf(time - start, end - start);
+            if (local < 0.0f)
+                local += end - start;
+            local += start;
+        }
+        local = std::min(std::max(local, start), end);
+
+        int k = cursor[i];
+        int lastSegment = count > 1 ? count - 2 : 0;
+        if (k < 0 || local < times[k])
+        {
+            // Backwards: a loop wrap lands in the first segment, anything
+            // else (a seek) needs a search
+            if (count <= 2 || local < times[1])
+                k = 0;
+            else
+                k = std::min((int)(std::upper_bound(times, times + count, local) - times) - 1, lastSegment);
+            LoadSegment(i, k);
+        }
+        else if (k < lastSegment && local >= times[k + 1])
+        {
+            while (k < lastSegment && local >= times[k + 1])
+                k++;
+            LoadSegment(i, k);
+        }
+
+        float f = (local - segStart[i]) * segInvLength[i];
+        factor[i] = std::min(std::max(f, 0.0f), 1.0f);
+    }
+
+    // Copy keys k and k + 1 of track i into the segment arrays
+    void LoadSegment(int i, int k)
+    {
+        cursor[i] = k;
+        int a = firstKey[i] + k;
+        int b = firstKey[i] + std::min(k + 1, keyCounts[i] - 1);
+
+        segStart[i] = keyTime[a];
+        float length = keyTime[b] - keyTime[a];
+        segInvLength[i] = length > 0.0f ? 1.0f / length : 0.0f;
+
+        // Rotations take the short way round: flip the second key if the
+        // two quats are more than 180 degrees apart
+        float sign = 1.0f;
+        float cosTheta = 1.0f;
+        if (components == 4)
+        {
+            cosTheta = 0.0f;
+            for (int c = 0; c < 4; c++)
+                cosTheta += keyValue[c][a] * keyValue[c][b];
+            if (cosTheta < 0.0f)
+            {
+                sign = -1.0f;
+                cosTheta = -cosTheta;
+            }
+        }
+        for (int c = 0; c < components; c++)
+        {
+            from[c][i] = keyValue[c][a];
+            to[c][i] = keyValue[c][b] * sign;
+        }
+
+        // Nearly equal quats: slerp degenerates, nlerp is exact enough
+        if (interpolation[i] == ANIM_SLERP && cosTheta < 0.9999f)
+        {
+            theta[i] = acosf(cosTheta);
+            invSinTheta[i] = 1.0f / sinf(theta[i]);
+            slerpMask[i] = 1.0f;
+        }
+        else
+        {
+            slerpMask[i] = 0.0f;
+        }
+    }
+};
+
+// Translation, rotation and scale tracks sampled together. Track ids are
+// per kind; an object typically owns one track of each kind it animates.
+class AnimationSampler
+{
+public:
+    AnimationSampler() : translation(3), rotation(4), scale(3) {}
+
+    // values: keyCount * xyz
+    int AddTranslationTrack(const float* times, const float* values, int keyCount, bool loop = true)
+    {
+        return translation.AddTrack(times, values, keyCount, ANIM_LERP, loop);
+    }
+
+    // values: keyCount quats (xyzw); interp is ANIM_NLERP or ANIM_SLERP
+    int AddRotationTrack(const float* times, const float* values, int keyCount, ANIMINTERP interp, bool loop = true)
+    {
+        return rotation.AddTrack(times, values, keyCount, interp, loop);
+    }
+
+    // values: keyCount * xyz
+    int AddScaleTrack(const float* times, const float* values, int keyCount, bool loop = true)
+    {
+        return scale.AddTrack(times, values, keyCount, ANIM_LERP, loop);
+    }
+
+    void Sample(float time)
+    {
+        translation.Sample(time);
+        rotation.Sample(time);
+        scale.Sample(time);
+    }
+
+    void GetTranslation(int track, vec3 r) const { translation.Get(track, r); }
+    void GetRotation(int track, quat r) const { rotation.Get(track, r); }
+    void GetScale(int track, vec3 r) const { scale.Get(track, r); }
+
+private:
+    AnimationChannel translation;
+    AnimationChannel rotation;
+    AnimationChannel scale;
+};
+
+#endif
@@ -0,0 +1,224 @@
+//=============================================================================
+// File Name: dynamic_resolution.h
+// Version: 1.0
+//
+// Description: Dynamic resolution for the pyramid renderer. The scene is
+// drawn into an offscreen target at a fraction of the window size, then
+// stretched to the window in one linear-filtered blit. A PI controller
+// measures frame times and picks that fraction, so a slow machine (or
+// software rasterization) trades sharpness for staying inside the frame
+// budget instead of dropping frames.
+//
+// Data Structures:
+// - ResolutionController: the scale (fraction of the window's width and
+//   height) plus the controller's memory. Frame times are averaged over
+//   a few frames before each adjustment so single spikes do not move it.
+// - RenderTarget: a framebuffer object with a color texture and a depth
+//   renderbuffer, allocated at the full window size. A lower scale renders
+//   into its lower left corner, so changing the scale never reallocates.
+//
+// Algorithmic Logic:
+// - The error is the fraction of the budget left over, (target - time) /
+//   target. The controller runs in velocity form:
+//     scale += KP * (error - previous error) + KI * error
+//   The scale is clamped to [minimum, 1], which also stops integral windup.
+//   Errors within a small deadband leave the scale alone, so it settles
+//   instead of hunting by a pixel or two. The previous error is still
+//   updated there, so the proportional term of the first step out of the
+//   deadband sees the real change rather than the whole error again.
+// - Pixel cost grows with scale squared, so a large overshoot corrects in a
+//   few adjustments without the gains having to be large.
+//=============================================================================
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+
+const float RESOLUTION_KP = 0.3f;
+const float RESOLUTION_KI = 0.15f;
+const float RESOLUTION_DEADBAND = 0.05f;   // fraction of the budget
+const int RESOLUTION_INTERVAL = 8;         // frames averaged per adjustment
+
+class ResolutionController
+{
+public:
+    ResolutionController(double targetSeconds = 1.0 / 60.0, float minScale = 0.35f)
+        : target(targetSeconds), minScale(minScale), scale(1.0f), previousError(0.0f),
+          sum(0.0), samples(0), adjustments(0), lowest(1.0f)
+    {
+    }
+
+    void SetTarget(double seconds) { target = seconds; }
+
+    // Record one frame's time. Returns true when the scale changed.
+    bool Update(double frameSeconds)
+    {
+        sum += frameSeconds;
+        if (++samples < RESOLUTION_INTERVAL)
+            return false;
+        double average = sum / samples;
+        sum = 0.0;
+        samples = 0;
+
+        float error = (float)((target - average) / target);
+        float change = error - previousError;
+        previousError = error;
+        if (std::fabs(error) < RESOLUTION_DEADBAND)
+            return false;
+        float next = scale + RESOLUTION_KP * change + RESOLUTION_KI * error;
+        next = std::min(1.0f, std::max(minScale, next));
+        if (next == scale)
+            return false;
+        scale = next;
+        lowest = std::min(lowest, scale);
+        adjustments++;
+        return true;
+    }
+
+    float Scale() const { return scale; }
+    float LowestScale() const { return lowest; }
+    unsigned Adjustments() const { return adjustments; }
+
+    // Render size for a window, at least one pixel each way
+    void RenderSize(int windowWidth, int windowHeight, int& width, int& height) const
+    {
+        width = std::max(1, (int)(windowWidth * scale + 0.5f));
+        height = std::max(1, (int)(windowHeight * scale + 0.5f));
+    }
+
+private:
+    double target;
+    float minScale;
+    float scale;
+    float previousError;
+    double sum;
+    int samples;
+    unsigned adjustments;
+    float lowest;
+};
+
+// Blend two RGBA pixels, weight 0..256 toward q. Red and blue, then green
+// and alpha, are blended two channels per multiply.
+inline unsigned LerpPixel(unsigned p, unsigned q, unsigned weight)
+{
+    unsigned rb = ((p & 0xFF00FF) * (256 - weight) + (q & 0xFF00FF) * weight) >> 8;
+    unsigned ga = (((p >> 8) & 0xFF00FF) * (256 - weight) + ((q >> 8) & 0xFF00FF) * weight) >> 8;
+    return (rb & 0xFF00FF) | ((ga & 0xFF00FF) << 8);
+}
+
+// Stretch a srcWidth x srcHeight image to dstWidth x dstHeight with
+// bilinear filtering: the software path's version of the final blit.
+// Pixels are RGBA bytes packed in an unsigned. Source positions step in
+// 16.16 fixed point so the inner loop has no float conversions.
+inline void UpscaleBilinear(const unsigned* src, int srcWidth, int srcHeight, int srcPitch,
+                            unsigned* dst, int dstWidth, int dstHeight)
+{
+    int stepX = (int)(((long long)srcWidth << 16) / dstWidth);
+    int stepY = (int)(((long long)srcHeight << 16) / dstHeight);
+    int sy = stepY / 2 - 0x8000;    // pixel centers line up
+    for (int y = 0; y < dstHeight; y++, sy += stepY)
+    {
+        int clampedY = std::max(0, sy);
+        int y0 = std::min(clampedY >> 16, srcHeight - 1);
+        int y1 = std::min(y0 + 1, srcHeight - 1);
+        unsigned fy = (clampedY >> 8) & 0xFF;
+        const unsigned* row0 = src + y0 * srcPitch;
+        const unsigned* row1 = src + y1 * srcPitch;
+        unsigned* out = dst + y * dstWidth;
+        int sx = stepX / 2 - 0x8000;
+        for (int x = 0; x < dstWidth; x++, sx += stepX)
+        {
+            int clampedX = std::max(0, sx);
+            int x0 = std::min(clampedX >> 16, srcWidth - 1);
+            int x1 = std::min(x0 + 1, srcWidth - 1);
+            unsigned fx = (clampedX >> 8) & 0xFF;
+            out[x] = LerpPixel(LerpPixel(row0[x0], row0[x1], fx), LerpPixel(row1[x0], row1[x1], fx), fy);
+        }
+    }
+}
+
+// Offscreen color + depth target, sized for the whole window
+class RenderTarget
+{
+public:
+    RenderTarget() : framebuffer(0), colorTexture(0), depthBuffer(0), width(0), height(0), renderWidth(0), renderHeight(0) {}
+    ~RenderTarget() { Destroy(); }
+
+    // (Re)allocate for a window size. Returns false if the framebuffer is
+    // incomplete, in which case the caller should draw to the window.
+    bool Create(int windowWidth, int windowHeight)
+    {
+        Destroy();
+        width = windowWidth;
+        height = windowHeight;
+
+        glGenTextures(1, &colorTexture);
+        glBindTexture(GL_TEXTURE_2D, colorTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        if (!complete)
+            Destroy();
+        return complete;
+    }
+
+    void Destroy()
+    {
+        if (framebuffer)
+            glDeleteFramebuffers(1, &framebuffer);
+        if (colorTexture)
+            glDeleteTextures(1, &colorTexture);
+        if (depthBuffer)
+            glDeleteRenderbuffers(1, &depthBuffer);
+        framebuffer = colorTexture = depthBuffer = 0;
+        width = height = 0;
+    }
+
+    // Draw into the lower left renderWidth x renderHeight of the target
+    void Begin(int w, int h)
+    {
+        renderWidth = std::min(w, width);
+        renderHeight = std::min(h, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, renderWidth, renderHeight);
+    }
+
+    // Stretch what was drawn over the whole window
+    void BlitToWindow(int windowWidth, int windowHeight)
+    {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, windowWidth, windowHeight);
+    }
+
+    bool Valid() const { return framebuffer != 0; }
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+private:
+    GLuint framebuffer;
+    GLuint colorTexture;
+    GLuint depthBuffer;
+    int width, height;              // allocated size
+    int renderWidth, renderHeight;  // size drawn this frame
+};
+
+#endif
@@ -0,0 +1,188 @@
+//=============================================================================
+// File Name: gl_state_cache.h
+// Version: 1.0
+//
+// Description: A thin shadow of the OpenGL state the pyramid renderer sets
+// every frame: the bound program, vertex array, array, element and
+// draw-indirect buffers, a few enable bits and the clear color. Each
+// setter compares against the shadow copy and only calls into the driver
+// when the value changes, so a frame that sets the same state as the last
+// one costs no GL calls for it.
+//
+// Data Structures:
+// - One shadow value per binding. An UNKNOWN_BINDING value means the state
+//   is not known (after Invalidate(), or when GL changed it implicitly)
+//   and the next set always goes through.
+// - Enable bits for the tracked capabilities are kept as two masks: which
+//   capabilities are known, and which of those are enabled. Capabilities
+//   outside the table are passed straight to GL.
+//
+// Algorithmic Logic:
+// - The element array binding belongs to the vertex array object, so
+//   binding a different vertex array makes the element shadow unknown.
+// - Code that changes this state without going through the cache must
+//   call Invalidate() afterwards.
+// - Every set counts as issued or saved. BeginFrame() starts a new count
+//   and keeps running totals for the report at exit.
+//=============================================================================
+
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <GL/glew.h>
+#include <iostream>
+
+const GLuint UNKNOWN_BINDING = 0xFFFFFFFFu;
+
+class GLStateCache
+{
+public:
+    GLStateCache() : frames(0), issued(0), saved(0), totalIssued(0), totalSaved(0) { Invalidate(); }
+
+    // Forget everything; the next set of each state reaches GL
+    void Invalidate()
+    {
+        program = vertexArray = arrayBuffer = elementBuffer = drawIndirectBuffer = UNKNOWN_BINDING;
+        knownCaps = enabledCaps = 0;
+        clearColorKnown = false;
+    }
+
+    void UseProgram(GLuint id)
+    {
+        if (Changed(program, id))
+            glUseProgram(id);
+    }
+
+    void BindVertexArray(GLuint id)
+    {
+        if (Changed(vertexArray, id))
+        {
+            glBindVertexArray(id);
+            elementBuffer = UNKNOWN_BINDING;
+        }
+    }
+
+    void BindBuffer(GLenum target, GLuint id)
+    {
+        GLuint* shadow = NULL;
+        if (target == GL_ARRAY_BUFFER)
+            shadow = &arrayBuffer;
+        else if (target == GL_ELEMENT_ARRAY_BUFFER)
+            shadow = &elementBuffer;
+        else if (target == GL_DRAW_INDIRECT_BUFFER)
+            shadow = &drawIndirectBuffer;
+        if (!shadow)
+        {
+            glBindBuffer(target, id);
+            issued++;
+        }
+        else if (Changed(*shadow, id))
+            glBindBuffer(target, id);
+    }
+
+    void Enable(GLenum cap) { SetCapability(cap, true); }
+    void Disable(GLenum cap) { SetCapability(cap, false); }
+
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+    {
+        if (clearColorKnown && clearColor[0] == red && clearColor[1] == green && clearColor[2] == blue && clearColor[3] == alpha)
+        {
+            saved++;
+            return;
+        }
+        clearColor[0] = red;
+        clearColor[1] = green;
+        clearColor[2] = blue;
+        clearColor[3] = alpha;
+        clearColorKnown = true;
+        glClearColor(red, green, blue, alpha);
+        issued++;
+    }
+
+    // Start counting a new frame
+    void BeginFrame()
+    {
+        frames++;
+        totalIssued += issued;
+        totalSaved += saved;
+        issued = saved = 0;
+    }
+
+    unsigned IssuedThisFrame() const { return issued; }
+    unsigned SavedThisFrame() const { return saved; }
+
+    void Report(std::ostream& out) const
+    {
+        unsigned long long allIssued = totalIssued + issued;
+        unsigned long long allSaved = totalSaved + saved;
+        out << "GL state cache: " << allSaved << " of " << allIssued + allSaved << " state calls filtered";
+        if (frames > 0)
+            out << ", " << (double)allSaved / frames << " saved and " << (double)allIssued / frames << " issued per frame";
+        out << std::endl;
+    }
+
+private:
+    GLuint program;
+    GLuint vertexArray;
+    GLuint arrayBuffer;
+    GLuint elementBuffer;
+    GLuint drawIndirectBuffer;
+    unsigned knownCaps;
+    unsigned enabledCaps;
+    GLfloat clearColor[4];
+    bool clearColorKnown;
+    unsigned long long frames;
+    unsigned issued;
+    unsigned saved;
+    unsigned long long totalIssued;
+    unsigned long long totalSaved;
+
+    // Update a shadow binding; true when GL has to be told
+    bool Changed(GLuint& shadow, GLuint id)
+    {
+        if (shadow == id)
+        {
+            saved++;
+            return false;
+        }
+        shadow = id;
+        issued++;
+        return true;
+    }
+
+    static int CapabilityBit(GLenum cap)
+    {
+        switch (cap)
+        {
+        case GL_DEPTH_TEST: return 0;
+        case GL_CULL_FACE: return 1;
+        case GL_BLEND: return 2;
+        case GL_SCISSOR_TEST: return 3;
+        case GL_STENCIL_TEST: return 4;
+        default: return -1;
+        }
+    }
+
+    void SetCapability(GLenum cap, bool enable)
+    {
+        int bit = CapabilityBit(cap);
+        if (bit >= 0)
+        {
+            unsigned mask = 1u << bit;
+            if ((knownCaps & mask) && ((enabledCaps & mask) != 0) == enable)
+            {
+                saved++;
+                return;
+            }
+            knownCaps |= mask;
+            enabledCaps = enable ? enabledCaps | mask : enabledCaps & ~mask;
+        }
+        if (enable)
+            glEnable(cap);
+        else
+            glDisable(cap);
+        issued++;
+    }
+};
+
+#endif
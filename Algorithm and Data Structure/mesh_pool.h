@@ -0,0 +1,203 @@
+//=============================================================================
+// File Name: mesh_pool.h
+// Version: 1.0
+//
+// Description: Every mesh of the scene packed into one vertex buffer and
+// one index buffer behind a single vertex array, drawn with
+// glMultiDrawElementsIndirect. A frame's draws are
+// DrawElementsIndirectCommand records built on the CPU, so thousands of
+// objects of thousands of different meshes go out in one call instead of
+// one glDrawElements, VAO bind and uniform upload each.
+//
+// Data Structures:
+// - MeshRange: where a mesh sits in the shared buffers (first index,
+//   index count, base vertex). Indices stay local to their mesh and the
+//   command's baseVertex offsets them, so 16-bit indices keep working
+//   however large the pool gets.
+// - Per-draw model matrices live in an instanced vertex attribute
+//   (locations 2-5, divisor 1). Draw i has one instance and baseInstance
+//   i, so the attribute fetch picks up matrix i. This avoids needing
+//   gl_DrawID, which GL 4.3 does not have.
+//
+// Algorithmic Logic:
+// - Add() only appends to CPU arrays; Upload() creates the GL objects once
+//   all meshes are in.
+// - Each frame the command and matrix arrays are rebuilt and respecified
+//   with glBufferData, which lets the driver orphan last frame's storage
+//   instead of waiting for the GPU to finish with it.
+// - Draw() splits at POOL_MAX_DRAWS_PER_CALL commands per call, so a
+//   scene is a handful of calls at most.
+// - Vertex attributes match UCreateMesh: one buffer holds every position
+//   (3 floats per vertex) followed by every color (4 floats per vertex).
+//   Both arrays are in the same vertex order, so a command's baseVertex
+//   offsets the two attributes alike.
+//=============================================================================
+
+#ifndef MESH_POOL_H
+#define MESH_POOL_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "gl_state_cache.h"
+
+const int POOL_FLOATS_PER_VERTEX = 3;
+const int POOL_FLOATS_PER_COLOR = 4;
+const int POOL_MAX_DRAWS_PER_CALL = 65536;
+
+// Layout fixed by the GL specification
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct MeshRange {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+};
+
+class MeshPool
+{
+public:
+    MeshPool() : vertexArray(0), frames(0), totalDraws(0), totalCalls(0), drawsThisFrame(0), callsThisFrame(0)
+    {
+        buffers[0] = buffers[1] = buffers[2] = buffers[3] = 0;
+    }
+
+    ~MeshPool() { Destroy(); }
+
+    // Returns the mesh's index for AddDraw(). colors has one RGBA per vertex.
+    int Add(const GLfloat* vertices, const GLfloat* colors, int vertexCount, const GLushort* indices, int indexCount)
+    {
+        MeshRange range;
+        range.firstIndex = (GLuint)this->indices.size();
+        range.indexCount = (GLuint)indexCount;
+        range.baseVertex = (GLint)(this->vertices.size() / POOL_FLOATS_PER_VERTEX);
+        this->vertices.insert(this->vertices.end(), vertices, vertices + vertexCount * POOL_FLOATS_PER_VERTEX);
+        this->colors.insert(this->colors.end(), colors, colors + vertexCount * POOL_FLOATS_PER_COLOR);
+        this->indices.insert(this->indices.end(), indices, indices + indexCount);
+        ranges.push_back(range);
+        return (int)ranges.size() - 1;
+    }
+
+    void Upload(GLStateCache& state)
+    {
+        glGenVertexArrays(1, &vertexArray);
+        glGenBuffers(4, buffers);
+        state.BindVertexArray(vertexArray);
+
+        state.BindBuffer(GL_ARRAY_BUFFER, buffers[VERTICES]);
+        size_t positionBytes = vertices.size() * sizeof(GLfloat);
+        glBufferData(GL_ARRAY_BUFFER, positionBytes + colors.size() * sizeof(GLfloat), NULL, GL_STATIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, vertices.data());
+        glBufferSubData(GL_ARRAY_BUFFER, positionBytes, colors.size() * sizeof(GLfloat), colors.data());
+        glVertexAttribPointer(0, POOL_FLOATS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, POOL_FLOATS_PER_COLOR, GL_FLOAT, GL_FALSE, 0, (char*)positionBytes);
+        glEnableVertexAttribArray(1);
+
+        state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[INDICES]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+
+        // A mat4 attribute takes four locations, one column each
+        state.BindBuffer(GL_ARRAY_BUFFER, buffers[MATRICES]);
+        for (int column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(GLfloat) * 16, (char*)(sizeof(GLfloat) * 4 * column));
+            glEnableVertexAttribArray(2 + column);
+            glVertexAttribDivisor(2 + column, 1);
+        }
+    }
+
+    void Destroy()
+    {
+        if (vertexArray)
+        {
+            glDeleteVertexArrays(1, &vertexArray);
+            glDeleteBuffers(4, buffers);
+        }
+        vertexArray = 0;
+    }
+
+    // Start a frame's list of draws
+    void BeginFrame()
+    {
+        commands.clear();
+        matrices.clear();
+    }
+
+    void AddDraw(int mesh, const GLfloat* model)
+    {
+        const MeshRange& range = ranges[mesh];
+        DrawElementsIndirectCommand command;
+        command.count = range.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = range.firstIndex;
+        command.baseVertex = range.baseVertex;
+        command.baseInstance = (GLuint)commands.size();
+        commands.push_back(command);
+        matrices.insert(matrices.end(), model, model + 16);
+    }
+
+    // Upload the frame's commands and matrices and draw them all. The
+    // caller has the program and its uniforms set.
+    void Draw(GLStateCache& state)
+    {
+        state.BindVertexArray(vertexArray);
+        state.BindBuffer(GL_ARRAY_BUFFER, buffers[MATRICES]);
+        glBufferData(GL_ARRAY_BUFFER, matrices.size() * sizeof(GLfloat), matrices.data(), GL_STREAM_DRAW);
+        state.BindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[COMMANDS]);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+
+        callsThisFrame = 0;
+        for (size_t first = 0; first < commands.size(); first += POOL_MAX_DRAWS_PER_CALL)
+        {
+            size_t count = std::min(commands.size() - first, (size_t)POOL_MAX_DRAWS_PER_CALL);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT,
+                (const void*)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)count, 0);
+            callsThisFrame++;
+        }
+        drawsThisFrame = (unsigned)commands.size();
+        frames++;
+        totalDraws += drawsThisFrame;
+        totalCalls += callsThisFrame;
+    }
+
+    int MeshCount() const { return (int)ranges.size(); }
+    const MeshRange& Range(int mesh) const { return ranges[mesh]; }
+    unsigned DrawsThisFrame() const { return drawsThisFrame; }
+    unsigned CallsThisFrame() const { return callsThisFrame; }
+
+    void Report(std::ostream& out) const
+    {
+        out << "Indirect draws: " << ranges.size() << " meshes in " << vertices.size() / POOL_FLOATS_PER_VERTEX
+            << " vertices and " << indices.size() << " indices";
+        if (frames > 0)
+            out << ", " << (double)totalDraws / frames << " draws in " << (double)totalCalls / frames << " calls per frame";
+        out << std::endl;
+    }
+
+private:
+    enum { VERTICES, INDICES, MATRICES, COMMANDS };
+
+    std::vector<GLfloat> vertices;
+    std::vector<GLfloat> colors;
+    std::vector<GLushort> indices;
+    std::vector<MeshRange> ranges;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<GLfloat> matrices;
+    GLuint vertexArray;
+    GLuint buffers[4];
+    unsigned long long frames;
+    unsigned long long totalDraws;
+    unsigned long long totalCalls;
+    unsigned drawsThisFrame;
+    unsigned callsThisFrame;
+};
+
+#endif
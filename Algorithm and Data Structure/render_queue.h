@@ -0,0 +1,252 @@
+//=============================================================================
+// File Name: render_queue.h
+// Version: 1.0
+//
+// Description: A per-frame queue of draw calls ordered by a 64-bit sort
+// key instead of by submission order. Draws are submitted from any thread
+// during the frame, sorted once, and executed on the render thread with a
+// program or vertex array bind only where the sorted order changes them.
+//
+// Data Structures:
+// - Sort key, most significant field first:
+//     pass      4 bits  (bits 60-63)  opaque before transparent, ...
+//     program  12 bits  (bits 48-59)
+//     VAO      16 bits  (bits 32-47)
+//     material  8 bits  (bits 24-31)
+//     depth    24 bits  (bits 0-23)   front to back within a state group
+//   Program and VAO fields hold the GL names masked to their width. Two
+//   names that collide only cost an extra bind; the item keeps the real
+//   names and binds those.
+// - Items and keys live in arrays sized from earlier frames. Submit()
+//   reserves a slot with one atomic increment. A frame that overflows the
+//   arrays spills the rest into a locked vector, and the arrays grow to
+//   hold them, so submission never blocks in the steady state.
+//
+// Algorithmic Logic:
+// - Sort() is an LSD radix sort on (key, index) pairs, 8 bits per pass.
+//   All eight byte histograms are counted in one sweep, and passes where
+//   every key has the same byte (unused fields, a single program) are
+//   skipped, so a scene with one program and one mesh sorts in about
+//   three passes over the depth bits.
+// - Execute() walks the sorted items through the GL state cache and calls
+//   setup(program) whenever the program changes, so per-program uniforms
+//   such as the view and projection matrices are set once per group.
+//=============================================================================
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "gl_state_cache.h"
+
+typedef unsigned long long SortKey;
+
+// depth in [0, 1], 0 at the near plane
+inline SortKey MakeSortKey(unsigned pass, GLuint program, GLuint vertexArray, unsigned material, float depth)
+{
+    depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+    return ((SortKey)(pass & 0xF) << 60) |
+           ((SortKey)(program & 0xFFF) << 48) |
+           ((SortKey)(vertexArray & 0xFFFF) << 32) |
+           ((SortKey)(material & 0xFF) << 24) |
+           (SortKey)(depth * 16777215.0f);
+}
+
+struct DrawItem {
+    GLuint program;
+    GLuint vertexArray;
+    GLsizei indexCount;
+    GLenum indexType;
+    GLint modelLocation;
+    const GLfloat* model;  // must stay valid until Execute()
+};
+
+struct RenderQueueStats {
+    unsigned draws;
+    unsigned programBinds;
+    unsigned vertexArrayBinds;
+    int bindsAvoided;          // submission-order binds minus binds made; negative if truncated ids
+                               // in the sort key interleaved two groups
+    unsigned sortPasses;
+    unsigned spilled;          // draws that overflowed the preallocated arrays
+};
+
+class RenderQueue
+{
+public:
+    explicit RenderQueue(size_t capacity = 1024) : count(0), sortedCount(0), submissionBinds(0),
+          frames(0), totalDraws(0), totalBinds(0), totalAvoided(0)
+    {
+        Reserve(capacity);
+        memset(&stats, 0, sizeof(stats));
+    }
+
+    // Start a frame. Render thread only, with no submitters running.
+    void Reset()
+    {
+        if (stats.spilled > 0)
+            Reserve(keys.size() + keys.size() / 2);
+        stats.spilled = 0;
+        count.store(0, std::memory_order_relaxed);
+        overflow.clear();
+        overflowKeys.clear();
+        sortedCount = 0;
+    }
+
+    // Any thread
+    void Submit(SortKey key, const DrawItem& item)
+    {
+        size_t slot = count.fetch_add(1, std::memory_order_relaxed);
+        if (slot < keys.size())
+        {
+            keys[slot] = key;
+            items[slot] = item;
+            return;
+        }
+        std::lock_guard<std::mutex> lock(overflowLock);
+        overflowKeys.push_back(key);
+        overflow.push_back(item);
+    }
+
+    // Once all submitters are done
+    void Sort()
+    {
+        // Draws only spill once the arrays are full, so appending them
+        // keeps every draw in place and grows the arrays for later frames
+        sortedCount = std::min(count.load(std::memory_order_relaxed), keys.size());
+        stats.spilled = (unsigned)overflow.size();
+        if (!overflow.empty())
+        {
+            keys.insert(keys.end(), overflowKeys.begin(), overflowKeys.end());
+            items.insert(items.end(), overflow.begin(), overflow.end());
+            sortedCount = keys.size();
+        }
+
+        sorted.resize(sortedCount);
+        scratch.resize(sortedCount);
+        unsigned histograms[8][256];
+        memset(histograms, 0, sizeof(histograms));
+        for (size_t i = 0; i < sortedCount; i++)
+        {
+            sorted[i].key = keys[i];
+            sorted[i].index = (unsigned)i;
+            for (int b = 0; b < 8; b++)
+                histograms[b][(keys[i] >> (b * 8)) & 0xFF]++;
+        }
+
+        // Binds the draws would need in the order they were submitted
+        submissionBinds = 0;
+        GLuint program = UNKNOWN_BINDING, vertexArray = UNKNOWN_BINDING;
+        for (size_t i = 0; i < sortedCount; i++)
+        {
+            submissionBinds += (items[i].program != program) + (items[i].vertexArray != vertexArray);
+            program = items[i].program;
+            vertexArray = items[i].vertexArray;
+        }
+
+        stats.sortPasses = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            unsigned* histogram = histograms[b];
+            if (sortedCount == 0 || histogram[(sorted[0].key >> (b * 8)) & 0xFF] == sortedCount)
+                continue; // every key has this byte
+            unsigned offset = 0;
+            for (int v = 0; v < 256; v++)
+            {
+                unsigned n = histogram[v];
+                histogram[v] = offset;
+                offset += n;
+            }
+            for (size_t i = 0; i < sortedCount; i++)
+                scratch[histogram[(sorted[i].key >> (b * 8)) & 0xFF]++] = sorted[i];
+            sorted.swap(scratch);
+            stats.sortPasses++;
+        }
+    }
+
+    // Issue the sorted draws. setup(program) runs after each program change.
+    template <typename ProgramSetup>
+    void Execute(GLStateCache& state, ProgramSetup& setup)
+    {
+        stats.draws = (unsigned)sortedCount;
+        stats.programBinds = stats.vertexArrayBinds = 0;
+        GLuint program = UNKNOWN_BINDING, vertexArray = UNKNOWN_BINDING;
+        for (size_t i = 0; i < sortedCount; i++)
+        {
+            const DrawItem& item = items[sorted[i].index];
+            if (item.program != program)
+            {
+                program = item.program;
+                state.UseProgram(program);
+                setup(program);
+                stats.programBinds++;
+            }
+            if (item.vertexArray != vertexArray)
+            {
+                vertexArray = item.vertexArray;
+                state.BindVertexArray(vertexArray);
+                stats.vertexArrayBinds++;
+            }
+            glUniformMatrix4fv(item.modelLocation, 1, GL_FALSE, item.model);
+            glDrawElements(GL_TRIANGLES, item.indexCount, item.indexType, NULL);
+        }
+
+        stats.bindsAvoided = (int)submissionBinds - (int)(stats.programBinds + stats.vertexArrayBinds);
+        frames++;
+        totalDraws += stats.draws;
+        totalBinds += stats.programBinds + stats.vertexArrayBinds;
+        totalAvoided += stats.bindsAvoided;
+    }
+
+    void Report(std::ostream& out) const
+    {
+        out << "Render queue: " << frames << " frames";
+        if (frames > 0)
+        {
+            out << ", " << (double)totalDraws / frames << " draws, " << (double)totalBinds / frames
+                << " program/VAO binds and " << (double)totalAvoided / frames << " binds avoided per frame";
+        }
+        out << std::endl;
+    }
+
+    size_t Size() const { return sortedCount; }
+    SortKey SortedKey(size_t i) const { return sorted[i].key; }
+    const DrawItem& SortedItem(size_t i) const { return items[sorted[i].index]; }
+    const RenderQueueStats& Stats() const { return stats; }
+
+private:
+    struct SortEntry {
+        SortKey key;
+        unsigned index;
+    };
+
+    std::vector<SortKey> keys;
+    std::vector<DrawItem> items;
+    std::atomic<size_t> count;
+    std::mutex overflowLock;
+    std::vector<SortKey> overflowKeys;
+    std::vector<DrawItem> overflow;
+    std::vector<SortEntry> sorted;
+    std::vector<SortEntry> scratch;
+    size_t sortedCount;
+    unsigned submissionBinds;
+    RenderQueueStats stats;
+    unsigned long long frames;
+    unsigned long long totalDraws;
+    unsigned long long totalBinds;
+    long long totalAvoided;
+
+    void Reserve(size_t capacity)
+    {
+        keys.resize(capacity);
+        items.resize(capacity);
+    }
+};
+
+#endif
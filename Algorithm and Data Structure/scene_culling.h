@@ -0,0 +1,379 @@
+//=============================================================================
+// File Name: scene_culling.h
+// Version: 1.0
+//
+// Description: Bounding volumes, view-frustum extraction and a bounding
+// volume hierarchy (BVH) used to skip pyramids that are off screen before
+// they reach glDrawElements.
+//
+// Data Structures:
+// - BoundingBox / BoundingSphere are computed once per GLMesh from its
+//   vertex data and transformed by each object's model matrix.
+// - SceneBVH is a binary tree stored in a flat array. Each leaf holds up to
+//   four objects whose world spheres are kept in SoA form (x[], y[], z[],
+//   r[]) so a whole leaf is tested against a plane in one SSE operation.
+//
+// Time Complexity:
+// - Build: O(N log N) for N objects (median split on the longest axis).
+// - Refit: O(K log N) for K objects whose model matrix changed; a walk up
+//   the tree stops as soon as a parent box no longer changes.
+// - Cull: O(V + S) for V visible objects and S nodes tested against the
+//   planes. Every node under a fully inside node is still walked, but
+//   without plane tests. A node is tested when its parent straddles a
+//   plane, so S grows with the part of the scene along the frustum's
+//   boundary, up to O(N) when most of the scene lies across it.
+//=============================================================================
+
+#ifndef SCENE_CULLING_H
+#define SCENE_CULLING_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+// _mm_set1_epi32 and _mm_castsi128_ps below are SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SCENE_CULLING_SSE 1
+#endif
+
+struct BoundingBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+// Six planes (a, b, c, d) with the normal pointing into the frustum.
+// Order: left, right, bottom, top, near, far.
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Compute the local-space box of a mesh from its vertex array.
+inline BoundingBox UComputeMeshBounds(const float* vertices, unsigned nVertices, unsigned floatsPerVertex)
+{
+    BoundingBox box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (unsigned i = 0; i < nVertices; i++)
+    {
+        const float* v = vertices + i * floatsPerVertex;
+        glm::vec3 p(v[0], v[1], v[2]);
+        box.min = glm::min(box.min, p);
+        box.max = glm::max(box.max, p);
+    }
+    return box;
+}
+
+inline BoundingSphere USphereFromBounds(const BoundingBox& box)
+{
+    BoundingSphere sphere;
+    sphere.center = (box.min + box.max) * 0.5f;
+    sphere.radius = glm::length(box.max - sphere.center);
+    return sphere;
+}
+
+inline BoundingBox UMergeBounds(const BoundingBox& a, const BoundingBox& b)
+{
+    BoundingBox box = { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    return box;
+}
+
+// Transform a local box by a model matrix (Arvo's method): the result is the
+// tightest world-space AABB around the eight transformed corners.
+inline BoundingBox UTransformBounds(const BoundingBox& box, const glm::mat4& model)
+{
+    BoundingBox out;
+    for (int row = 0; row < 3; row++)
+    {
+        out.min[row] = out.max[row] = model[3][row];
+        for (int col = 0; col < 3; col++)
+        {
+            float a = model[col][row] * box.min[col];
+            float b = model[col][row] * box.max[col];
+            out.min[row] += std::min(a, b);
+            out.max[row] += std::max(a, b);
+        }
+    }
+    return out;
+}
+
+// Extract the frustum planes from projection * view (Gribb/Hartmann).
+// glm matrices are column-major, so row i is (m[0][i], m[1][i], m[2][i], m[3][i]).
+inline Frustum UExtractFrustum(const glm::mat4& viewProjection)
+{
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum f;
+    f.planes[0] = row3 + row0;
+    f.planes[1] = row3 - row0;
+    f.planes[2] = row3 + row1;
+    f.planes[3] = row3 - row1;
+    f.planes[4] = row3 + row2;
+    f.planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec4& p = f.planes[i];
+        float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = p * (1.0f / len);
+    }
+    return f;
+}
+
+enum CullResult { CULL_OUTSIDE, CULL_INTERSECT, CULL_INSIDE };
+
+// Classify a box against the frustum using the positive/negative vertex of
+// each plane.
+inline CullResult UCullBox(const Frustum& f, const BoundingBox& box)
+{
+    CullResult result = CULL_INSIDE;
+    for (int i = 0; i < 6; i++)
+    {
+        const glm::vec4& p = f.planes[i];
+        glm::vec3 positive(p.x >= 0 ? box.max.x : box.min.x,
+                           p.y >= 0 ? box.max.y : box.min.y,
+                           p.z >= 0 ? box.max.z : box.min.z);
+        glm::vec3 negative(p.x >= 0 ? box.min.x : box.max.x,
+                           p.y >= 0 ? box.min.y : box.max.y,
+                           p.z >= 0 ? box.min.z : box.max.z);
+
+        if (p.x * positive.x + p.y * positive.y + p.z * positive.z + p.w < 0)
+            return CULL_OUTSIDE;
+        if (p.x * negative.x + p.y * negative.y + p.z * negative.z + p.w < 0)
+            result = CULL_INTERSECT;
+    }
+    return result;
+}
+
+// Test four spheres (SoA) against the frustum. Bit i of the result is set
+// when sphere i is at least partially inside.
+inline int UCullSpheres4(const Frustum& f, const float* x, const float* y, const float* z, const float* r)
+{
+#ifdef SCENE_CULLING_SSE
+    __m128 cx = _mm_loadu_ps(x);
+    __m128 cy = _mm_loadu_ps(y);
+    __m128 cz = _mm_loadu_ps(z);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r));
+    __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+    for (int i = 0; i < 6; i++)
+    {
+        const glm::vec4& p = f.planes[i];
+        __m128 dist = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(p.x)), _mm_mul_ps(cy, _mm_set1_ps(p.y))),
+            _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(p.z)), _mm_set1_ps(p.w)));
+        visible = _mm_and_ps(visible, _mm_cmpge_ps(dist, negRadius));
+    }
+    return _mm_movemask_ps(visible);
+#else
+    int mask = 0;
+    for (int s = 0; s < 4; s++)
+    {
+        bool inside = true;
+        for (int i = 0; i < 6 && inside; i++)
+        {
+            const glm::vec4& p = f.planes[i];
+            inside = p.x * x[s] + p.y * y[s] + p.z * z[s] + p.w >= -r[s];
+        }
+        if (inside)
+            mask |= 1 << s;
+    }
+    return mask;
+#endif
+}
+
+class SceneBVH
+{
+public:
+    static const int LEAF_SIZE = 4;
+
+    // Build the tree from the current world boxes of every object.
+    void Build(const std::vector<BoundingBox>& worldBoxes)
+    {
+        int count = (int)worldBoxes.size();
+        boxes = worldBoxes;
+        nodes.clear();
+        order.resize(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+
+        leafOfObject.assign(count, -1);
+        slotOfObject.assign(count, -1);
+        slotX.clear(); slotY.clear(); slotZ.clear(); slotR.clear();
+        dirtyLeaves.clear();
+
+        if (count > 0)
+            BuildNode(0, count, -1);
+    }
+
+    // Record a new world box for an object whose model matrix changed.
+    // The tree is not touched until Refit() is called.
+    void UpdateObject(int object, const BoundingBox& worldBox)
+    {
+        boxes[object] = worldBox;
+
+        BoundingSphere s = USphereFromBounds(worldBox);
+        int slot = slotOfObject[object];
+        slotX[slot] = s.center.x;
+        slotY[slot] = s.center.y;
+        slotZ[slot] = s.center.z;
+        slotR[slot] = s.radius;
+
+        int leaf = leafOfObject[object];
+        if (!nodes[leaf].dirty)
+        {
+            nodes[leaf].dirty = true;
+            dirtyLeaves.push_back(leaf);
+        }
+    }
+
+    // Propagate changed leaves towards the root. Topology is kept, so call
+    // Build() again if objects have moved far from where they started.
+    void Refit()
+    {
+        for (size_t i = 0; i < dirtyLeaves.size(); i++)
+        {
+            int index = dirtyLeaves[i];
+            Node& leaf = nodes[index];
+            leaf.dirty = false;
+            leaf.box = boxes[order[leaf.first]];
+            for (int k = 1; k < leaf.count; k++)
+                leaf.box = UMergeBounds(leaf.box, boxes[order[leaf.first + k]]);
+
+            for (int parent = leaf.parent; parent >= 0; parent = nodes[parent].parent)
+            {
+                Node& node = nodes[parent];
+                BoundingBox merged = UMergeBounds(nodes[node.left].box, nodes[node.right].box);
+                if (SameBounds(merged, node.box))
+                    break;
+                node.box = merged;
+            }
+        }
+        dirtyLeaves.clear();
+    }
+
+    // Append the index of every object that intersects the frustum.
+    void Cull(const Frustum& f, std::vector<int>& visible) const
+    {
+        if (!nodes.empty())
+            CullNode(f, 0, false, visible);
+    }
+
+    int NodeCount() const { return (int)nodes.size(); }
+
+private:
+    struct Node {
+        BoundingBox box;
+        int left, right, parent;
+        int first, count;  // range in order[], count > 0 only for leaves
+        int slot;          // first SoA sphere slot for leaves
+        bool dirty;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<BoundingBox> boxes;
+    std::vector<int> order;
+    std::vector<int> leafOfObject;
+    std::vector<int> slotOfObject;
+    std::vector<int> dirtyLeaves;
+    std::vector<float> slotX, slotY, slotZ, slotR;
+
+    static bool SameBounds(const BoundingBox& a, const BoundingBox& b)
+    {
+        return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+               a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+    }
+
+    int BuildNode(int first, int count, int parent)
+    {
+        int index = (int)nodes.size();
+        nodes.push_back(Node());
+        Node node = {};
+        node.parent = parent;
+        node.left = node.right = -1;
+        node.box = boxes[order[first]];
+        for (int i = 1; i < count; i++)
+            node.box = UMergeBounds(node.box, boxes[order[first + i]]);
+
+        if (count <= LEAF_SIZE)
+        {
+            node.first = first;
+            node.count = count;
+            node.slot = (int)slotX.size();
+
+            // Pad every leaf to four slots; padding spheres have a huge
+            // negative radius so they never pass the SIMD test.
+            for (int i = 0; i < LEAF_SIZE; i++)
+            {
+                float x = 0, y = 0, z = 0, r = -FLT_MAX;
+                if (i < count)
+                {
+                    int object = order[first + i];
+                    BoundingSphere s = USphereFromBounds(boxes[object]);
+                    x = s.center.x; y = s.center.y; z = s.center.z; r = s.radius;
+                    leafOfObject[object] = index;
+                    slotOfObject[object] = node.slot + i;
+                }
+                slotX.push_back(x); slotY.push_back(y); slotZ.push_back(z); slotR.push_back(r);
+            }
+            nodes[index] = node;
+            return index;
+        }
+
+        // Split at the median centroid along the longest axis.
+        glm::vec3 extent = node.box.max - node.box.min;
+        int axis = 0;
+        if (extent.y > extent[axis]) axis = 1;
+        if (extent.z > extent[axis]) axis = 2;
+
+        int half = count / 2;
+        const std::vector<BoundingBox>& b = boxes;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+            [&b, axis](int l, int r) { return b[l].min[axis] + b[l].max[axis] < b[r].min[axis] + b[r].max[axis]; });
+
+        nodes[index] = node;
+        int left = BuildNode(first, half, index);
+        int right = BuildNode(first + half, count - half, index);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+
+    void CullNode(const Frustum& f, int index, bool inside, std::vector<int>& visible) const
+    {
+        const Node& node = nodes[index];
+        if (!inside)
+        {
+            CullResult result = UCullBox(f, node.box);
+            if (result == CULL_OUTSIDE)
+                return;
+            inside = result == CULL_INSIDE;
+        }
+
+        if (node.count > 0)
+        {
+            int mask = inside ? (1 << node.count) - 1
+                : UCullSpheres4(f, &slotX[node.slot], &slotY[node.slot], &slotZ[node.slot], &slotR[node.slot]);
+            for (int i = 0; i < node.count; i++)
+            {
+                if (mask & (1 << i))
+                    visible.push_back(order[node.first + i]);
+            }
+            return;
+        }
+
+        CullNode(f, node.left, inside, visible);
+        CullNode(f, node.right, inside, visible);
+    }
+};
+
+#endif
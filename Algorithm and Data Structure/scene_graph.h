@@ -0,0 +1,215 @@
+//=============================================================================
+// File Name: scene_graph.h
+// Version: 1.0
+//
+// Description: Parent/child transform hierarchy for the pyramid scene,
+// built on linmath.h mat4x4 and quat. Local transforms (translation,
+// rotation, scale) and cached world matrices live in flat arrays; only
+// subtrees under a node whose local transform changed are recomputed.
+//
+// Data Structures:
+// - Nodes are stored in depth-first pre-order, so every parent comes before
+//   its children and a node's whole subtree is the contiguous range
+//   [slot, subtreeEnd[slot]). Finalize() sorts nodes into this order after
+//   they have been added; node ids returned by AddNode() stay valid.
+// - A dirty list records the nodes whose local transform was set since the
+//   last UpdateWorld().
+//
+// Time Complexity:
+// - UpdateWorld(): O(K log K + S) where K is the number of dirty nodes and
+//   S the total size of their subtrees. Clean parts of the scene are not
+//   visited at all, so a large static scene with a few moving nodes costs
+//   only what moved.
+//=============================================================================
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cmath> // linmath.h uses sqrtf, sinf and cosf without including it
+#include "linmath.h"
+#include <algorithm>
+#include <vector>
+
+class SceneGraph
+{
+public:
+    // Add a node under parent (-1 for a root) and return its id. Call
+    // Finalize() once all nodes have been added.
+    int AddNode(int parent)
+    {
+        int id = (int)parentOfId.size();
+        parentOfId.push_back(parent);
+        return id;
+    }
+
+    // Sort the nodes into depth-first pre-order and reset every transform
+    // to identity.
+    void Finalize()
+    {
+        int count = (int)parentOfId.size();
+        std::vector<std::vector<int> > children(count);
+        std::vector<int> roots;
+        for (int id = 0; id < count; id++)
+        {
+            if (parentOfId[id] < 0)
+                roots.push_back(id);
+            else
+                children[parentOfId[id]].push_back(id);
+        }
+
+        slotOfId.assign(count, -1);
+        idOfSlot.clear();
+        parent.assign(count, -1);
+        subtreeEnd.assign(count, 0);
+
+        // Iterative DFS: push a marker (-id - 1) to close a subtree
+        std::vector<int> stack(roots.rbegin(), roots.rend());
+        while (!stack.empty())
+        {
+            int id = stack.back();
+            stack.pop_back();
+            if (id < 0)
+            {
+                subtreeEnd[slotOfId[-id - 1]] = (int)idOfSlot.size();
+                continue;
+            }
+
+            int slot = (int)idOfSlot.size();
+            slotOfId[id] = slot;
+            idOfSlot.push_back(id);
+            parent[slot] = parentOfId[id] < 0 ? -1 : slotOfId[parentOfId[id]];
+
+            stack.push_back(-id - 1);
+            for (size_t c = children[id].size(); c-- > 0;)
+                stack.push_back(children[id][c]);
+        }
+
+        translation.assign(count * 3, 0.0f);
+        rotation.assign(count * 4, 0.0f);
+        scale.assign(count * 3, 1.0f);
+        local.resize(count);
+        world.resize(count);
+        dirty.assign(count, 1);
+        dirtySlots.clear();
+        for (int slot = 0; slot < count; slot++)
+        {
+            rotation[slot * 4 + 3] = 1.0f;
+            if (parent[slot] < 0)
+                dirtySlots.push_back(slot);
+        }
+    }
+
+    void SetTranslation(int id, float x, float y, float z)
+    {
+        int slot = slotOfId[id];
+        translation[slot * 3 + 0] = x;
+        translation[slot * 3 + 1] = y;
+        translation[slot * 3 + 2] = z;
+        MarkDirty(slot);
+    }
+
+    void SetRotation(int id, quat q)
+    {
+        int slot = slotOfId[id];
+        for (int i = 0; i < 4; i++)
+            rotation[slot * 4 + i] = q[i];
+        MarkDirty(slot);
+    }
+
+    void SetScale(int id, float x, float y, float z)
+    {
+        int slot = slotOfId[id];
+        scale[slot * 3 + 0] = x;
+        scale[slot * 3 + 1] = y;
+        scale[slot * 3 + 2] = z;
+        MarkDirty(slot);
+    }
+
+    // Recompute world matrices for every dirty subtree in one linear pass
+    // per subtree. The ids of all nodes whose world matrix changed are
+    // available from ChangedNodes() until the next call.
+    void UpdateWorld()
+    {
+        changedIds.clear();
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+
+        int coveredEnd = 0;
+        for (size_t d = 0; d < dirtySlots.size(); d++)
+        {
+            int first = dirtySlots[d];
+            if (first < coveredEnd)
+                continue; // already updated as part of an ancestor's subtree
+
+            int end = subtreeEnd[first];
+            for (int slot = first; slot < end; slot++)
+            {
+                if (dirty[slot])
+                {
+                    BuildLocal(slot);
+                    dirty[slot] = 0;
+                }
+                if (parent[slot] < 0)
+                    mat4x4_dup(world[slot].m, local[slot].m);
+                else
+                    mat4x4_mul(world[slot].m, world[parent[slot]].m, local[slot].m);
+                changedIds.push_back(idOfSlot[slot]);
+            }
+            coveredEnd = end;
+        }
+        dirtySlots.clear();
+    }
+
+    // Column-major world matrix of a node, ready for glUniformMatrix4fv
+    const float* WorldMatrix(int id) const { return &world[slotOfId[id]].m[0][0]; }
+
+    const std::vector<int>& ChangedNodes() const { return changedIds; }
+
+    int NodeCount() const { return (int)idOfSlot.size(); }
+
+private:
+    // Wrapped so the matrices can live in a std::vector
+    struct Matrix { mat4x4 m; };
+
+    std::vector<int> parentOfId;  // as given to AddNode
+    std::vector<int> slotOfId;
+    std::vector<int> idOfSlot;
+
+    // Per slot, in pre-order
+    std::vector<int> parent;
+    std::vector<int> subtreeEnd;
+    std::vector<float> translation; // xyz
+    std::vector<float> rotation;    // quat xyzw
+    std::vector<float> scale;       // xyz
+    std::vector<Matrix> local;
+    std::vector<Matrix> world;
+    std::vector<unsigned char> dirty;
+
+    std::vector<int> dirtySlots;
+    std::vector<int> changedIds;
+
+    void MarkDirty(int slot)
+    {
+        if (!dirty[slot])
+        {
+            dirty[slot] = 1;
+            dirtySlots.push_back(slot);
+        }
+    }
+
+    // local = T * R * S
+    void BuildLocal(int slot)
+    {
+        mat4x4& m = local[slot].m;
+        mat4x4_from_quat(m, &rotation[slot * 4]);
+        for (int c = 0; c < 3; c++)
+        {
+            for (int r = 0; r < 3; r++)
+                m[c][r] *= scale[slot * 3 + c];
+        }
+        m[3][0] = translation[slot * 3 + 0];
+        m[3][1] = translation[slot * 3 + 1];
+        m[3][2] = translation[slot * 3 + 2];
+    }
+};
+
+#endif
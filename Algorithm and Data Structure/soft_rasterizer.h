@@ -0,0 +1,385 @@
+//=============================================================================
+// File Name: soft_rasterizer.h
+// Version: 1.0
+//
+// Description: CPU rasterizer used in place of OpenGL on machines without a
+// GPU. It consumes the same vertex/index arrays that UCreateMesh uploads
+// and the same model/view/projection matrices as URender, and writes an
+// RGBA color buffer plus a depth buffer.
+//
+// Algorithmic Logic:
+// - DrawIndexed() transforms vertices to clip space and clips each
+//   triangle against w > RASTER_CLIP_EPSILON and the near plane (z > -w), which
+//   leaves a convex polygon of up to five vertices to fan into triangles.
+//   Every screen position is then finite and in range for the int bounds.
+// - Each triangle gets its three edge functions and depth plane and is
+//   binned into each TILE_SIZE x TILE_SIZE screen tile its bounding box
+//   touches.
+// - A pixel center exactly on an edge belongs to the triangle only if the
+//   edge is a top or left edge, so pixels on an edge shared by two
+//   triangles are drawn once, not twice or never.
+// - Flush() hands tiles to the persistent ThreadPool (thread_pool.h),
+//   which claims them through an atomic counter. Each tile is owned by
+//   exactly one thread, so color and depth writes need no locking. Edge
+//   functions and depth are evaluated four pixels at a time with SSE
+//   (scalar fallback otherwise).
+// - SetViewport() renders into the top left corner of the buffers at a
+//   smaller size, for dynamic resolution; the buffers are never resized.
+//
+// Time Complexity:
+// - Setup is O(T) for T triangles; rasterization is O(P) for P covered
+//   pixels, split across the worker threads.
+//=============================================================================
+
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <vector>
+#include "thread_pool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_RASTERIZER_SSE 1
+#endif
+
+const float RASTER_CLIP_EPSILON = 1e-5f; // smallest w kept by the clipper
+
+struct RasterStats {
+    unsigned long long triangles;  // triangles set up and binned
+    unsigned long long pixels;     // pixels that passed the depth test
+    double seconds;                // time spent in DrawIndexed and Flush
+};
+
+class SoftRasterizer
+{
+public:
+    static const int TILE_SIZE = 64;
+    static const int MAX_CLIPPED_VERTICES = 5; // a triangle clipped by two planes
+
+    SoftRasterizer(int w, int h, int threads = 0)
+        : width(w), height(h), maxWidth(w), maxHeight(h), pool(threads)
+    {
+        // Round the row pitch up to a multiple of four for the SIMD loop
+        pitch = (width + 3) & ~3;
+        color.assign(pitch * height, 0);
+        depth.assign(pitch * height, 1.0f);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+        bins.resize(tilesX * tilesY);
+        ResetStats();
+    }
+
+    // Render at w x h (at most the constructed size) from the next frame
+    void SetViewport(int w, int h)
+    {
+        width = std::min(std::max(w, 1), maxWidth);
+        height = std::min(std::max(h, 1), maxHeight);
+        tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+        tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    }
+
+    // Clears the viewport only
+    void Clear(unsigned clearColor)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            std::fill(color.begin() + y * pitch, color.begin() + y * pitch + width, clearColor);
+            std::fill(depth.begin() + y * pitch, depth.begin() + y * pitch + width, 1.0f);
+        }
+    }
+
+    // Transform, set up and bin indexed triangles. Triangle i is shaded
+    // with faceColors[i % nColors].
+    void DrawIndexed(const float* vertices, int floatsPerVertex, const unsigned short* indices, int nIndices,
+                     const glm::mat4& mvp, const glm::vec4* faceColors, int nColors)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int t = 0; t + 2 < nIndices; t += 3)
+        {
+            glm::vec4 clip[MAX_CLIPPED_VERTICES], clippedW[MAX_CLIPPED_VERTICES];
+            for (int k = 0; k < 3; k++)
+            {
+                const float* v = vertices + indices[t + k] * floatsPerVertex;
+                clip[k] = mvp * glm::vec4(v[0], v[1], v[2], 1.0f);
+            }
+            int count = ClipPolygon(clip, 3, clippedW, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f), RASTER_CLIP_EPSILON);
+            count = ClipPolygon(clippedW, count, clip, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), 0.0f);
+            if (count < 3)
+                continue;
+
+            glm::vec3 screen[MAX_CLIPPED_VERTICES];
+            for (int k = 0; k < count; k++)
+            {
+                float invW = 1.0f / clip[k].w;
+                screen[k] = glm::vec3((clip[k].x * invW * 0.5f + 0.5f) * width,
+                                      (0.5f - clip[k].y * invW * 0.5f) * height,
+                                      clip[k].z * invW * 0.5f + 0.5f);
+            }
+            unsigned packedColor = PackColor(faceColors[(t / 3) % nColors]);
+            for (int k = 1; k + 1 < count; k++)
+            {
+                glm::vec3 fan[3] = { screen[0], screen[k], screen[k + 1] };
+                SetupTriangle(fan, packedColor);
+            }
+        }
+
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Rasterize every binned triangle and empty the bins
+    void Flush()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::atomic<unsigned long long> pixelCount(0);
+        auto rasterize = [this, &pixelCount](int begin, int end)
+        {
+            unsigned long long local = 0;
+            for (int tile = begin; tile < end; tile++)
+                local += RasterizeTile(tile);
+            pixelCount += local;
+        };
+        pool.ParallelFor(tilesX * tilesY, 1, rasterize);
+
+        for (size_t i = 0; i < bins.size(); i++)
+            bins[i].clear();
+        triangles.clear();
+
+        stats.pixels += pixelCount.load();
+        stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    const RasterStats& Stats() const { return stats; }
+    void ResetStats() { stats.triangles = 0; stats.pixels = 0; stats.seconds = 0.0; }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Pitch() const { return pitch; }
+    const unsigned* Pixels() const { return color.data(); }
+
+    // Save the viewport as a binary PPM image
+    bool WritePPM(const char* path) const { return WritePPM(path, color.data(), width, height, pitch); }
+
+    static bool WritePPM(const char* path, const unsigned* pixels, int w, int h, int rowPitch)
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+        file << "P6\n" << w << " " << h << "\n255\n";
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                unsigned c = pixels[y * rowPitch + x];
+                char rgb[3] = { (char)(c & 0xFF), (char)((c >> 8) & 0xFF), (char)((c >> 16) & 0xFF) };
+                file.write(rgb, 3);
+            }
+        }
+        return (bool)file;
+    }
+
+private:
+    // Edge function E(x, y) = a * x + b * y + c, positive inside. A pixel
+    // with E == 0 is inside only for a top or left edge.
+    struct Triangle {
+        float a[3], b[3], c[3];
+        bool topLeft[3];
+        float zA, zB, zC;      // depth plane z = zA * x + zB * y + zC
+        int minX, minY, maxX, maxY;
+        unsigned color;
+    };
+
+    int width, height, pitch;
+    int maxWidth, maxHeight;   // size of the buffers
+    ThreadPool pool;
+    int tilesX, tilesY;
+    std::vector<unsigned> color;
+    std::vector<float> depth;
+    std::vector<Triangle> triangles;
+    std::vector<std::vector<int> > bins;
+    RasterStats stats;
+
+    static unsigned PackColor(const glm::vec4& c)
+    {
+        unsigned r = (unsigned)(std::min(std::max(c.x, 0.0f), 1.0f) * 255.0f + 0.5f);
+        unsigned g = (unsigned)(std::min(std::max(c.y, 0.0f), 1.0f) * 255.0f + 0.5f);
+        unsigned b = (unsigned)(std::min(std::max(c.z, 0.0f), 1.0f) * 255.0f + 0.5f);
+        unsigned a = (unsigned)(std::min(std::max(c.w, 0.0f), 1.0f) * 255.0f + 0.5f);
+        return r | (g << 8) | (b << 16) | (a << 24);
+    }
+
+    // Sutherland-Hodgman: keep the part of a convex polygon where
+    // dot(plane, v) >= offset. Returns the vertex count written to out,
+    // at most one more than count.
+    static int ClipPolygon(const glm::vec4* in, int count, glm::vec4* out, const glm::vec4& plane, float offset)
+    {
+        int written = 0;
+        for (int k = 0; k < count; k++)
+        {
+            const glm::vec4& p = in[k];
+            const glm::vec4& q = in[(k + 1) % count];
+            float dp = glm::dot(plane, p) - offset;
+            float dq = glm::dot(plane, q) - offset;
+            if (dp >= 0.0f)
+                out[written++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                out[written++] = p + (q - p) * (dp / (dp - dq));
+        }
+        return written;
+    }
+
+    void SetupTriangle(const glm::vec3* v, unsigned packedColor)
+    {
+        float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+        if (std::fabs(area) < 1e-8f)
+            return;
+
+        Triangle tri;
+        // No face culling (URender doesn't enable it either), so flip the
+        // edges of clockwise triangles to keep "inside" positive.
+        float sign = area > 0 ? 1.0f : -1.0f;
+        for (int e = 0; e < 3; e++)
+        {
+            const glm::vec3& p = v[e];
+            const glm::vec3& q = v[(e + 1) % 3];
+            tri.a[e] = sign * (p.y - q.y);
+            tri.b[e] = sign * (q.x - p.x);
+            tri.c[e] = sign * (p.x * q.y - p.y * q.x);
+            // y grows downward: a left edge has inside to its right
+            // (a > 0), a top edge is horizontal with inside below (b > 0)
+            tri.topLeft[e] = tri.a[e] > 0.0f || (tri.a[e] == 0.0f && tri.b[e] > 0.0f);
+        }
+
+        // Depth plane through the three vertices
+        float invArea = 1.0f / area;
+        float dz1 = v[1].z - v[0].z, dz2 = v[2].z - v[0].z;
+        tri.zA = (dz1 * (v[2].y - v[0].y) - dz2 * (v[1].y - v[0].y)) * invArea;
+        tri.zB = (dz2 * (v[1].x - v[0].x) - dz1 * (v[2].x - v[0].x)) * invArea;
+        tri.zC = v[0].z - tri.zA * v[0].x - tri.zB * v[0].y;
+
+        // Reject off-screen boxes, then clamp in float so the int
+        // conversions below are always in range
+        float minX = std::min(v[0].x, std::min(v[1].x, v[2].x));
+        float minY = std::min(v[0].y, std::min(v[1].y, v[2].y));
+        float maxX = std::max(v[0].x, std::max(v[1].x, v[2].x));
+        float maxY = std::max(v[0].y, std::max(v[1].y, v[2].y));
+        if (!(maxX >= 0.0f && maxY >= 0.0f && minX < (float)width && minY < (float)height))
+            return;
+        tri.minX = (int)std::floor(std::max(minX, 0.0f));
+        tri.minY = (int)std::floor(std::max(minY, 0.0f));
+        tri.maxX = std::min(width - 1, (int)std::ceil(std::min(maxX, (float)width)));
+        tri.maxY = std::min(height - 1, (int)std::ceil(std::min(maxY, (float)height)));
+        tri.color = packedColor;
+
+        int index = (int)triangles.size();
+        triangles.push_back(tri);
+        stats.triangles++;
+
+        for (int ty = tri.minY / TILE_SIZE; ty <= tri.maxY / TILE_SIZE; ty++)
+            for (int tx = tri.minX / TILE_SIZE; tx <= tri.maxX / TILE_SIZE; tx++)
+                bins[ty * tilesX + tx].push_back(index);
+    }
+
+    // Rasterize the triangles binned to one tile, in submission order.
+    // Returns the number of pixels written.
+    unsigned long long RasterizeTile(int tile)
+    {
+        const std::vector<int>& bin = bins[tile];
+        if (bin.empty())
+            return 0;
+
+        int tileX0 = (tile % tilesX) * TILE_SIZE;
+        int tileY0 = (tile / tilesX) * TILE_SIZE;
+        int tileX1 = std::min(tileX0 + TILE_SIZE, width) - 1;
+        int tileY1 = std::min(tileY0 + TILE_SIZE, height) - 1;
+        unsigned long long written = 0;
+
+        for (size_t i = 0; i < bin.size(); i++)
+        {
+            const Triangle& tri = triangles[bin[i]];
+            int x0 = std::max(tri.minX, tileX0) & ~3; // start on a 4-pixel boundary
+            int x1 = std::min(tri.maxX, tileX1);
+            int y0 = std::max(tri.minY, tileY0);
+            int y1 = std::min(tri.maxY, tileY1);
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                unsigned* colorRow = &color[y * pitch];
+                float* depthRow = &depth[y * pitch];
+                for (int x = x0; x <= x1; x += 4)
+                    written += ShadeQuad(tri, x, py, colorRow, depthRow, x1);
+            }
+        }
+        return written;
+    }
+
+    // Evaluate four horizontally adjacent pixels starting at x
+    int ShadeQuad(const Triangle& tri, int x, float py, unsigned* colorRow, float* depthRow, int lastX)
+    {
+#ifdef SOFT_RASTERIZER_SSE
+        __m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int e = 0; e < 3; e++)
+        {
+            __m128 edge = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.a[e]), px),
+                                     _mm_set1_ps(tri.b[e] * py + tri.c[e]));
+            inside = _mm_and_ps(inside, tri.topLeft[e] ? _mm_cmpge_ps(edge, _mm_setzero_ps())
+                                                       : _mm_cmpgt_ps(edge, _mm_setzero_ps()));
+        }
+
+        // Mask off pixels past the right edge of the tile/triangle box
+        __m128 limit = _mm_set1_ps(lastX + 0.5f);
+        inside = _mm_and_ps(inside, _mm_cmple_ps(px, limit));
+        if (_mm_movemask_ps(inside) == 0)
+            return 0;
+
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.zA), px), _mm_set1_ps(tri.zB * py + tri.zC));
+        __m128 oldZ = _mm_loadu_ps(depthRow + x);
+        __m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(z, oldZ));
+        int mask = _mm_movemask_ps(pass);
+        if (mask == 0)
+            return 0;
+
+        _mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, z), _mm_andnot_ps(pass, oldZ)));
+        __m128i passBits = _mm_castps_si128(pass);
+        __m128i oldColor = _mm_loadu_si128((const __m128i*)(colorRow + x));
+        __m128i newColor = _mm_set1_epi32((int)tri.color);
+        _mm_storeu_si128((__m128i*)(colorRow + x),
+            _mm_or_si128(_mm_and_si128(passBits, newColor), _mm_andnot_si128(passBits, oldColor)));
+
+        return (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+#else
+        int count = 0;
+        for (int i = 0; i < 4 && x + i <= lastX; i++)
+        {
+            float px = x + i + 0.5f;
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+            {
+                float edge = tri.a[e] * px + tri.b[e] * py + tri.c[e];
+                inside = inside && (edge > 0.0f || (edge == 0.0f && tri.topLeft[e]));
+            }
+            if (!inside)
+                continue;
+            float z = tri.zA * px + tri.zB * py + tri.zC;
+            if (z < depthRow[x + i])
+            {
+                depthRow[x + i] = z;
+                colorRow[x + i] = tri.color;
+                count++;
+            }
+        }
+        return count;
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,145 @@
+//=============================================================================
+// File Name: thread_pool.h
+// Version: 1.0
+//
+// Description: Persistent worker threads for data-parallel loops.
+// ParallelFor(count, grain, body) calls body(begin, end) on chunks of
+// [0, count) from every worker plus the calling thread and returns when all
+// chunks are done. Workers sleep on a condition variable between calls, so
+// a step of the batch environment costs a wake-up, not a thread creation.
+//
+// Algorithmic Logic:
+// - Chunks of grain items are claimed through an atomic counter, so fast
+//   threads take more chunks and uneven work balances itself.
+// - The loop body is passed as a pointer plus a trampoline instead of a
+//   std::function, so dispatching never allocates.
+//=============================================================================
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // threads counts the calling thread; 0 means one per hardware thread
+    explicit ThreadPool(int threads = 0) : generation(0), stop(false), busy(0)
+    {
+        int total = threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 1; i < total; i++)
+            workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    template <typename Body>
+    void ParallelFor(int count, int grain, Body& body)
+    {
+        if (count <= 0)
+            return;
+        if (workers.empty() || count <= grain)
+        {
+            body(0, count);
+            return;
+        }
+        Dispatch(&Trampoline<Body>, &body, count, grain);
+    }
+
+    int ThreadCount() const { return (int)workers.size() + 1; }
+
+private:
+    typedef void (*JobFunc)(void* body, int begin, int end);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    unsigned generation;  // bumped for every ParallelFor
+    bool stop;
+    int busy;             // workers still inside the current job
+
+    // Current job
+    JobFunc job;
+    void* jobBody;
+    int jobCount;
+    int jobGrain;
+    std::atomic<int> nextItem;
+
+    template <typename Body>
+    static void Trampoline(void* body, int begin, int end)
+    {
+        (*static_cast<Body*>(body))(begin, end);
+    }
+
+    void Dispatch(JobFunc func, void* body, int count, int grain)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = func;
+            jobBody = body;
+            jobCount = count;
+            jobGrain = std::max(1, grain);
+            nextItem.store(0);
+            busy = (int)workers.size();
+            generation++;
+        }
+        wake.notify_all();
+
+        RunChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy == 0; });
+    }
+
+    void RunChunks()
+    {
+        for (;;)
+        {
+            int begin = nextItem.fetch_add(jobGrain);
+            if (begin >= jobCount)
+                return;
+            job(jobBody, begin, std::min(begin + jobGrain, jobCount));
+        }
+    }
+
+    void WorkerLoop()
+    {
+        unsigned seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this, seen] { return stop || generation != seen; });
+                if (stop)
+                    return;
+                seen = generation;
+            }
+
+            RunChunks();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+                finished.notify_one();
+        }
+    }
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+};
+
+#endif
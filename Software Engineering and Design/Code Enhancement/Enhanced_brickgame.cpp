@@ -16,10 +16,17 @@
 
 //Decisions Made :
 //Paddle Dimensions : The paddle's width and height were defined as paddleWidth and paddleHeight.
-//Paddle Movement : The processInput function was updated to handle left and right arrow key presses, ensuring the paddle stays within the screen boundaries.
-//Lives Tracking : Introduced a lives variable to keep track of remaining lives, displayed on the screen using glRasterPos2f and glutBitmapCharacter.
+//Paddle Movement : The keyCallback function records left and right arrow key presses with timestamps, ensuring the paddle stays within the screen boundaries.
+//Lives Tracking : Introduced a lives variable to keep track of remaining lives, displayed on the screen by the HUD text
+//renderer in hud_text.h (it replaced glRasterPos2f and glutBitmapCharacter, which draw one glyph per call).
 //Collision Detection : Implemented collision detection between the ball and the paddle.If the ball hits the bottom edge of the screen, a life is lost.
 //End Game Logic : The game ends if all lives are lost, closing the window and terminating the program.
+//Structure : The game itself is StepGame on a GameState in brick_game.h, stepped at 60 Hz on a simulation thread and
+//drawn by the main thread. Each subsystem header describes its own design; this file wires them to the window and to
+//the command line.
+//Command Line : --record/--replay <file>, --make-seekable <in> <out>, --server <port>, --connect <host:port>,
+//--ecs-arena, --stream-level [dir], --present <mode>, --fps <hz> and --background-fps <hz>. The --bench-* and
+//--test-removal/--net-test modes run headless checks and timings.
 //===========================================================================================================================
 
 
@@ -29,224 +36,1011 @@
 #include <stdio.h>
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "net_game.h" // winsock2.h has to come before windows.h
 #include <windows.h>
 #include <time.h>
+#include "brick_game.h"
+#include "triple_buffer.h"
+#include "input_queue.h"
+#include "replay.h"
+#include "batch_env.h"
+#include "rollback.h"
+#include "seekable_replay.h"
+#include "ecs_arena.h"
+#include "particles.h"
+#include "stream_level.h"
+#include "hud_text.h"
+#include "frame_pacer.h"
 
 using namespace std;
 
-const float DEG2RAD = 3.14159 / 180;
-
 // Function to handle keyboard input
-void processInput(GLFWwindow* window);
+void keyCallback(GLFWwindow* window, int key, int, int action, int);
+void gatherTickInput(double tickStart, TickInput& input);
+
+// Count every heap allocation on the thread that makes it, so the
+// simulation can check that its loop never allocates
+void* operator new(size_t size)
+{
+    ThreadAllocationCount()++;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+        throw bad_alloc();
+    return p;
+}
 
-enum BRICKTYPE { REFLECTIVE, DESTRUCTABLE };
-enum ONOFF { ON, OFF };
+// Kept out of line: GCC inlines free() into library code that got its
+// memory from operator new and warns about a new/free mismatch
+#ifdef __GNUC__
+__attribute__((noinline))
+#endif
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
 
-class Brick
+void operator delete(void* p, size_t) noexcept
 {
-public:
-    float red, green, blue;
-    float x, y, width;
-    BRICKTYPE brick_type;
-    ONOFF onoff;
-    int hit_points;
-
-    // Constructor for Brick class
-    Brick(BRICKTYPE bt, float xx, float yy, float ww, float rr, float gg, float bb)
+    operator delete(p);
+}
+
+// A published copy of the game plus the time its tick became current
+struct GameSnapshot {
+    GameState state;
+    double tickTime = 0.0;
+};
+
+KeyEventQueue keyEvents;
+FramePacer framePacer;
+TripleBuffer<GameSnapshot> snapshots;
+atomic<bool> simRunning{ true };
+
+// Session recording (--record <file>)
+unsigned sessionSeed;
+bool recording = false;
+SessionLog sessionLog;
+
+// The local game and its tick clock. Each tick publishes a snapshot for
+// the renderer. Normally the simulation thread steps it; in low-latency
+// mode the render thread does, right after polling input.
+struct LocalSimulation {
+    GameState state;
+    FrameArena scratch;
+    double nextTick;
+
+    // Allocations made by the tick itself (input, step, publish) after the
+    // first one. Recording is excluded: the log grows by design.
+    unsigned long long tickAllocations;
+    unsigned ticks;
+
+    LocalSimulation() : scratch(TICK_SCRATCH_BYTES), nextTick(0.0), tickAllocations(0), ticks(0) {}
+
+    void Start(double now)
     {
-        brick_type = bt; x = xx; y = yy; width = ww; red = rr, green = gg, blue = bb;
-        onoff = ON;
-        if (brick_type == DESTRUCTABLE) {
-            hit_points = 5; // initialize hit points for destructible bricks
-        }
-    };
+        ResetGame(state, sessionSeed);
+        sessionLog.Begin(sessionSeed);
+        nextTick = now;
+    }
 
-    // Draw the brick on the screen
-    void drawBrick()
+    // Run the next tick if it is due by now + early; false if it is not
+    bool StepIfDue(double now, double early)
     {
-        if (onoff == ON)
-        {
-            double halfside = width / 5;
+        if (now + early < nextTick)
+            return false;
 
-            glColor3d(red, green, blue);
-            glBegin(GL_POLYGON);
+        unsigned long long allocationsBefore = ThreadAllocationCount();
 
-            glVertex2d(x + halfside, y + halfside);
-            glVertex2d(x + halfside, y - halfside);
-            glVertex2d(x - halfside, y - halfside);
-            glVertex2d(x - halfside, y + halfside);
+        // This tick covers the SIM_TICK seconds that end at nextTick
+        TickInput input;
+        gatherTickInput(nextTick - SIM_TICK, input);
+        StepGame(state, input, scratch);
 
-            glEnd();
-        }
+        // Don't try to catch up on more than a quarter second of ticks
+        nextTick += SIM_TICK;
+        if (now - nextTick > 0.25)
+            nextTick = now;
+
+        GameSnapshot& snapshot = snapshots.WriteSlot();
+        snapshot.state = state;
+        snapshot.tickTime = now;
+        snapshots.Publish();
+
+        if (ticks++ > 0)
+            tickAllocations += ThreadAllocationCount() - allocationsBefore;
+
+        if (recording)
+            sessionLog.RecordTick(input, HashGameState(state));
+        return true;
+    }
+
+    void Report()
+    {
+        cout << "Heap allocations in " << (ticks > 0 ? ticks - 1 : 0) << " ticks after the first: " << tickAllocations << endl;
     }
 };
 
-class Circle
+LocalSimulation localSim;
+
+// Simulation thread: advances the game at a fixed rate, independent of how
+// long rendering or glfwSwapBuffers take
+void simulationThread()
 {
-public:
-    float red, green, blue;
-    float radius;
-    float x;
-    float y;
-    float speed = 0.09;
-    int direction; // 1=up, 2=right, 3=down, 4=left, 5=up right, 6=up left, 7=down right, 8=down left
-
-    // Constructor for Circle class
-    Circle(double xx, double yy, double rr, int dir, float rad, float r, float g, float b)
+    localSim.Start(glfwGetTime());
+    while (simRunning.load())
     {
-        x = xx;
-        y = yy;
-        radius = rr;
-        red = r;
-        green = g;
-        blue = b;
-        radius = rad;
-        direction = dir;
-    }
-
-    // Check collision of circle with a brick
-    void CheckCollision(Brick* brk)
+        double now = glfwGetTime();
+        if (!localSim.StepIfDue(now, 0.0))
+            this_thread::sleep_for(chrono::duration<double>(localSim.nextTick - now));
+    }
+    localSim.Report();
+}
+
+// Input for one benchmark tick: random arrow keys, a launch every 10 ticks
+void randomTickInput(GameRandom& rng, unsigned tick, TickInput& input)
+{
+    input = TickInput();
+    unsigned keys = rng.Next();
+    input.Add(0.0f, KEY_LEFT, (keys & 1) != 0);
+    input.Add(0.0f, KEY_RIGHT, (keys & 2) != 0);
+    if (tick % 10 == 0) {
+        input.Add(0.5f, KEY_LAUNCH, true);
+        input.Add(0.6f, KEY_LAUNCH, false);
+    }
+}
+
+// Every tick, roll back ROLLBACK_FRAMES ticks and re-simulate them with
+// the same input, as a rollback client does when a late input arrives.
+// The game starts with a full pool of small balls so the state is busy.
+// Checks the result against a game that never rolled back.
+int benchmarkRollback()
+{
+    const int warmup = 60;
+    const int ticks = 2000;
+
+    static GameState reference, copied;
+    GameRandom rng;
+    rng.Seed(5);
+    ResetGame(reference, 11);
+    reference.lives = 1000000; // keep the game going; balls are lost all the time
+    while (!reference.world.full()) {
+        float x = (rng.Next() % 18000) / 10000.0f - 0.9f;
+        float y = (rng.Next() % 18000) / 10000.0f - 0.9f;
+        Circle ball(x, y, 0.02, rng.Next() % 8 + 1, 0.02, 1.0f, 1.0f, 1.0f);
+        ball.speed = 0.002f; // slow, so the field stays busy for the whole run
+        reference.world.Add(ball);
+    }
+    copied = reference;
+
+    static RollbackBuffer<ROLLBACK_FRAMES> buffer;
+    FrameArena scratch(TICK_SCRATCH_BYTES);
+
+    double copySeconds = 0.0, copyWorst = 0.0;
+    unsigned long long balls = 0;
+    int mismatches = 0;
+    for (int t = 0; t < warmup + ticks; t++) {
+        TickInput input;
+        randomTickInput(rng, reference.tick, input);
+        StepGame(reference, input, scratch);
+
+        buffer.Record(copied, input);
+        StepGame(copied, input, scratch);
+
+        if (t < warmup)
+            continue;
+
+        // Restore the start of the oldest tick held and simulate forward again
+        unsigned from = copied.tick - ROLLBACK_FRAMES;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        buffer.Rollback(copied, from, buffer.InputAt(from), scratch);
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        copySeconds += seconds;
+        copyWorst = max(copyWorst, seconds);
+
+        balls += reference.world.size();
+        unsigned expected = HashGameState(reference);
+        if (HashGameState(copied) != expected)
+            mismatches++;
+    }
+
+    cout << "GameState: " << sizeof(GameState) << " bytes, " << (double)balls / ticks << " balls on average" << endl;
+    cout << "Roll back " << ROLLBACK_FRAMES << " ticks and re-simulate, " << ticks << " times:" << endl;
+    cout << "  " << copySeconds / ticks * 1e6 << " us mean, " << copyWorst * 1e6 << " us worst" << endl;
+    cout << mismatches << " ticks differed from the game that never rolled back" << endl;
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Multiplayer client (--connect <host:port>)
+NetAddress serverAddress;
+bool networked = false;
+
+// Network thread: takes the simulation thread's place when playing on a
+// server. Sends the keys held every tick and publishes whatever state the
+// server last sent, keeping the previous positions for interpolation.
+void networkThread()
+{
+    NetClient client;
+    if (!client.Connect(serverAddress, PERFECT_LINK, sessionSeed | 1))
+        return;
+
+    bool held[GAMEKEY_COUNT] = {};
+    bool launchTapped = false; // a space tap shorter than a tick still launches
+    GameState previous;
+    unsigned lastFrame = 0;
+    int player = -1;
+
+    double nextTick = glfwGetTime();
+    while (simRunning.load())
     {
-        if (brk->brick_type == REFLECTIVE)
-        {
-            if ((x > brk->x - brk->width && x <= brk->x + brk->width) && (y > brk->y - brk->width && y <= brk->y + brk->width))
-            {
-                direction = GetRandomDirection();
-                x = x + 0.01;
-                y = y + 0.02;
-                brk->red = 1.0f; // set brick color to red
-                brk->green = 0.0f;
-                brk->blue = 0.0f;
-            }
+        double now = glfwGetTime();
+        if (now < nextTick) {
+            this_thread::sleep_for(chrono::duration<double>(nextTick - now));
+            continue;
+        }
+        nextTick += SIM_TICK;
+        if (now - nextTick > 0.25)
+            nextTick = now;
+
+        KeyEvent e;
+        while (keyEvents.Peek(e)) {
+            GAMEKEY key = e.key == GLFW_KEY_LEFT ? KEY_LEFT : (e.key == GLFW_KEY_RIGHT ? KEY_RIGHT : KEY_LAUNCH);
+            held[key] = e.action == GLFW_PRESS;
+            if (key == KEY_LAUNCH && held[key])
+                launchTapped = true;
+            keyEvents.Pop();
+        }
+        client.SetKeys(held[KEY_LEFT], held[KEY_RIGHT], held[KEY_LAUNCH] || launchTapped);
+        launchTapped = false;
+        client.Update(now);
+
+        if (client.Player() != player) {
+            player = client.Player();
+            if (client.Connected())
+                cout << "Joined match " << client.Match() << " as player " << player + 1 << endl;
+            else
+                cout << "Lost the server, reconnecting" << endl;
         }
-        else if (brk->brick_type == DESTRUCTABLE)
-        {
-            brk->hit_points--;
-            if (brk->hit_points == 0)
-            {
-                brk->onoff = OFF;
+        if (!client.HasState() || client.LatestFrame() == lastFrame)
+            continue;
+        lastFrame = client.LatestFrame();
+
+        GameSnapshot& snapshot = snapshots.WriteSlot();
+        DequantizeState(client.LatestSnapshot(), snapshot.state);
+        GameState& state = snapshot.state;
+        for (int p = 0; p < state.playerCount && p < previous.playerCount; p++)
+            state.paddles[p].prevX = previous.paddles[p].x;
+        if (state.world.size() == previous.world.size()) {
+            for (int i = 0; i < state.world.size(); i++) {
+                state.world[i].prevX = previous.world[i].x;
+                state.world[i].prevY = previous.world[i].y;
             }
         }
+        snapshot.tickTime = now;
+        previous = state;
+        snapshots.Publish();
     }
+}
 
-    // Generate a random direction for the circle
-    int GetRandomDirection()
-    {
-        return (rand() % 8) + 1;
+// Run a headless server until killed, printing traffic every five seconds
+int runServer(unsigned short port)
+{
+    NetStartup();
+    NetServer server;
+    if (!server.Start(port, PERFECT_LINK))
+        return EXIT_FAILURE;
+    cout << "Serving on UDP port " << server.Port() << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double nextTick = 0.0;
+    double nextReport = 5.0;
+    unsigned long long bytesReported = 0;
+    for (;;) {
+        double now = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (now < nextTick) {
+            this_thread::sleep_for(chrono::duration<double>(nextTick - now));
+            continue;
+        }
+        server.Tick(now);
+        nextTick += SIM_TICK;
+        if (now - nextTick > 0.25)
+            nextTick = now;
+
+        if (now >= nextReport) {
+            const NetServerStats& stats = server.Stats();
+            cout << server.ClientCount() << " clients, " << (stats.snapshotBytes - bytesReported) / 5 / 1024
+                 << " KB/s of snapshots" << endl;
+            bytesReported = stats.snapshotBytes;
+            nextReport += 5.0;
+        }
     }
+}
 
-    // Move the circle one step based on its direction
-    void MoveOneStep()
-    {
-        if (direction == 1 || direction == 5 || direction == 6)  // up
-        {
-            if (y > -1 + radius)
-            {
-                y -= speed;
-            }
-            else
-            {
-                direction = GetRandomDirection();
-            }
+// Run a server and clientCount clients in one process over loopback UDP on
+// a simulated clock, through a link with loss, latency and jitter, and check
+// that every client's newest state is exactly what the server sent. The
+// first client goes silent for longer than CLIENT_TIMEOUT partway through
+// and has to notice it was dropped and join again.
+int netTest(int clientCount)
+{
+    const int ticks = 1200;
+    const int silentFrom = 240, silentTo = silentFrom + (int)(CLIENT_TIMEOUT / SIM_TICK) + 60;
+    if (clientCount < 1)
+        clientCount = 1;
+    const LinkSettings link = { 5.0f, 0.05, 0.02 }; // 5% loss, 50-70 ms each way
+
+    if (!NetStartup())
+        return EXIT_FAILURE;
+    NetServer server;
+    if (!server.Start(0, link))
+        return EXIT_FAILURE;
+    NetAddress address = { NET_LOCALHOST, server.Port() };
+
+    vector<NetClient*> clients;
+    for (int c = 0; c < clientCount; c++) {
+        clients.push_back(new NetClient());
+        if (!clients.back()->Connect(address, link, 1000 + c))
+            return EXIT_FAILURE;
+    }
+
+    GameRandom rng;
+    rng.Seed(3);
+    double serverSeconds = 0.0;
+    long long checked = 0, mismatched = 0;
+    for (int t = 0; t < ticks; t++) {
+        double now = t * SIM_TICK;
+        for (int c = 0; c < clientCount; c++) {
+            unsigned action = rng.Next() % 8;
+            clients[c]->SetKeys(action == 1, action == 2, action == 3);
+            if (c > 0 || t < silentFrom || t >= silentTo)
+                clients[c]->Update(now);
         }
 
-        if (direction == 2 || direction == 5 || direction == 7)  // right
-        {
-            if (x < 1 - radius)
-            {
-                x += speed;
-            }
-            else
-            {
-                direction = GetRandomDirection();
-            }
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        server.Tick(now);
+        serverSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        for (int c = 0; c < clientCount; c++) {
+            if (!clients[c]->HasState())
+                continue;
+            const unsigned char* sent = server.SnapshotAt(clients[c]->Match(), clients[c]->LatestFrame());
+            if (!sent)
+                continue; // out of the server's history; nothing to compare with
+            checked++;
+            if (memcmp(sent, clients[c]->LatestSnapshot(), QSTATE_BYTES) != 0)
+                mismatched++;
         }
+    }
 
-        if (direction == 3 || direction == 7 || direction == 8)  // down
-        {
-            if (y < 1 - radius) {
-                y += speed;
-            }
-            else
-            {
-                direction = GetRandomDirection();
-            }
+    const NetServerStats& stats = server.Stats();
+    unsigned long long deltas = stats.deltaSnapshots;
+    double perTick = serverSeconds / ticks;
+    cout << clientCount << " clients, " << ticks << " ticks, link " << link.lossPercent << "% loss, "
+         << link.latency * 1000.0 << "+" << link.jitter * 1000.0 << " ms" << endl;
+    cout << "Server: " << perTick * 1e6 << " us/tick (" << (int)(clientCount * SIM_TICK / perTick)
+         << " clients per core at 60 Hz)" << endl;
+    cout << "Snapshots: " << stats.fullSnapshots << " full averaging "
+         << (stats.fullSnapshots ? stats.fullBytes / stats.fullSnapshots : 0) << " bytes, " << deltas
+         << " deltas averaging " << (deltas ? (stats.snapshotBytes - stats.fullBytes) / deltas : 0)
+         << " bytes (raw state " << QSTATE_BYTES << " bytes)" << endl;
+    cout << "Per client: " << (double)stats.snapshotBytes / ticks / clientCount * 60.0 / 1024.0
+         << " KB/s down" << endl;
+
+    bool rejoined = clients[0]->Stats().disconnects == 1 && clients[0]->Connected() && clients[0]->HasState();
+    cout << "Silent client " << (rejoined ? "was dropped and rejoined" : "did not rejoin") << endl;
+
+    unsigned long long applied = 0, noBaseline = 0;
+    for (int c = 0; c < clientCount; c++) {
+        applied += clients[c]->Stats().snapshots;
+        noBaseline += clients[c]->Stats().noBaseline;
+        delete clients[c];
+    }
+    cout << "Clients applied " << applied << " snapshots, dropped " << noBaseline
+         << " without a baseline; " << checked << " states checked against the server, "
+         << mismatched << " mismatched" << endl;
+    NetShutdown();
+    return mismatched == 0 && checked > 0 && rejoined ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Replay a recorded session headlessly and check every tick's state hash
+int replaySession(const char* path)
+{
+    SessionLog log;
+    if (!log.Load(path))
+        return EXIT_FAILURE;
+
+    ReplayResult result = ReplaySession(log);
+    cout << "Replayed " << result.ticks << " ticks in " << result.seconds * 1000.0 << " ms ("
+         << (result.seconds > 0 ? result.ticks / result.seconds : 0) << " ticks/sec, "
+         << result.allocations << " heap allocations)" << endl;
+    if (!result.matched) {
+        cout << "State hash mismatch at tick " << result.firstMismatch << endl;
+        return EXIT_FAILURE;
+    }
+    cout << "All state hashes match" << endl;
+    return EXIT_SUCCESS;
+}
+
+// Run the ECS arena on one thread and on every hardware thread, and check
+// that both produce the same world
+int benchmarkEcs(int balls)
+{
+    const int ticks = 600;
+    const int threadCounts[] = { 1, 0 };
+    unsigned hashes[2];
+    for (int run = 0; run < 2; run++) {
+        Arena arena(7, balls, threadCounts[run]);
+        if (run == 0) {
+            for (int i = 0; i < arena.Scheduler().SystemCount(); i++)
+                cout << "  phase " << arena.Scheduler().SystemPhase(i) << ": " << arena.Scheduler().SystemName(i) << endl;
+        }
+
+        unsigned long long allocationsBefore = ThreadAllocationCount();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int t = 0; t < ticks; t++) {
+            ArenaInput input = { (t / 40) % 2 == 0, (t / 40) % 2 == 1 };
+            arena.Step(input);
         }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        hashes[run] = arena.Hash();
 
-        if (direction == 4 || direction == 6 || direction == 8)  // left
-        {
-            if (x > -1 + radius) {
-                x -= speed;
+        cout << balls << " balls on " << arena.Scheduler().ThreadCount() << " threads: " << seconds * 1000.0 / ticks
+             << " ms/tick; " << arena.Score() << " bricks destroyed, " << arena.PowerUpsCaught() << " power-ups caught, "
+             << arena.GetWorld().Count<Radius>() << " balls left, " << arena.GetWorld().ArchetypeCount() << " archetypes, "
+             << ThreadAllocationCount() - allocationsBefore << " allocations on the main thread" << endl;
+    }
+    cout << (hashes[0] == hashes[1] ? "Same world on both thread counts" : "Worlds DIFFER between thread counts") << endl;
+    return hashes[0] == hashes[1] ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Update count particles for a few seconds, on one thread and on every
+// hardware thread, against the 16.7 ms of a 60 Hz frame
+int benchmarkParticles(int count)
+{
+    const int frames = 300;
+    const int threadCounts[] = { 1, 0 };
+    for (int run = 0; run < 2; run++) {
+        ParticleSystem particles(count, threadCounts[run]);
+        GameRandom rng;
+        rng.Seed(11);
+        // Long-lived bursts all over the field so the whole ring stays busy
+        while (particles.LiveCount() < particles.Capacity()) {
+            float x = (rng.Next() % 2000) / 1000.0f - 1.0f;
+            float y = (rng.Next() % 2000) / 1000.0f - 1.0f;
+            particles.Emit(x, y, 1.0f, 0.5f, 0.2f, 4096, 0.8f, 60.0f);
+            particles.Update(0.0f);
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++)
+            particles.Update((float)SIM_TICK);
+        double ms = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000.0 / frames;
+
+        cout << particles.Capacity() << " particles on " << particles.ThreadCount() << " threads: " << ms
+             << " ms/update (" << ms * 100.0 / (1000.0 / 60.0) << "% of a 60 Hz frame), "
+             << particles.LiveCount() << " alive" << endl;
+    }
+#ifdef PARTICLES_SSE2
+    cout << "SSE2 update" << endl;
+#else
+    cout << "Scalar update" << endl;
+#endif
+    return EXIT_SUCCESS;
+}
+
+// Spray debris for every brick that was on in the last snapshot drawn and
+// is off in this one. A new game or a different brick count only resyncs.
+void emitDebris(ParticleSystem& particles, const GameState& state, ONOFF* seen, int& seenCount, unsigned& seenTick)
+{
+    bool sameGame = seenCount == state.bricks.size() && state.tick >= seenTick;
+    for (int i = 0; i < state.bricks.size(); i++) {
+        const Brick& brick = state.bricks[i];
+        if (sameGame && seen[i] == ON && brick.onoff == OFF)
+            particles.Emit(brick.x, brick.y, brick.red, brick.green, brick.blue, 3000);
+        seen[i] = brick.onoff;
+    }
+    seenCount = state.bricks.size();
+    seenTick = state.tick;
+}
+
+// Scroll up through a few hundred chunks and back down, about as fast as
+// a frame a millisecond. Going up, one brick per chunk is broken; coming
+// back down, with a directory, each such chunk must come back from disk
+// with that brick still broken.
+int benchmarkStream(const char* directory)
+{
+    const int frames = 4000;
+    const float scroll = 0.05f; // world units per frame
+    const int maxChunks = ChunkAt(frames / 2 * scroll + 2.0f) + 1;
+    ChunkStreamer streamer(11, LEVEL_CHUNK_BUDGET, directory);
+    vector<int> broken(maxChunks, -1);     // brick broken in each chunk
+    vector<bool> checked(maxChunks, false);
+    int kept = 0, lost = 0;
+
+    unsigned long long allocationsBefore = ThreadAllocationCount();
+    double slowest = 0.0, total = 0.0;
+    float camera = 0.0f;
+    for (int f = 0; f < frames; f++) {
+        camera += f < frames / 2 ? scroll : -scroll;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        streamer.Update(camera - 1.0f, camera + 1.0f);
+        double ms = chrono::duration<double>(chrono::steady_clock::now() - start).count() * 1000.0;
+        total += ms;
+        slowest = ms > slowest ? ms : slowest;
+
+        for (int index = ChunkAt(camera - 1.0f); index <= ChunkAt(camera + 1.0f); index++) {
+            LevelChunk* chunk = index >= 0 ? streamer.Find(index) : NULL;
+            if (!chunk || chunk->brickCount == 0)
+                continue;
+            if (f < frames / 2 && broken[index] < 0) {
+                broken[index] = chunk->brickCount - 1;
+                chunk->bricks[broken[index]].onoff = OFF;
+                streamer.MarkDirty(*chunk);
             }
-            else
-            {
-                direction = GetRandomDirection();
+            else if (f >= frames / 2 && directory && broken[index] >= 0 && !checked[index] && chunk->fromDisk) {
+                checked[index] = true;
+                (chunk->bricks[broken[index]].onoff == OFF ? kept : lost)++;
             }
         }
+        this_thread::sleep_for(chrono::milliseconds(1)); // stands in for drawing
     }
 
-    // Draw the circle on the screen
-    void DrawCircle()
-    {
-        glColor3f(red, green, blue);
-        glBegin(GL_POLYGON);
-        for (int i = 0; i < 360; i++) {
-            float degInRad = i * DEG2RAD;
-            glVertex2f((cos(degInRad) * radius) + x, (sin(degInRad) * radius) + y);
+    const StreamStats& stats = streamer.Stats();
+    cout << frames << " frames over " << maxChunks << " chunks, " << streamer.SlotCount() << " slots ("
+         << streamer.MemoryBytes() / 1024 << " KB) resident at most" << endl;
+    cout << "  " << stats.generated << " generated, " << stats.diskLoads << " loaded from disk, " << stats.saves
+         << " saved, " << stats.failedSaves << " failed to save, " << stats.evictions << " evicted, " << stats.deferred
+         << " requests deferred (" << stats.savesDeferred << " of them saves)" << endl;
+    cout << "  Update(): " << total / frames << " ms average, " << slowest << " ms slowest; " << stats.misses
+         << " visible chunk-frames not loaded yet; " << ThreadAllocationCount() - allocationsBefore
+         << " allocations on the game thread" << endl;
+    if (directory)
+        cout << "  " << kept << " chunks came back from disk with their broken brick, " << lost << " without" << endl;
+    return lost == 0 && stats.failedSaves == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Play the streaming level in a window: arrow keys move the paddle
+void runStreamLevel(GLFWwindow* window, const char* directory)
+{
+    StreamLevel level((unsigned)time(NULL), LEVEL_CHUNK_BUDGET, directory);
+    HudText hud;
+    int heightLabel = hud.AddLabel(-0.95f, 0.95f, 0.06f, 1.0f, 1.0f, 1.0f);
+    int scoreLabel = hud.AddLabel(-0.2f, 0.95f, 0.06f, 1.0f, 1.0f, 0.0f);
+    int livesLabel = hud.AddLabel(0.5f, 0.95f, 0.06f, 1.0f, 1.0f, 1.0f);
+    char text[MAX_LABEL_CHARS];
+    double nextTick = glfwGetTime();
+    while (!glfwWindowShouldClose(window) && level.Lives() > 0) {
+        framePacer.WaitBeforeInput(glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0);
+        glfwPollEvents();
+        while (glfwGetTime() >= nextTick) {
+            LevelInput input = { glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS, glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS };
+            level.Step(input);
+            nextTick += SIM_TICK;
         }
-        glEnd();
+
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        level.Draw();
+        snprintf(text, sizeof(text), "HEIGHT %d", (int)level.Height());
+        hud.SetText(heightLabel, text);
+        snprintf(text, sizeof(text), "SCORE %d", level.Score());
+        hud.SetText(scoreLabel, text);
+        snprintf(text, sizeof(text), "LIVES %d", level.Lives());
+        hud.SetText(livesLabel, text);
+        hud.Draw();
+        framePacer.WaitBeforeSwap();
+        glfwSwapBuffers(window);
+        framePacer.FrameDone();
     }
-};
+    framePacer.Report(cout);
+    cout << "Height: " << level.Height() << ", score: " << level.Score() << endl;
+}
 
-class Paddle
+// Play the ECS arena in a window: arrow keys move the paddle
+void runEcsArena(GLFWwindow* window)
 {
-public:
-    float red, green, blue;
-    float x, y, width, height;
+    Arena arena((unsigned)time(NULL), 20);
+    double nextTick = glfwGetTime();
+    while (!glfwWindowShouldClose(window)) {
+        framePacer.WaitBeforeInput(glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0);
+        glfwPollEvents();
+        while (glfwGetTime() >= nextTick) {
+            ArenaInput input = { glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS, glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS };
+            arena.Step(input);
+            nextTick += SIM_TICK;
+        }
 
-    // Constructor for Paddle class
-    Paddle(float xx, float yy, float ww, float hh, float rr, float gg, float bb)
-    {
-        x = xx;
-        y = yy;
-        width = ww;
-        height = hh;
-        red = rr;
-        green = gg;
-        blue = bb;
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        glViewport(0, 0, width, height);
+        glClear(GL_COLOR_BUFFER_BIT);
+        arena.Draw();
+        framePacer.WaitBeforeSwap();
+        glfwSwapBuffers(window);
+        framePacer.FrameDone();
     }
+    framePacer.Report(cout);
+    cout << "Score: " << arena.Score() << endl;
+}
 
-    // Draw the paddle on the screen
-    void drawPaddle()
-    {
-        glColor3f(red, green, blue);
-        glBegin(GL_POLYGON);
+// Convert a .brkr session into a seekable file
+int makeSeekable(const char* inPath, const char* outPath)
+{
+    SessionLog log;
+    if (!log.Load(inPath) || !WriteSeekableReplay(log, outPath))
+        return EXIT_FAILURE;
+    cout << "Wrote " << log.tickCount << " ticks with a keyframe every " << DEFAULT_KEYFRAME_INTERVAL
+         << " ticks to " << outPath << endl;
+    return EXIT_SUCCESS;
+}
 
-        glVertex2f(x - width / 2, y - height / 2);
-        glVertex2f(x + width / 2, y - height / 2);
-        glVertex2f(x + width / 2, y + height / 2);
-        glVertex2f(x - width / 2, y + height / 2);
+// Seek a seekable file to random ticks, checking every state against the
+// recorded hash, and compare with simulating from the first tick
+int benchmarkSeek(const char* path)
+{
+    SeekableReplay replay;
+    if (!replay.Open(path) || replay.TickCount() == 0)
+        return EXIT_FAILURE;
+
+    unsigned long long keyframeBytes = 0;
+    for (unsigned i = 0; i < replay.SegmentCount(); i++)
+        keyframeBytes += replay.Segment(i).keyframeSize;
+    cout << replay.TickCount() << " ticks, " << replay.SegmentCount() << " keyframes averaging "
+         << keyframeBytes / replay.SegmentCount() << " bytes (" << sizeof(GameState) << " raw), file "
+         << replay.FileSize() / 1024 << " KB" << endl;
 
-        glEnd();
+    const int seeks = 1000;
+    static GameState state;
+    FrameArena scratch(TICK_SCRATCH_BYTES);
+    GameRandom rng;
+    rng.Seed(9);
+    double seconds = 0.0, worst = 0.0;
+    long long simulated = 0;
+    int mismatches = 0;
+    for (int i = 0; i < seeks; i++) {
+        unsigned tick = 1 + rng.Next() % replay.TickCount();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int ticks = replay.Seek(tick, state, scratch);
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        seconds += elapsed;
+        worst = max(worst, elapsed);
+        simulated += ticks;
+        unsigned hash;
+        if (ticks < 0 || !replay.HashAfter(tick, hash) || HashGameState(state) != hash)
+            mismatches++;
     }
+    cout << seeks << " random seeks: " << seconds / seeks * 1e6 << " us mean, " << worst * 1e6 << " us worst, "
+         << (double)simulated / seeks << " ticks simulated per seek" << endl;
 
-    // Move the paddle left or right based on input
-    void movePaddle(bool moveLeft, bool moveRight)
-    {
-        if (moveLeft && x - width / 2 > -1) {
-            x -= 0.05f;
+    // Simulating from the first tick instead, for comparison
+    const int linearSeeks = 20;
+    double linearSeconds = 0.0;
+    for (int i = 0; i < linearSeeks; i++) {
+        unsigned tick = 1 + rng.Next() % replay.TickCount();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        int ticks = replay.SimulateFrom(0, tick, state, scratch);
+        linearSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        unsigned hash;
+        if (ticks < 0 || !replay.HashAfter(tick, hash) || HashGameState(state) != hash)
+            mismatches++;
+    }
+    cout << linearSeeks << " seeks simulating from tick 0: " << linearSeconds / linearSeeks * 1e6 << " us mean" << endl;
+    cout << mismatches << " seeks did not match the recorded hash" << endl;
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Removal test balls: ball i carries i in its red channel and lies below
+// the floor when i is a multiple of 3, so a third of them leave in one tick
+Circle removalTestBall(int i, int count)
+{
+    float radius = 0.4f / count;
+    float x = -0.9f + 1.8f * i / count;
+    Circle ball(x, i % 3 == 0 ? -1.5 : 0.9, radius, 3, radius, (float)i, 0.0f, 0.0f);
+    ball.speed = 0.0f;
+    return ball;
+}
+
+// Check the balls left after a mass removal: every survivor exactly once,
+// none of the removed ones, handles of removed balls invalid and of survivors still
+// pointing at them, and under the stable policy the original order.
+// Prints what is wrong and returns the number of problems.
+template <typename Pool>
+int checkRemovalSurvivors(Pool& pool, const vector<PoolHandle>& handles, REMOVALPOLICY policy)
+{
+    int count = (int)handles.size();
+    int problems = 0;
+    int survivors = count - (count + 2) / 3;
+    if (pool.size() != survivors) {
+        cout << "  MISMATCH: " << pool.size() << " balls left, expected " << survivors << endl;
+        problems++;
+    }
+
+    vector<bool> seen(count, false);
+    int previous = -1;
+    for (int i = 0; i < pool.size(); i++) {
+        int id = (int)pool[i].red;
+        if (id < 0 || id >= count || id % 3 == 0 || seen[id]) {
+            cout << "  MISMATCH: index " << i << " holds ball " << id << endl;
+            problems++;
+            continue;
         }
-        if (moveRight && x + width / 2 < 1) {
-            x += 0.05f;
+        seen[id] = true;
+        if (policy == STABLE_REMOVAL && id < previous) {
+            cout << "  MISMATCH: ball " << id << " at index " << i << " comes after ball " << previous << endl;
+            problems++;
         }
+        previous = id;
     }
-};
 
-vector<Circle> world;
-Paddle paddle(0.0f, -0.9f, 0.2f, 0.05f, 0.5f, 0.5f, 0.5f); // Create a paddle
+    for (int id = 0; id < count; id++) {
+        Circle* ball = pool.Get(handles[id]);
+        if (id % 3 == 0 ? ball != nullptr : (!ball || (int)ball->red != id)) {
+            cout << "  MISMATCH: handle of ball " << id << (id % 3 == 0 ? " still valid" : " lost") << endl;
+            problems++;
+        }
+    }
+    return problems;
+}
+
+// Remove a third of the balls in one tick under both removal policies.
+// 10k balls go through RemoveDead directly, since the game's pool holds
+// MAX_BALLS; a full pool then goes through StepGame, which also has to
+// leave ballOrder a permutation of the surviving indices.
+int testRemoval()
+{
+    const int count = 10000;
+    const REMOVALPOLICY policies[] = { STABLE_REMOVAL, UNSTABLE_REMOVAL };
+    const char* names[] = { "stable", "unstable" };
+    typedef EntityPool<Circle, count> LargePool;
+    unique_ptr<LargePool> largePool(new LargePool);
+    unique_ptr<GameState> game(new GameState);
+    LargePool& pool = *largePool;
+    GameState& state = *game;
+    FrameArena scratch(TICK_SCRATCH_BYTES);
+    int failures = 0;
+
+    for (int p = 0; p < 2; p++) {
+        // RemoveDead on 10k balls, picked the way StepGame picks them
+        pool.clear();
+        scratch.Reset();
+        vector<PoolHandle> handles(count);
+        vector<int> dead;
+        for (int i = 0; i < count; i++) {
+            handles[i] = pool.Add(removalTestBall(i, count));
+            if (pool[i].y - pool[i].radius < -1)
+                dead.push_back(i);
+        }
+        pool.RemoveDead(dead.data(), (int)dead.size(), policies[p], scratch);
+        int problems = checkRemovalSurvivors(pool, handles, policies[p]);
+        cout << count << " balls, " << names[p] << " removal of " << dead.size() << ": "
+             << pool.size() << " left" << (problems ? "" : ", ok") << endl;
+        failures += problems;
+
+        // A full world through StepGame
+        ResetGame(state, 1);
+        state.removalPolicy = policies[p];
+        state.lives = MAX_BALLS + 1; // every ball below the floor costs a life
+        handles.resize(MAX_BALLS);
+        for (int i = 0; i < MAX_BALLS; i++)
+            handles[i] = state.world.Add(removalTestBall(i, MAX_BALLS));
+        TickInput input;
+        StepGame(state, input, scratch);
+        problems = checkRemovalSurvivors(state.world, handles, policies[p]);
+
+        vector<bool> listed(MAX_BALLS, false);
+        bool permutation = state.ballOrderCount == state.world.size();
+        for (int i = 0; i < state.ballOrderCount && permutation; i++) {
+            int index = state.ballOrder[i];
+            permutation = index >= 0 && index < state.world.size() && !listed[index];
+            if (permutation)
+                listed[index] = true;
+        }
+        if (!permutation) {
+            cout << "  MISMATCH: ballOrder is not a permutation of the " << state.world.size() << " balls left" << endl;
+            problems++;
+        }
+        cout << MAX_BALLS << " balls through StepGame, " << names[p] << " removal: "
+             << state.world.size() << " left" << (problems ? "" : ", ok") << endl;
+        failures += problems;
+    }
+
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Time CollideBalls at several ball counts and compare with checking every
+// pair. The field keeps the same density at every size: radius and speed
+// shrink as the count grows, so each ball has a similar number of
+// neighbours and moves one radius per tick.
+int benchmarkCollisions()
+{
+    const int sizes[] = { 1000, 10000, 100000 };
+    const int ticks = 60;
+    const int bruteForceLimit = 10000; // all pairs at 100k takes minutes
+
+    for (int s = 0; s < 3; s++) {
+        int count = sizes[s];
+        float radius = sqrtf(0.8f / (3.14159f * count)); // 20% of the field covered
+        GameRandom rng;
+        rng.Seed(count);
+
+        vector<Circle> balls;
+        balls.reserve(count);
+        for (int i = 0; i < count; i++) {
+            float x = (rng.Next() % 20000) / 10000.0f - 1.0f;
+            float y = (rng.Next() % 20000) / 10000.0f - 1.0f;
+            Circle ball(x, y, radius, rng.Next() % 8 + 1, radius, 1.0f, 1.0f, 1.0f);
+            ball.speed = radius;
+            balls.push_back(ball);
+        }
+
+        vector<int> order(count);
+        for (int i = 0; i < count; i++)
+            order[i] = i;
+        FrameArena scratch(TICK_SCRATCH_BYTES);
+
+        // The first call sorts from scratch; the timed ticks start from
+        // last tick's order like the game does
+        CollideBalls(balls.data(), count, order.data(), scratch);
+
+        BroadphaseStats total = { 0, 0, 0 };
+        double seconds = 0.0;
+        for (int t = 0; t < ticks; t++) {
+            for (int i = 0; i < count; i++)
+                balls[i].MoveOneStep(rng);
+            scratch.Reset();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            BroadphaseStats stats = CollideBalls(balls.data(), count, order.data(), scratch);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            total.swaps += stats.swaps;
+            total.candidates += stats.candidates;
+            total.contacts += stats.contacts;
+        }
+
+        cout << count << " balls: " << seconds * 1000.0 / ticks << " ms/tick, "
+             << total.swaps / ticks << " swaps, " << total.candidates / ticks << " x-overlaps, "
+             << total.contacts / ticks << " contacts per tick" << endl;
+
+        if (count > bruteForceLimit) {
+            cout << "  all pairs: skipped (" << (long long)count * (count - 1) / 2 << " pair tests per tick)" << endl;
+            continue;
+        }
+
+        // All pairs on the final positions, for time and a contact count check
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        long long contacts = 0;
+        for (int a = 0; a < count; a++) {
+            for (int b = a + 1; b < count; b++) {
+                float dx = balls[b].x - balls[a].x;
+                float dy = balls[b].y - balls[a].y;
+                float reach = balls[a].radius + balls[b].radius;
+                if (dx * dx + dy * dy < reach * reach)
+                    contacts++;
+            }
+        }
+        double bruteSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-int main(void) {
-    srand(time(NULL)); // Seed for random number generation
+        // Same positions through the broadphase, without moving anything
+        vector<float> minX(count), maxX(count);
+        for (int i = 0; i < count; i++) {
+            minX[i] = balls[i].x - balls[i].radius;
+            maxX[i] = balls[i].x + balls[i].radius;
+        }
+        InsertionSortByKey(order.data(), count, minX.data());
+        long long sweepContacts = 0;
+        SweepOverlaps(order.data(), count, minX.data(), maxX.data(), [&](int a, int b) {
+            float dx = balls[b].x - balls[a].x;
+            float dy = balls[b].y - balls[a].y;
+            float reach = balls[a].radius + balls[b].radius;
+            if (dx * dx + dy * dy < reach * reach)
+                sweepContacts++;
+        });
+        cout << "  all pairs: " << bruteSeconds * 1000.0 << " ms/tick, " << contacts << " contacts"
+             << (contacts == sweepContacts ? " (matches sweep)" : " (MISMATCH)") << endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+// Step envCount games with random actions and report the throughput
+int benchmarkBatchEnv(int envCount)
+{
+    const int steps = 1000;
+    BatchEnv env(envCount, 1);
+    vector<int> actions(envCount);
+    GameRandom rng;
+    rng.Seed(7);
+
+    // One untimed step so every thread has created its scratch arena
+    env.Step(actions.data());
+
+    long long episodes = 0;
+    double reward = 0.0;
+    unsigned long long allocationsBefore = ThreadAllocationCount();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int t = 0; t < steps; t++) {
+        for (int i = 0; i < envCount; i++)
+            actions[i] = rng.Next() % ACTION_COUNT;
+        env.Step(actions.data());
+        for (int i = 0; i < envCount; i++) {
+            episodes += env.Dones()[i];
+            reward += env.Rewards()[i];
+        }
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << envCount << " games x " << steps << " steps on " << env.ThreadCount() << " threads: "
+         << seconds * 1000.0 << " ms, " << (double)envCount * steps / seconds << " game steps/sec" << endl;
+    cout << episodes << " episodes finished, mean reward per step " << reward / ((double)envCount * steps)
+         << ", " << ThreadAllocationCount() - allocationsBefore << " heap allocations on the stepping thread" << endl;
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    const char* recordPath = NULL;
+    PRESENTMODE presentMode = PRESENT_VSYNC;
+    double targetFps = 60.0, backgroundFps = 10.0;
+    bool ecsArena = false;
+    bool streamLevel = false;
+    const char* levelDirectory = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-collisions") == 0)
+            return benchmarkCollisions();
+        if (strcmp(argv[i], "--test-removal") == 0)
+            return testRemoval();
+        if (strcmp(argv[i], "--bench-batch") == 0)
+            return benchmarkBatchEnv(i + 1 < argc ? atoi(argv[i + 1]) : 4096);
+        if (strcmp(argv[i], "--ecs-arena") == 0)
+            ecsArena = true;
+        if (strcmp(argv[i], "--bench-ecs") == 0)
+            return benchmarkEcs(i + 1 < argc ? atoi(argv[i + 1]) : 10000);
+        if (strcmp(argv[i], "--bench-stream") == 0)
+            return benchmarkStream(i + 1 < argc ? argv[i + 1] : NULL);
+        if (strcmp(argv[i], "--stream-level") == 0) {
+            streamLevel = true;
+            levelDirectory = i + 1 < argc && argv[i + 1][0] != '-' ? argv[i + 1] : NULL;
+        }
+        if (strcmp(argv[i], "--bench-particles") == 0)
+            return benchmarkParticles(i + 1 < argc ? atoi(argv[i + 1]) : 1000000);
+        if (strcmp(argv[i], "--bench-rollback") == 0)
+            return benchmarkRollback();
+        if (strcmp(argv[i], "--net-test") == 0)
+            return netTest(i + 1 < argc ? atoi(argv[i + 1]) : 64);
+    }
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--replay") == 0)
+            return replaySession(argv[i + 1]);
+        if (strcmp(argv[i], "--bench-seek") == 0)
+            return benchmarkSeek(argv[i + 1]);
+        if (strcmp(argv[i], "--make-seekable") == 0 && i + 2 < argc)
+            return makeSeekable(argv[i + 1], argv[i + 2]);
+        if (strcmp(argv[i], "--record") == 0)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--present") == 0 && !FramePacer::ParseMode(argv[++i], presentMode)) {
+            cout << "Expected --present vsync|uncapped|limited|low-latency" << endl;
+            return EXIT_FAILURE;
+        }
+        else if (strcmp(argv[i], "--fps") == 0)
+            targetFps = atof(argv[++i]);
+        else if (strcmp(argv[i], "--background-fps") == 0)
+            backgroundFps = atof(argv[++i]);
+        if (strcmp(argv[i], "--server") == 0)
+            return runServer((unsigned short)atoi(argv[i + 1]));
+        if (strcmp(argv[i], "--connect") == 0) {
+            if (!ParseAddress(argv[++i], serverAddress) || !NetStartup()) {
+                cout << "Expected --connect host:port" << endl;
+                return EXIT_FAILURE;
+            }
+            networked = true;
+        }
+    }
+    recording = recordPath != NULL;
+    framePacer.SetMode(presentMode);
+    framePacer.SetRates(targetFps, backgroundFps);
+
+    sessionSeed = (unsigned)time(NULL); // Seed for random number generation
 
     if (!glfwInit()) {
         exit(EXIT_FAILURE);
@@ -259,129 +1053,164 @@ int main(void) {
         exit(EXIT_FAILURE);
     }
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
-
-    // Initialize bricks
-    Brick brick(DESTRUCTABLE, -0.2, 0.0, 0.4, 1.0, 1.0, 0.0);
-    Brick brick2(DESTRUCTABLE, -0.2, 0.3, 0.4, 1.0, 0.0, 0.0);
-    Brick brick3(DESTRUCTABLE, -0.2, 0.6, 0.4, 0.0, 1.0, 1.0);
-    Brick brick4(DESTRUCTABLE, 0.0, 0.0, 0.4, 0.0, 0.5, 0.5);
-    Brick brick5(DESTRUCTABLE, 0.0, 0.3, 0.4, 1.0, 0.5, 0.5);
-    Brick brick6(DESTRUCTABLE, 0.0, 0.6, 0.4, 1.0, 0.0, 1.0);
-    Brick brick7(DESTRUCTABLE, 0.2, 0.0, 0.4, 1.0, 0.5, 0.0);
-    Brick brick8(DESTRUCTABLE, 0.2, 0.3, 0.4, 0, 1, 0);
-    Brick brick9(DESTRUCTABLE, 0.2, 0.6, 0.4, 0, 1, 1);
-    Brick brick10(DESTRUCTABLE, 0.4, 0.0, 0.4, 0, 0.5, 0.5);
-    Brick brick11(DESTRUCTABLE, 0.4, 0.3, 0.4, 1.0, 1.0, 1.0);
-    Brick brick12(DESTRUCTABLE, 0.4, 0.6, 0.4, 1.0, 1.0, 0.0);
-
-    int lives = 3; // Starting lives
-
-    // Game loop
+    glfwSwapInterval(framePacer.SwapInterval());
+    glfwSetKeyCallback(window, keyCallback);
+
+    if (streamLevel) {
+        runStreamLevel(window, levelDirectory);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_SUCCESS);
+    }
+
+    if (ecsArena) {
+        runEcsArena(window);
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_SUCCESS);
+    }
+
+    // Low-latency mode only helps if the input it samples late is used at
+    // once. A simulation thread on its own 60 Hz clock would pick the keys
+    // up at its next tick, so the render thread steps the local game
+    // itself. The networked client keeps its thread, which the server
+    // paces, so the mode falls back to limited there.
+    bool renderThreadSim = framePacer.Mode() == PRESENT_LOW_LATENCY && !networked;
+    if (networked && framePacer.Mode() == PRESENT_LOW_LATENCY) {
+        cout << "Low-latency presentation is not available online; using limited" << endl;
+        framePacer.SetMode(PRESENT_LIMITED);
+    }
+    thread simulation;
+    if (renderThreadSim)
+        localSim.Start(glfwGetTime());
+    else
+        simulation = thread(networked ? networkThread : simulationThread);
+
+    ParticleSystem particles(1 << 18);
+    ONOFF seenBricks[MAX_BRICKS];
+    int seenBrickCount = -1;
+    unsigned seenTick = 0;
+    double lastFrame = glfwGetTime();
+
+    HudText hud;
+    int livesLabel = hud.AddLabel(-0.95f, 0.95f, 0.06f, 1.0f, 1.0f, 1.0f);
+    int bricksLabel = hud.AddLabel(0.35f, 0.95f, 0.06f, 1.0f, 1.0f, 0.0f);
+    char text[MAX_LABEL_CHARS];
+
+    // Render loop: draws the newest snapshot, interpolated to the present
     while (!glfwWindowShouldClose(window)) {
+        framePacer.WaitBeforeInput(glfwGetWindowAttrib(window, GLFW_FOCUSED) != 0);
+        glfwPollEvents();
+
+        // Low-latency mode: step on the keys just polled. A tick due within
+        // half a tick runs now rather than a frame late, so jitter in the
+        // frame deadline does not make frames skip or double up ticks.
+        if (renderThreadSim) {
+            while (localSim.StepIfDue(glfwGetTime(), SIM_TICK * 0.5))
+                ;
+        }
+
         // Setup View
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
         glViewport(0, 0, width, height);
         glClear(GL_COLOR_BUFFER_BIT);
 
-        processInput(window); // Handle keyboard input
-
-        // Move the paddle based on input
-        paddle.movePaddle(glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS, glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS);
-
-        // Draw the paddle
-        paddle.drawPaddle();
-
-        // Movement and collision for circles
-        for (int i = 0; i < world.size(); i++)
-        {
-            world[i].CheckCollision(&brick);
-            world[i].CheckCollision(&brick2);
-            world[i].CheckCollision(&brick3);
-            world[i].CheckCollision(&brick4);
-            world[i].CheckCollision(&brick5);
-            world[i].CheckCollision(&brick6);
-            world[i].CheckCollision(&brick7);
-            world[i].CheckCollision(&brick8);
-            world[i].CheckCollision(&brick9);
-            world[i].CheckCollision(&brick10);
-            world[i].CheckCollision(&brick11);
-            world[i].CheckCollision(&brick12);
-            world[i].MoveOneStep();
-            world[i].DrawCircle();
-
-            // Check collision with paddle
-            if (world[i].y - world[i].radius < paddle.y + paddle.height / 2 &&
-                world[i].y + world[i].radius > paddle.y - paddle.height / 2 &&
-                world[i].x - world[i].radius < paddle.x + paddle.width / 2 &&
-                world[i].x + world[i].radius > paddle.x - paddle.width / 2)
-            {
-                world.erase(world.begin() + i);
-                i--;
-
-                if (world.empty()) {
-                    // Add a new circle when all circles are cleared
-                    double r, g, b;
-                    r = rand() / 10000;
-                    g = rand() / 10000;
-                    b = rand() / 10000;
-                    Circle newCircle(0, 0, 0.2, 2, 0.05, r, g, b); // Create a new circle
-                    world.push_back(newCircle); // Add the new circle to the vector
-                }
-            }
+        snapshots.Consume();
+        const GameSnapshot& frame = snapshots.ReadSlot();
 
-            // Check if circle is out of bounds
-            if (world[i].y - world[i].radius < -1) {
-                world.erase(world.begin() + i);
-                i--;
-
-                lives--; // Decrease lives
-                if (lives <= 0) {
-                    // Game over
-                    cout << "Game Over!" << endl;
-                    break;
-                }
-            }
-        }
+        float alpha = (float)((glfwGetTime() - frame.tickTime) / SIM_TICK);
+        alpha = alpha < 0.0f ? 0.0f : (alpha > 1.0f ? 1.0f : alpha);
+
+        // Draw the paddles
+        for (int p = 0; p < frame.state.playerCount; p++)
+            frame.state.paddles[p].drawPaddle(alpha);
+
+        // Draw the circles
+        for (int i = 0; i < frame.state.world.size(); i++)
+            frame.state.world[i].DrawCircle(alpha);
 
         // Draw bricks
-        brick.drawBrick();
-        brick2.drawBrick();
-        brick3.drawBrick();
-        brick4.drawBrick();
-        brick5.drawBrick();
-        brick6.drawBrick();
-        brick7.drawBrick();
-        brick8.drawBrick();
-        brick9.drawBrick();
-        brick10.drawBrick();
-        brick11.drawBrick();
-        brick12.drawBrick();
+        for (int i = 0; i < frame.state.bricks.size(); i++)
+            frame.state.bricks[i].drawBrick();
+
+        // Debris from bricks destroyed since the last frame
+        double now = glfwGetTime();
+        float dt = (float)(now - lastFrame);
+        lastFrame = now;
+        emitDebris(particles, frame.state, seenBricks, seenBrickCount, seenTick);
+        particles.Update(dt > 0.1f ? 0.1f : dt);
+        particles.Draw();
 
+        // HUD: only labels whose text changed are laid out again
+        int bricksLeft = 0;
+        for (int i = 0; i < frame.state.bricks.size(); i++)
+            bricksLeft += frame.state.bricks[i].brick_type == DESTRUCTABLE && frame.state.bricks[i].onoff == ON;
+        snprintf(text, sizeof(text), "LIVES %d", frame.state.lives);
+        hud.SetText(livesLabel, text);
+        snprintf(text, sizeof(text), "BRICKS %d", bricksLeft);
+        hud.SetText(bricksLabel, text);
+        hud.Draw();
+
+        framePacer.WaitBeforeSwap();
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        framePacer.FrameDone();
+
+        if (frame.state.gameOver && !networked) {
+            // Game over
+            cout << "Game Over!" << endl;
+            glfwSetWindowShouldClose(window, true);
+        }
     }
 
+    simRunning.store(false);
+    if (simulation.joinable())
+        simulation.join();
+    if (renderThreadSim)
+        localSim.Report();
+    framePacer.Report(cout);
+    if (keyEvents.DroppedPresses() > 0)
+        cout << "Input queue full: " << keyEvents.DroppedPresses() << " key presses dropped" << endl;
+    if (networked)
+        NetShutdown();
+
+    if (recording && sessionLog.Save(recordPath))
+        cout << "Recorded " << sessionLog.tickCount << " ticks to " << recordPath << endl;
+
     glfwDestroyWindow(window);
     glfwTerminate();
     exit(EXIT_SUCCESS);
 }
 
-// Handle keyboard input (escape key to exit, spacebar to add a new circle)
-void processInput(GLFWwindow* window)
+// Handle keyboard input (escape key to exit, spacebar to add a new circle,
+// arrow keys to move the paddle). Runs on the main thread from
+// glfwPollEvents; everything except escape is queued for the simulation.
+void keyCallback(GLFWwindow* window, int key, int, int action, int)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if (action == GLFW_REPEAT)
+        return;
+
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && world.empty())
+    if (key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT || key == GLFW_KEY_SPACE) {
+        KeyEvent e = { glfwGetTime(), key, action };
+        keyEvents.Push(e, action == GLFW_RELEASE);
+    }
+}
+
+// Move every queued key event that happened before the end of this tick
+// into the tick's input, timed relative to the start of the tick
+void gatherTickInput(double tickStart, TickInput& input)
+{
+    KeyEvent e;
+    while (keyEvents.Peek(e) && e.time < tickStart + SIM_TICK)
     {
-        // Add a new circle when spacebar is pressed and no circles are present
-        double r, g, b;
-        r = rand() / 10000;
-        g = rand() / 10000;
-        b = rand() / 10000;
-        Circle newCircle(0, 0, 0.2, 2, 0.05, r, g, b); // Create a new circle
-        world.push_back(newCircle); // Add the new circle to the vector
+        float offset = (float)((e.time - tickStart) / SIM_TICK);
+
+        GAMEKEY key = e.key == GLFW_KEY_LEFT ? KEY_LEFT : (e.key == GLFW_KEY_RIGHT ? KEY_RIGHT : KEY_LAUNCH);
+        if (!input.Add(offset, key, e.action == GLFW_PRESS))
+            break; // leave the rest for the next tick
+        keyEvents.Pop();
     }
 }
@@ -0,0 +1,176 @@
+//=============================================================================
+// File Name: batch_env.h
+// Version: 1.0
+//
+// Description: Batched brick game environment for reinforcement learning.
+// BatchEnv holds N independent games and advances all of them with one
+// Step(actions) call, spread over a thread pool. Observations, rewards and
+// done flags are written into contiguous buffers that are allocated once,
+// so a training loop can read them in place.
+//
+// Environment:
+// - Actions: ACTION_NONE, ACTION_LEFT, ACTION_RIGHT (hold the arrow key for
+//   the whole tick) and ACTION_LAUNCH (tap space; spawns a ball when the
+//   field is empty).
+// - Reward: +1 for every brick switched off this tick, -1 for every life
+//   lost.
+// - Observation (OBS_SIZE floats): paddle x, lives, then OBS_BALLS balls as
+//   (present, x, y, dx, dy), then OBS_BRICKS brick on/off flags.
+// - Auto-reset: a game that ends during Step() reports done = 1 with the
+//   reward of its last tick and is immediately reset with a new seed; the
+//   observation returned is the first one of the new game.
+//
+// Data Structures:
+// - Game i is a GameState, which owns only fixed-size pools, so the whole
+//   batch is one contiguous array with no per-game heap memory.
+// - Outputs are structure-of-arrays over the batch: observations is
+//   N x OBS_SIZE row-major, rewards and dones have one entry per game.
+//=============================================================================
+
+#ifndef BATCH_ENV_H
+#define BATCH_ENV_H
+
+#include "brick_game.h"
+#include "thread_pool.h"
+#include <vector>
+
+enum BATCHACTION { ACTION_NONE, ACTION_LEFT, ACTION_RIGHT, ACTION_LAUNCH, ACTION_COUNT };
+
+const int OBS_BALLS = 4;
+const int OBS_BRICKS = 12;
+const int OBS_SIZE = 2 + OBS_BALLS * 5 + OBS_BRICKS;
+
+class BatchEnv
+{
+public:
+    BatchEnv(int envCount, unsigned seed, int threads = 0)
+        : envCount(envCount), pool(threads), states(envCount), seeds(envCount),
+          observations((size_t)envCount * OBS_SIZE), rewards(envCount), dones(envCount)
+    {
+        Reset(seed);
+    }
+
+    // Start every game over. Game i draws its seeds from its own generator,
+    // so a batch is reproducible from seed regardless of thread count.
+    void Reset(unsigned seed)
+    {
+        for (int i = 0; i < envCount; i++)
+        {
+            seeds[i].Seed(seed ^ ((unsigned)i * 0x9E3779B9u));
+            ResetGame(states[i], seeds[i].Next());
+            WriteObservation(states[i], &observations[(size_t)i * OBS_SIZE]);
+            rewards[i] = 0.0f;
+            dones[i] = 0;
+        }
+    }
+
+    // Advance every game by one tick. actions holds one BATCHACTION per game.
+    void Step(const int* actions)
+    {
+        StepRange body = { this, actions };
+        pool.ParallelFor(envCount, GRAIN, body);
+    }
+
+    float* Observations() { return observations.data(); }
+    float* Rewards() { return rewards.data(); }
+    unsigned char* Dones() { return dones.data(); }
+    int EnvCount() const { return envCount; }
+    int ThreadCount() const { return pool.ThreadCount(); }
+    const GameState& State(int env) const { return states[env]; }
+
+private:
+    static const int GRAIN = 64; // games per chunk handed to a thread
+
+    int envCount;
+    ThreadPool pool;
+    std::vector<GameState> states;
+    std::vector<GameRandom> seeds;
+    std::vector<float> observations;
+    std::vector<float> rewards;
+    std::vector<unsigned char> dones;
+
+    struct StepRange {
+        BatchEnv* env;
+        const int* actions;
+
+        void operator()(int begin, int end) const
+        {
+            for (int i = begin; i < end; i++)
+                env->StepOne(i, actions[i]);
+        }
+    };
+
+    void StepOne(int i, int action)
+    {
+        // One arena per thread, reused across steps
+        static thread_local FrameArena scratch(TICK_SCRATCH_BYTES);
+
+        GameState& state = states[i];
+        TickInput input;
+        ActionToInput(state, action, input);
+
+        int bricksBefore = BricksOn(state);
+        int livesBefore = state.lives;
+        StepGame(state, input, scratch);
+
+        rewards[i] = (float)(bricksBefore - BricksOn(state)) - (float)(livesBefore - state.lives);
+        dones[i] = state.gameOver ? 1 : 0;
+        if (state.gameOver)
+            ResetGame(state, seeds[i].Next());
+        WriteObservation(state, &observations[(size_t)i * OBS_SIZE]);
+    }
+
+    // Turn an action into the key events that produce it: arrow keys change
+    // state at the start of the tick, launch is a tap
+    static void ActionToInput(const GameState& state, int action, TickInput& input)
+    {
+        bool left = action == ACTION_LEFT;
+        bool right = action == ACTION_RIGHT;
+        if (state.keyDown[0][KEY_LEFT] != left)
+            input.Add(0.0f, KEY_LEFT, left);
+        if (state.keyDown[0][KEY_RIGHT] != right)
+            input.Add(0.0f, KEY_RIGHT, right);
+        if (action == ACTION_LAUNCH)
+        {
+            input.Add(0.0f, KEY_LAUNCH, true);
+            input.Add(0.0f, KEY_LAUNCH, false);
+        }
+    }
+
+    static int BricksOn(const GameState& state)
+    {
+        int on = 0;
+        for (int b = 0; b < state.bricks.size(); b++)
+            on += state.bricks[b].onoff == ON;
+        return on;
+    }
+
+    static void WriteObservation(const GameState& state, float* obs)
+    {
+        *obs++ = state.paddles[0].x;
+        *obs++ = (float)state.lives;
+        for (int b = 0; b < OBS_BALLS; b++)
+        {
+            if (b < state.world.size())
+            {
+                const Circle& ball = state.world[b];
+                float dx, dy;
+                DirectionVector(ball.direction, dx, dy);
+                *obs++ = 1.0f;
+                *obs++ = ball.x;
+                *obs++ = ball.y;
+                *obs++ = dx;
+                *obs++ = dy;
+            }
+            else
+            {
+                for (int k = 0; k < 5; k++)
+                    *obs++ = 0.0f;
+            }
+        }
+        for (int b = 0; b < OBS_BRICKS; b++)
+            *obs++ = (b < state.bricks.size() && state.bricks[b].onoff == ON) ? 1.0f : 0.0f;
+    }
+};
+
+#endif
@@ -0,0 +1,644 @@
+//=============================================================================
+// File Name: brick_game.h
+// Version: 1.0
+//
+// Description: Game objects and simulation step for the brick game.
+// The Brick, Circle and Paddle classes were moved here from
+// Enhanced_brickgame.cpp so that the simulation can run on its own thread
+// and publish copies of GameState to the render thread.
+//
+// Simulation:
+// - StepGame() advances the game by one fixed tick (SIM_TICK seconds).
+// - Circles and the paddle remember their position from the previous tick
+//   so the renderer can interpolate between the two.
+// - Circles that hit the paddle or fall off the bottom have their index
+//   noted and are removed together by EntityPool::RemoveDead at the end of
+//   the tick.
+// - Balls bounce off each other. Candidate pairs come from a sort-and-sweep
+//   broadphase (broadphase.h) whose x order is kept in GameState, so each
+//   tick only repairs last tick's nearly sorted order.
+//
+// Memory:
+// - Circles and bricks live in fixed-capacity pools (memory_pool.h), so a
+//   GameState never allocates and copying one into a snapshot is a memcpy.
+// - Per-tick scratch lists come from a FrameArena that StepGame resets at
+//   the start of each tick.
+//
+// Define BRICK_HEADLESS to build the simulation without GLFW/OpenGL (the
+// draw methods are left out), e.g. for the batch environment.
+//=============================================================================
+
+#ifndef BRICK_GAME_H
+#define BRICK_GAME_H
+
+#ifndef BRICK_HEADLESS
+#include <GLFW\glfw3.h>
+#endif
+#include <stdlib.h>
+#include <math.h>
+#include "memory_pool.h"
+#include "broadphase.h"
+
+const float DEG2RAD = 3.14159 / 180;
+
+// Length of one simulation tick. The original game advanced once per
+// vsync'd frame, so the tick is kept at 60 Hz to preserve ball speed.
+const double SIM_TICK = 1.0 / 60.0;
+
+// Small xorshift generator owned by the game state. Unlike rand() it is
+// part of GameState, so a seed plus the recorded input reproduces a session
+// exactly, and separate games never share random numbers.
+struct GameRandom {
+    unsigned state;
+
+    void Seed(unsigned seed) { state = seed ? seed : 0x9E3779B9u; }
+
+    unsigned Next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+enum BRICKTYPE { REFLECTIVE, DESTRUCTABLE };
+enum ONOFF { ON, OFF };
+
+class Brick
+{
+public:
+    float red, green, blue;
+    float x, y, width;
+    BRICKTYPE brick_type;
+    ONOFF onoff;
+    int hit_points;
+
+    // Constructor for Brick class
+    Brick(BRICKTYPE bt, float xx, float yy, float ww, float rr, float gg, float bb)
+    {
+        brick_type = bt; x = xx; y = yy; width = ww; red = rr, green = gg, blue = bb;
+        onoff = ON;
+        if (brick_type == DESTRUCTABLE) {
+            hit_points = 5; // initialize hit points for destructible bricks
+        }
+    };
+
+#ifndef BRICK_HEADLESS
+    // Draw the brick on the screen
+    void drawBrick() const
+    {
+        if (onoff == ON)
+        {
+            double halfside = width / 5;
+
+            glColor3d(red, green, blue);
+            glBegin(GL_POLYGON);
+
+            glVertex2d(x + halfside, y + halfside);
+            glVertex2d(x + halfside, y - halfside);
+            glVertex2d(x - halfside, y - halfside);
+            glVertex2d(x - halfside, y + halfside);
+
+            glEnd();
+        }
+    }
+#endif
+};
+
+class Circle
+{
+public:
+    float red, green, blue;
+    float radius;
+    float x;
+    float y;
+    float prevX, prevY; // position at the previous tick, used for interpolation
+    float speed = 0.09;
+    int direction; // 1=up, 2=right, 3=down, 4=left, 5=up right, 6=up left, 7=down right, 8=down left
+
+    // Constructor for Circle class
+    Circle(double xx, double yy, double rr, int dir, float rad, float r, float g, float b)
+    {
+        x = xx;
+        y = yy;
+        prevX = x;
+        prevY = y;
+        radius = rr;
+        red = r;
+        green = g;
+        blue = b;
+        radius = rad;
+        direction = dir;
+    }
+
+    // Check collision of circle with a brick
+    void CheckCollision(Brick* brk, GameRandom& rng)
+    {
+        if (brk->brick_type == REFLECTIVE)
+        {
+            if ((x > brk->x - brk->width && x <= brk->x + brk->width) && (y > brk->y - brk->width && y <= brk->y + brk->width))
+            {
+                direction = GetRandomDirection(rng);
+                x = x + 0.01;
+                y = y + 0.02;
+                brk->red = 1.0f; // set brick color to red
+                brk->green = 0.0f;
+                brk->blue = 0.0f;
+            }
+        }
+        else if (brk->brick_type == DESTRUCTABLE)
+        {
+            brk->hit_points--;
+            if (brk->hit_points == 0)
+            {
+                brk->onoff = OFF;
+            }
+        }
+    }
+
+    // Generate a random direction for the circle
+    int GetRandomDirection(GameRandom& rng)
+    {
+        return (rng.Next() % 8) + 1;
+    }
+
+    // Move the circle one step based on its direction
+    void MoveOneStep(GameRandom& rng)
+    {
+        if (direction == 1 || direction == 5 || direction == 6)  // up
+        {
+            if (y > -1 + radius)
+            {
+                y -= speed;
+            }
+            else
+            {
+                direction = GetRandomDirection(rng);
+            }
+        }
+
+        if (direction == 2 || direction == 5 || direction == 7)  // right
+        {
+            if (x < 1 - radius)
+            {
+                x += speed;
+            }
+            else
+            {
+                direction = GetRandomDirection(rng);
+            }
+        }
+
+        if (direction == 3 || direction == 7 || direction == 8)  // down
+        {
+            if (y < 1 - radius) {
+                y += speed;
+            }
+            else
+            {
+                direction = GetRandomDirection(rng);
+            }
+        }
+
+        if (direction == 4 || direction == 6 || direction == 8)  // left
+        {
+            if (x > -1 + radius) {
+                x -= speed;
+            }
+            else
+            {
+                direction = GetRandomDirection(rng);
+            }
+        }
+    }
+
+#ifndef BRICK_HEADLESS
+    // Draw the circle on the screen, blended between the previous and the
+    // current tick by alpha (0 = previous, 1 = current)
+    void DrawCircle(float alpha = 1.0f) const
+    {
+        float cx = prevX + (x - prevX) * alpha;
+        float cy = prevY + (y - prevY) * alpha;
+
+        glColor3f(red, green, blue);
+        glBegin(GL_POLYGON);
+        for (int i = 0; i < 360; i++) {
+            float degInRad = i * DEG2RAD;
+            glVertex2f((cos(degInRad) * radius) + cx, (sin(degInRad) * radius) + cy);
+        }
+        glEnd();
+    }
+#endif
+};
+
+class Paddle
+{
+public:
+    float red, green, blue;
+    float x, y, width, height;
+    float prevX; // position at the previous tick, used for interpolation
+
+    // Constructor for Paddle class
+    Paddle(float xx, float yy, float ww, float hh, float rr, float gg, float bb)
+    {
+        x = xx;
+        y = yy;
+        width = ww;
+        height = hh;
+        red = rr;
+        green = gg;
+        blue = bb;
+        prevX = x;
+    }
+
+    // The single-player paddle, centered at the bottom
+    Paddle() : Paddle(0.0f, -0.9f, 0.2f, 0.05f, 0.5f, 0.5f, 0.5f) {}
+
+#ifndef BRICK_HEADLESS
+    // Draw the paddle on the screen, blended between ticks by alpha
+    void drawPaddle(float alpha = 1.0f) const
+    {
+        float px = prevX + (x - prevX) * alpha;
+
+        glColor3f(red, green, blue);
+        glBegin(GL_POLYGON);
+
+        glVertex2f(px - width / 2, y - height / 2);
+        glVertex2f(px + width / 2, y - height / 2);
+        glVertex2f(px + width / 2, y + height / 2);
+        glVertex2f(px - width / 2, y + height / 2);
+
+        glEnd();
+    }
+#endif
+
+    // Move the paddle left or right based on input. Each argument is the
+    // fraction of the tick (0..1) that the key was held down.
+    void movePaddle(float moveLeft, float moveRight)
+    {
+        if (moveLeft > 0 && x - width / 2 > -1) {
+            x -= 0.05f * moveLeft;
+        }
+        if (moveRight > 0 && x + width / 2 < 1) {
+            x += 0.05f * moveRight;
+        }
+    }
+};
+
+// Unit step of one of the eight MoveOneStep directions. Note that "up"
+// moves towards -y, as in MoveOneStep.
+inline void DirectionVector(int direction, float& dx, float& dy)
+{
+    dx = 0.0f;
+    dy = 0.0f;
+    if (direction == 1 || direction == 5 || direction == 6) dy = -1.0f;
+    if (direction == 3 || direction == 7 || direction == 8) dy = 1.0f;
+    if (direction == 2 || direction == 5 || direction == 7) dx = 1.0f;
+    if (direction == 4 || direction == 6 || direction == 8) dx = -1.0f;
+}
+
+// Separate every pair of overlapping balls and, if they are moving towards
+// each other, exchange their motion (equal masses). order is a permutation
+// of [0, count) that is kept between calls; the broadphase only has to
+// repair it. The per-call edge arrays come from scratch.
+inline BroadphaseStats CollideBalls(Circle* balls, int count, int* order, FrameArena& scratch)
+{
+    BroadphaseStats stats = { 0, 0, 0 };
+    if (count < 2)
+        return stats;
+
+    float* minX = scratch.Alloc<float>(count);
+    float* maxX = scratch.Alloc<float>(count);
+    for (int i = 0; i < count; i++)
+    {
+        minX[i] = balls[i].x - balls[i].radius;
+        maxX[i] = balls[i].x + balls[i].radius;
+    }
+    stats.swaps = InsertionSortByKey(order, count, minX);
+
+    SweepOverlaps(order, count, minX, maxX, [&](int a, int b)
+    {
+        stats.candidates++;
+        Circle& p = balls[a];
+        Circle& q = balls[b];
+        float nx = q.x - p.x;
+        float ny = q.y - p.y;
+        float reach = p.radius + q.radius;
+        float distSq = nx * nx + ny * ny;
+        if (distSq >= reach * reach)
+            return;
+        stats.contacts++;
+
+        float dist = sqrtf(distSq);
+        if (dist > 0.0f) {
+            nx /= dist;
+            ny /= dist;
+        }
+        else {
+            nx = 1.0f;
+            ny = 0.0f;
+        }
+
+        // Push both balls out of each other by half the overlap
+        float push = (reach - dist) * 0.5f;
+        p.x -= nx * push;
+        p.y -= ny * push;
+        q.x += nx * push;
+        q.y += ny * push;
+
+        // Balls only move in eight fixed directions, so the response swaps
+        // them: exact for head-on hits, the nearest direction otherwise
+        float pdx, pdy, qdx, qdy;
+        DirectionVector(p.direction, pdx, pdy);
+        DirectionVector(q.direction, qdx, qdy);
+        float approach = (qdx * q.speed - pdx * p.speed) * nx + (qdy * q.speed - pdy * p.speed) * ny;
+        if (approach < 0.0f) {
+            int direction = p.direction;
+            p.direction = q.direction;
+            q.direction = direction;
+            float speed = p.speed;
+            p.speed = q.speed;
+            q.speed = speed;
+        }
+    });
+    return stats;
+}
+
+// Keys the simulation understands, independent of GLFW key codes
+enum GAMEKEY { KEY_LEFT, KEY_RIGHT, KEY_LAUNCH, GAMEKEY_COUNT };
+
+// Players sharing one game, each with a paddle (multiplayer server)
+const int MAX_PLAYERS = 8;
+
+const int MAX_TICK_EVENTS = 32;
+
+// A key press or release, timed relative to the tick it falls in
+struct InputEvent {
+    float offset;   // 0 = start of the tick, 1 = end of the tick
+    GAMEKEY key;
+    bool pressed;
+    int player;     // whose paddle the key controls
+};
+
+// Offsets are kept on a 1/65535 grid so that a recorded session, which
+// stores them in 16 bits, replays with bit-identical input
+const float INPUT_OFFSET_STEPS = 65535.0f;
+
+// Key events that happened during one simulation tick, in time order
+struct TickInput {
+    int count = 0;
+    InputEvent events[MAX_TICK_EVENTS];
+
+    bool Add(float offset, GAMEKEY key, bool pressed, int player = 0)
+    {
+        if (count == MAX_TICK_EVENTS)
+            return false;
+        offset = offset < 0.0f ? 0.0f : (offset > 1.0f ? 1.0f : offset);
+        offset = (float)(unsigned)(offset * INPUT_OFFSET_STEPS + 0.5f) / INPUT_OFFSET_STEPS;
+        InputEvent e = { offset, key, pressed, player };
+        events[count++] = e;
+        return true;
+    }
+};
+
+// Pool capacities. Balls only spawn when the field is empty, so MAX_BALLS
+// is headroom for future modes rather than something normal play reaches.
+const int MAX_BALLS = 128;
+const int MAX_BRICKS = 64;
+
+typedef EntityPool<Circle, MAX_BALLS> BallPool;
+typedef EntityPool<Brick, MAX_BRICKS> BrickPool;
+
+// Scratch space StepGame needs per tick; FrameArena grows past it if needed
+const size_t TICK_SCRATCH_BYTES = 4096;
+
+// Everything the simulation owns. The render thread only ever sees copies.
+struct GameState {
+    BallPool world;
+    BrickPool bricks;
+    Paddle paddles[MAX_PLAYERS];
+    int playerCount;
+    int lives;
+    bool gameOver;
+    unsigned tick;
+    bool keyDown[MAX_PLAYERS][GAMEKEY_COUNT]; // keys held at the end of the last tick
+    GameRandom rng;
+    REMOVALPOLICY removalPolicy;
+    int ballOrder[MAX_BALLS]; // world indices sorted by left edge, kept for the broadphase
+    int ballOrderCount;       // world.size() when ballOrder was last valid
+
+    GameState() : playerCount(1), lives(3), gameOver(false), tick(0), keyDown(), removalPolicy(STABLE_REMOVAL), ballOrderCount(0) { rng.Seed(0); }
+};
+
+// The bytes of an enum read as an int. Loading an enum whose bytes are
+// outside its values is undefined, so raw data is checked through this.
+template <typename T>
+inline int RawEnumValue(const T& value)
+{
+    static_assert(sizeof(T) == sizeof(int), "enum is int sized");
+    int raw;
+    memcpy(&raw, &value, sizeof(raw));
+    return raw;
+}
+
+// Whether a GameState restored from raw bytes (a replay keyframe) is safe
+// to step: pool bookkeeping, counts, indices, enums and bools in range.
+// Positions and colors are not checked; any float value is playable.
+inline bool ValidGameState(const GameState& state)
+{
+    int policy = RawEnumValue(state.removalPolicy);
+    if (!state.world.Valid() || !state.bricks.Valid() ||
+        state.playerCount < 1 || state.playerCount > MAX_PLAYERS ||
+        (policy != STABLE_REMOVAL && policy != UNSTABLE_REMOVAL) ||
+        state.ballOrderCount < 0 || state.ballOrderCount > state.world.size())
+        return false;
+    for (int i = 0; i < state.ballOrderCount; i++)
+    {
+        if (state.ballOrder[i] < 0 || state.ballOrder[i] >= state.ballOrderCount)
+            return false;
+    }
+    for (int i = 0; i < state.bricks.size(); i++)
+    {
+        int type = RawEnumValue(state.bricks[i].brick_type);
+        int onoff = RawEnumValue(state.bricks[i].onoff);
+        if ((type != REFLECTIVE && type != DESTRUCTABLE) || (onoff != ON && onoff != OFF))
+            return false;
+    }
+
+    // A bool byte other than 0 or 1 is not a valid bool
+    unsigned char bytes[1 + sizeof(state.keyDown)];
+    memcpy(bytes, &state.gameOver, 1);
+    memcpy(bytes + 1, state.keyDown, sizeof(state.keyDown));
+    for (size_t i = 0; i < sizeof(bytes); i++)
+    {
+        if (bytes[i] > 1)
+            return false;
+    }
+    return true;
+}
+
+// Where player's paddle starts in a game of players paddles: evenly
+// spaced along the bottom, each player in their own color
+inline Paddle StartingPaddle(int player, int players)
+{
+    static const float playerColors[MAX_PLAYERS][3] = {
+        { 0.5f, 0.5f, 0.5f }, { 0.9f, 0.4f, 0.2f }, { 0.2f, 0.6f, 0.9f }, { 0.4f, 0.8f, 0.3f },
+        { 0.9f, 0.8f, 0.2f }, { 0.7f, 0.3f, 0.8f }, { 0.3f, 0.8f, 0.8f }, { 0.9f, 0.5f, 0.7f }
+    };
+
+    float x = -1.0f + (2.0f * player + 1.0f) / players;
+    const float* c = playerColors[player];
+    return Paddle(x, -0.9f, 0.2f, 0.05f, c[0], c[1], c[2]);
+}
+
+// Put the bricks, paddles and lives back to the start of a game. The seed
+// decides every random direction and color for the rest of the game.
+inline void ResetGame(GameState& state, unsigned seed, int players = 1)
+{
+    state = GameState();
+    state.rng.Seed(seed);
+
+    state.playerCount = players < 1 ? 1 : (players > MAX_PLAYERS ? MAX_PLAYERS : players);
+    for (int p = 0; p < state.playerCount; p++)
+        state.paddles[p] = StartingPaddle(p, state.playerCount);
+
+    state.bricks.Add(Brick(DESTRUCTABLE, -0.2, 0.0, 0.4, 1.0, 1.0, 0.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, -0.2, 0.3, 0.4, 1.0, 0.0, 0.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, -0.2, 0.6, 0.4, 0.0, 1.0, 1.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.0, 0.0, 0.4, 0.0, 0.5, 0.5));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.0, 0.3, 0.4, 1.0, 0.5, 0.5));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.0, 0.6, 0.4, 1.0, 0.0, 1.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.2, 0.0, 0.4, 1.0, 0.5, 0.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.2, 0.3, 0.4, 0, 1, 0));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.2, 0.6, 0.4, 0, 1, 1));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.4, 0.0, 0.4, 0, 0.5, 0.5));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.4, 0.3, 0.4, 1.0, 1.0, 1.0));
+    state.bricks.Add(Brick(DESTRUCTABLE, 0.4, 0.6, 0.4, 1.0, 1.0, 0.0));
+}
+
+// Add a new circle with a random color at the center of the screen
+inline void SpawnCircle(GameState& state)
+{
+    double r, g, b;
+    r = state.rng.Next() % 32768 / 10000;
+    g = state.rng.Next() % 32768 / 10000;
+    b = state.rng.Next() % 32768 / 10000;
+    Circle newCircle(0, 0, 0.2, 2, 0.05, r, g, b); // Create a new circle
+    state.world.Add(newCircle); // Add the new circle to the pool
+}
+
+// Advance the game by one tick. scratch is reset and used for this tick's
+// temporary lists.
+inline void StepGame(GameState& state, const TickInput& input, FrameArena& scratch)
+{
+    if (state.gameOver)
+        return;
+
+    scratch.Reset();
+
+    state.tick++;
+
+    // Replay the tick's key events in order, measuring how long the arrow
+    // keys were held so that a tap shorter than a tick still moves the paddle
+    float held[MAX_PLAYERS][GAMEKEY_COUNT] = {};
+    float last = 0.0f;
+    for (int e = 0; e <= input.count; e++)
+    {
+        float offset = e < input.count ? input.events[e].offset : 1.0f;
+        for (int p = 0; p < state.playerCount; p++)
+        {
+            for (int k = 0; k < GAMEKEY_COUNT; k++)
+            {
+                if (state.keyDown[p][k])
+                    held[p][k] += offset - last;
+            }
+        }
+        last = offset;
+
+        if (e < input.count)
+        {
+            const InputEvent& event = input.events[e];
+            if (event.player < 0 || event.player >= state.playerCount || (unsigned)event.key >= GAMEKEY_COUNT)
+                continue;
+            state.keyDown[event.player][event.key] = event.pressed;
+
+            // Add a new circle when spacebar is pressed and no circles are present
+            if (event.key == KEY_LAUNCH && event.pressed && state.world.empty())
+                SpawnCircle(state);
+        }
+    }
+
+    // Move the paddles based on input
+    for (int p = 0; p < state.playerCount; p++)
+    {
+        Paddle& paddle = state.paddles[p];
+        paddle.prevX = paddle.x;
+        paddle.movePaddle(held[p][KEY_LEFT], held[p][KEY_RIGHT]);
+    }
+
+    BallPool& world = state.world;
+
+    // Movement and collision for circles. Balls that leave play are only
+    // noted in deadBalls here; the pool is compacted once after the loop.
+    int* deadBalls = scratch.Alloc<int>(world.size());
+    int deadCount = 0;
+    bool hitPaddle = false;
+    for (int i = 0; i < world.size(); i++)
+    {
+        Circle& ball = world[i];
+        ball.prevX = ball.x;
+        ball.prevY = ball.y;
+
+        for (int b = 0; b < state.bricks.size(); b++)
+            ball.CheckCollision(&state.bricks[b], state.rng);
+        ball.MoveOneStep(state.rng);
+
+        // Check collision with the paddles
+        bool onPaddle = false;
+        for (int p = 0; p < state.playerCount && !onPaddle; p++)
+        {
+            const Paddle& paddle = state.paddles[p];
+            onPaddle = ball.y - ball.radius < paddle.y + paddle.height / 2 &&
+                       ball.y + ball.radius > paddle.y - paddle.height / 2 &&
+                       ball.x - ball.radius < paddle.x + paddle.width / 2 &&
+                       ball.x + ball.radius > paddle.x - paddle.width / 2;
+        }
+        if (onPaddle)
+        {
+            deadBalls[deadCount++] = i;
+            hitPaddle = true;
+            continue;
+        }
+
+        // Check if circle is out of bounds
+        if (ball.y - ball.radius < -1) {
+            deadBalls[deadCount++] = i;
+
+            state.lives--; // Decrease lives
+            if (state.lives <= 0) {
+                // Game over
+                state.gameOver = true;
+                break;
+            }
+        }
+    }
+
+    world.RemoveDead(deadBalls, deadCount, state.removalPolicy, scratch);
+
+    // Ball against ball. Adding or removing balls shifts their indices, so
+    // the saved order restarts from scratch when the count changed.
+    if (state.ballOrderCount != world.size()) {
+        for (int i = 0; i < world.size(); i++)
+            state.ballOrder[i] = i;
+        state.ballOrderCount = world.size();
+    }
+    CollideBalls(&world[0], world.size(), state.ballOrder, scratch);
+
+    if (hitPaddle && world.empty()) {
+        // Add a new circle when all circles are cleared
+        SpawnCircle(state);
+    }
+}
+
+#endif
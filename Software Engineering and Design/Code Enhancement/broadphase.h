@@ -0,0 +1,65 @@
+//=============================================================================
+// File Name: broadphase.h
+// Version: 1.0
+//
+// Description: Sort-and-sweep broadphase along the x axis. Objects are
+// kept in an order array sorted by the left edge of their bounds; a sweep
+// over that array reports every pair whose x intervals overlap, and the
+// caller runs the exact test on those pairs only.
+//
+// Algorithmic Logic:
+// - The order array is kept from one tick to the next. Objects only move a
+//   little per tick, so last tick's order is nearly sorted and insertion
+//   sort fixes it in O(n + k), where k is the number of objects that
+//   swapped places, instead of O(n log n) for a fresh sort.
+// - The sweep walks forward from each object until the next left edge
+//   starts past its right edge: O(n + p) for p overlapping x intervals.
+//=============================================================================
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+// Work done by one broadphase update, for benchmarks
+struct BroadphaseStats {
+    long long swaps;       // insertion sort moves
+    long long candidates;  // pairs whose x intervals overlap
+    long long contacts;    // candidates that passed the exact test
+};
+
+// Reorder order (a permutation of object indices) so key[order[i]] is
+// ascending. Returns the number of moves, which is the number of
+// inversions left over from the previous order.
+inline long long InsertionSortByKey(int* order, int count, const float* key)
+{
+    long long moves = 0;
+    for (int i = 1; i < count; i++)
+    {
+        int item = order[i];
+        float k = key[item];
+        int j = i;
+        while (j > 0 && key[order[j - 1]] > k)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = item;
+        moves += i - j;
+    }
+    return moves;
+}
+
+// Call onPair(a, b) for every pair of objects whose [minX, maxX]
+// intervals overlap. order must be sorted by minX.
+template <typename PairFunc>
+inline void SweepOverlaps(const int* order, int count, const float* minX, const float* maxX, PairFunc onPair)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int a = order[i];
+        float right = maxX[a];
+        for (int j = i + 1; j < count && minX[order[j]] <= right; j++)
+            onPair(a, order[j]);
+    }
+}
+
+#endif
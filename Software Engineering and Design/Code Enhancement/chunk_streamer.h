@@ -0,0 +1,496 @@
+//=============================================================================
+// File Name: chunk_streamer.h
+// Version: 1.0
+//
+// Description: Streams an endless vertical level in chunks. A chunk is a
+// band CHUNK_HEIGHT tall holding up to CHUNK_BRICKS bricks. It is generated
+// from the level seed and its index, or read back from disk if it was
+// changed and evicted earlier. Update() is called once per frame with the
+// visible range. It queues every missing chunk in and near that range for
+// a background thread and picks up the chunks that thread has finished.
+// It never waits: a chunk that is not ready yet is simply absent for that
+// frame.
+//
+// Data Structures:
+// - A fixed array of chunk slots sized from the memory budget, allocated
+//   once. When no slot is free, the least recently used chunk outside the
+//   wanted range is evicted. Memory stays flat however long the level is.
+// - An open-addressing table (linear probing, backward-shift deletion)
+//   from chunk index to slot, also allocated once.
+// - Two single-producer / single-consumer rings: requests to the loader
+//   thread and finished jobs back. A slot that is LOADING or SAVING belongs
+//   to the loader thread until its job comes back.
+//
+// Persistence: with a directory, an evicted chunk whose bricks changed is
+// written to <directory>/chunk_<seed>_<index>.brkc before its slot is
+// reused, and loading reads that file instead of generating the chunk.
+// Without a directory, changes are dropped and the chunk regenerates fresh.
+// A file that cannot be written is reported and counted in failedSaves;
+// the slot is reused anyway so a bad disk cannot pin the whole budget.
+//
+// Time Complexity: Update is O(chunks in range) plus O(slots) per eviction.
+//=============================================================================
+
+#ifndef CHUNK_STREAMER_H
+#define CHUNK_STREAMER_H
+
+#include "brick_game.h"
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int CHUNK_COLUMNS = 8;
+const int CHUNK_ROWS = 4;
+const int CHUNK_BRICKS = CHUNK_COLUMNS * CHUNK_ROWS;
+const float CHUNK_HEIGHT = 0.5f;      // world units; the view is 2 units tall
+const unsigned CHUNK_VERSION = 1;
+const int MIN_CHUNK_SLOTS = 12;       // enough for a view plus prefetch
+
+struct ChunkBrick {
+    float x, y, halfSize;
+    float red, green, blue;
+    BRICKTYPE type;
+    ONOFF onoff;
+    int hitPoints;
+};
+
+enum CHUNKSTATE { CHUNK_FREE, CHUNK_LOADING, CHUNK_READY, CHUNK_SAVING };
+
+struct LevelChunk {
+    int index;            // chunk number counting up from the bottom of the level
+    CHUNKSTATE state;
+    bool dirty;           // bricks changed since the chunk was loaded
+    bool fromDisk;        // set by the loader
+    unsigned lastUsed;    // Update() count when last in the wanted range
+    int brickCount;
+    ChunkBrick bricks[CHUNK_BRICKS];
+};
+
+struct StreamStats {
+    unsigned long long generated;   // chunks built from the seed
+    unsigned long long diskLoads;   // chunks read back from disk
+    unsigned long long saves;       // dirty chunks written on eviction
+    unsigned long long failedSaves; // dirty chunks whose file could not be written; their changes are lost
+    unsigned long long savesDeferred; // dirty victims kept resident because the request ring was full
+    unsigned long long evictions;   // slots freed for another chunk, counted once the save is done
+    unsigned long long deferred;    // requests put off for lack of a slot or queue space
+    unsigned long long misses;      // visible chunks not ready, summed over frames
+};
+
+// Fixed ring for one producer and one consumer, as KeyEventQueue
+template <typename T, unsigned SIZE>
+class SpscRing
+{
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    bool Push(const T& item)
+    {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == SIZE)
+            return false;
+        items[t & (SIZE - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Peek(T& item) const
+    {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = items[h & (SIZE - 1)];
+        return true;
+    }
+
+    void Pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    T items[SIZE];
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+};
+
+// Chunk containing world height y (negative below the level)
+inline int ChunkAt(float y)
+{
+    return (int)floorf(y / CHUNK_HEIGHT);
+}
+
+// Build chunk.index from the level seed. Bricks get denser and tougher
+// higher up, and the color drifts from chunk to chunk.
+inline void GenerateChunk(unsigned seed, LevelChunk& chunk)
+{
+    GameRandom rng;
+    rng.Seed(seed ^ ((unsigned)chunk.index * 0x9E3779B1u) ^ 0x51ED270Bu);
+    rng.Next();
+
+    int density = 30 + (chunk.index / 4 < 40 ? chunk.index / 4 : 40); // percent of cells
+    int toughness = 1 + (chunk.index / 50 < 4 ? chunk.index / 50 : 4);
+    float hue = chunk.index * 0.13f;
+    float cellWidth = 2.0f / CHUNK_COLUMNS;
+    float cellHeight = CHUNK_HEIGHT / CHUNK_ROWS;
+
+    chunk.brickCount = 0;
+    for (int row = 0; row < CHUNK_ROWS; row++)
+    {
+        for (int column = 0; column < CHUNK_COLUMNS; column++)
+        {
+            if ((int)(rng.Next() % 100) >= density)
+                continue;
+            ChunkBrick& brick = chunk.bricks[chunk.brickCount++];
+            brick.x = -1.0f + (column + 0.5f) * cellWidth;
+            brick.y = chunk.index * CHUNK_HEIGHT + (row + 0.5f) * cellHeight;
+            brick.halfSize = cellHeight * 0.4f;
+            brick.type = rng.Next() % 8 == 0 ? REFLECTIVE : DESTRUCTABLE;
+            brick.onoff = ON;
+            brick.hitPoints = 1 + rng.Next() % toughness;
+            float shade = brick.type == REFLECTIVE ? 0.5f : 1.0f;
+            brick.red = shade * (0.5f + 0.5f * sinf(hue));
+            brick.green = shade * (0.5f + 0.5f * sinf(hue + 2.1f));
+            brick.blue = shade * (0.5f + 0.5f * sinf(hue + 4.2f));
+        }
+    }
+}
+
+class ChunkStreamer
+{
+public:
+    // budgetBytes bounds the chunk slots (at least MIN_CHUNK_SLOTS);
+    // directory may be NULL to keep nothing on disk
+    ChunkStreamer(unsigned seed, size_t budgetBytes, const char* directory = NULL)
+        : seed(seed), frame(0), stop(false)
+    {
+        int slotCount = (int)(budgetBytes / sizeof(LevelChunk));
+        if (slotCount < MIN_CHUNK_SLOTS)
+            slotCount = MIN_CHUNK_SLOTS;
+        slots.resize(slotCount);
+        freeSlots.reserve(slotCount);
+        for (int i = slotCount - 1; i >= 0; i--)
+        {
+            slots[i].state = CHUNK_FREE;
+            freeSlots.push_back(i);
+        }
+        tableMask = 1;
+        while (tableMask < 2 * (unsigned)slotCount)
+            tableMask *= 2;
+        table.assign(tableMask, TableEntry());
+        tableMask--;
+
+        memset(&stats, 0, sizeof(stats));
+        if (directory)
+            this->directory = directory;
+        loader = std::thread(&ChunkStreamer::LoaderLoop, this);
+    }
+
+    // Stops the loader and writes the dirty chunks still resident
+    ~ChunkStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_one();
+        loader.join();
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            // A SAVING chunk may still be queued; writing it twice is harmless
+            if ((slots[i].state == CHUNK_READY && slots[i].dirty && !directory.empty()) || slots[i].state == CHUNK_SAVING)
+                SaveChunk(slots[i]);
+        }
+    }
+
+    // Once per frame: collect finished loads and request every chunk
+    // overlapping [viewBottom - prefetch, viewTop + prefetch]
+    void Update(float viewBottom, float viewTop, float prefetch = CHUNK_HEIGHT)
+    {
+        frame++;
+        Job done;
+        while (completed.Peek(done))
+        {
+            completed.Pop();
+            LevelChunk& chunk = slots[done.slot];
+            if (done.kind == JOB_LOAD)
+            {
+                chunk.state = CHUNK_READY;
+                chunk.dirty = false;
+                if (chunk.fromDisk)
+                    stats.diskLoads++;
+                else
+                    stats.generated++;
+            }
+            else
+            {
+                TableRemove(chunk.index);
+                chunk.state = CHUNK_FREE;
+                freeSlots.push_back(done.slot);
+                stats.evictions++;
+                if (done.ok)
+                    stats.saves++;
+                else
+                    stats.failedSaves++;
+            }
+        }
+
+        int first = ChunkAt(viewBottom - prefetch);
+        int last = ChunkAt(viewTop + prefetch);
+        first = first < 0 ? 0 : first;
+        bool queued = false;
+        for (int index = first; index <= last; index++)
+        {
+            int s = TableFind(index);
+            if (s >= 0)
+            {
+                slots[s].lastUsed = frame;
+                continue; // ready, loading, or waiting for its save to finish
+            }
+
+            s = AcquireSlot(first, last);
+            if (s < 0)
+            {
+                stats.deferred++;
+                continue;
+            }
+            LevelChunk& chunk = slots[s];
+            chunk.index = index;
+            chunk.state = CHUNK_LOADING;
+            chunk.lastUsed = frame;
+            Job job = { JOB_LOAD, s, false };
+            if (!requests.Push(job))
+            {
+                chunk.state = CHUNK_FREE;
+                freeSlots.push_back(s);
+                stats.deferred++;
+                continue;
+            }
+            TableInsert(index, s);
+            queued = true;
+        }
+        if (queued)
+            WakeLoader();
+
+        for (int index = ChunkAt(viewBottom) < 0 ? 0 : ChunkAt(viewBottom); index <= ChunkAt(viewTop); index++)
+        {
+            if (!Find(index))
+                stats.misses++;
+        }
+    }
+
+    // The chunk if it is resident and ready, else NULL
+    LevelChunk* Find(int index)
+    {
+        int s = TableFind(index);
+        return s >= 0 && slots[s].state == CHUNK_READY ? &slots[s] : NULL;
+    }
+
+    // Record that chunk's bricks changed so eviction keeps them
+    void MarkDirty(LevelChunk& chunk) { chunk.dirty = true; }
+
+    int SlotCount() const { return (int)slots.size(); }
+    int ResidentCount() const { return (int)(slots.size() - freeSlots.size()); }
+    size_t MemoryBytes() const { return slots.size() * sizeof(LevelChunk) + table.size() * sizeof(TableEntry); }
+    const StreamStats& Stats() const { return stats; }
+
+private:
+    enum JOBKIND { JOB_LOAD, JOB_SAVE };
+    struct Job {
+        JOBKIND kind;
+        int slot;
+        bool ok; // set by the loader: the save was written
+    };
+    struct TableEntry {
+        int index = 0;
+        int slot = -1; // -1 = empty
+    };
+
+    unsigned seed;
+    std::string directory;
+    unsigned frame;
+    std::vector<LevelChunk> slots;
+    std::vector<int> freeSlots;
+    std::vector<TableEntry> table;
+    unsigned tableMask;
+    StreamStats stats;
+
+    SpscRing<Job, 64> requests;
+    SpscRing<Job, 64> completed;
+    std::thread loader;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> stop;
+
+    unsigned TableHome(int index) const { return ((unsigned)index * 2654435761u) & tableMask; }
+
+    int TableFind(int index) const
+    {
+        for (unsigned i = TableHome(index); table[i].slot >= 0; i = (i + 1) & tableMask)
+        {
+            if (table[i].index == index)
+                return table[i].slot;
+        }
+        return -1;
+    }
+
+    void TableInsert(int index, int slot)
+    {
+        unsigned i = TableHome(index);
+        while (table[i].slot >= 0)
+            i = (i + 1) & tableMask;
+        table[i].index = index;
+        table[i].slot = slot;
+    }
+
+    // Remove index and shift later entries of its probe run back into the gap
+    void TableRemove(int index)
+    {
+        unsigned gap = TableHome(index);
+        while (table[gap].index != index || table[gap].slot < 0)
+            gap = (gap + 1) & tableMask;
+        table[gap].slot = -1;
+        for (unsigned i = (gap + 1) & tableMask; table[i].slot >= 0; i = (i + 1) & tableMask)
+        {
+            unsigned home = TableHome(table[i].index);
+            // Move it if its home is not in (gap, i] going around the table
+            if (((i - home) & tableMask) >= ((i - gap) & tableMask))
+            {
+                table[gap] = table[i];
+                table[i].slot = -1;
+                gap = i;
+            }
+        }
+    }
+
+    // A free slot, or the least recently used ready chunk outside
+    // [first, last]. Dirty victims go to the loader to be saved first and
+    // the search goes on. Returns -1 if nothing can be freed right now.
+    int AcquireSlot(int first, int last)
+    {
+        while (freeSlots.empty())
+        {
+            int victim = -1;
+            for (int i = 0; i < (int)slots.size(); i++)
+            {
+                const LevelChunk& chunk = slots[i];
+                if (chunk.state != CHUNK_READY || (chunk.index >= first && chunk.index <= last))
+                    continue;
+                if (victim < 0 || chunk.lastUsed < slots[victim].lastUsed)
+                    victim = i;
+            }
+            if (victim < 0)
+                return -1;
+
+            if (slots[victim].dirty && !directory.empty())
+            {
+                // Counted as an eviction when the save comes back. If the
+                // ring is full the chunk stays resident and dirty, and the
+                // next eviction tries again.
+                Job job = { JOB_SAVE, victim, false };
+                if (!requests.Push(job))
+                {
+                    stats.savesDeferred++;
+                    return -1;
+                }
+                slots[victim].state = CHUNK_SAVING; // stays in the table until saved
+                WakeLoader();
+                continue;
+            }
+            TableRemove(slots[victim].index);
+            slots[victim].state = CHUNK_FREE;
+            stats.evictions++;
+            return victim;
+        }
+        int s = freeSlots.back();
+        freeSlots.pop_back();
+        return s;
+    }
+
+    void WakeLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex); // pairs with the loader's check
+        }
+        wake.notify_one();
+    }
+
+    void ChunkPath(int index, char* path, size_t size) const
+    {
+        snprintf(path, size, "%s/chunk_%u_%d.brkc", directory.c_str(), seed, index);
+    }
+
+    bool LoadChunk(LevelChunk& chunk) const
+    {
+        if (directory.empty())
+            return false;
+        char path[1024];
+        ChunkPath(chunk.index, path, sizeof(path));
+        std::ifstream file(path, std::ios::binary);
+        char magic[4];
+        unsigned header[2];
+        if (!file.read(magic, 4) || memcmp(magic, "BRKC", 4) != 0 ||
+            !file.read((char*)header, sizeof(header)) || header[0] != CHUNK_VERSION || header[1] > (unsigned)CHUNK_BRICKS)
+            return false;
+        chunk.brickCount = (int)header[1];
+        return (bool)file.read((char*)chunk.bricks, chunk.brickCount * sizeof(ChunkBrick));
+    }
+
+    bool SaveChunk(const LevelChunk& chunk) const
+    {
+        char path[1024];
+        ChunkPath(chunk.index, path, sizeof(path));
+        std::ofstream file(path, std::ios::binary);
+        unsigned header[2] = { CHUNK_VERSION, (unsigned)chunk.brickCount };
+        file.write("BRKC", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)chunk.bricks, chunk.brickCount * sizeof(ChunkBrick));
+        return (bool)file;
+    }
+
+    void LoaderLoop()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || requests.Peek(job); });
+                if (stop)
+                    return;
+            }
+            requests.Pop();
+
+            LevelChunk& chunk = slots[job.slot];
+            if (job.kind == JOB_LOAD)
+            {
+                chunk.fromDisk = LoadChunk(chunk);
+                if (!chunk.fromDisk)
+                    GenerateChunk(seed, chunk);
+            }
+            else
+            {
+                job.ok = SaveChunk(chunk);
+                if (!job.ok)
+                    std::cout << "ERROR::LEVEL::CANNOT_SAVE_CHUNK " << chunk.index << std::endl;
+            }
+
+            // Only waits if the game has not collected a ring's worth of jobs
+            while (!completed.Push(job) && !stop)
+                std::this_thread::yield();
+        }
+    }
+
+    ChunkStreamer(const ChunkStreamer&);
+    ChunkStreamer& operator=(const ChunkStreamer&);
+};
+
+#endif
@@ -0,0 +1,580 @@
+//=============================================================================
+// File Name: ecs.h
+// Version: 1.0
+//
+// Description: Archetype-based entity component system. An entity is an
+// id; its data is a set of plain components (position, velocity, color,
+// ...). Behavior lives in systems that iterate every entity having the
+// components they need, as tight arrays, and a scheduler runs systems that
+// touch disjoint components in parallel.
+//
+// Data Structures:
+// - Archetype: all entities with exactly the same component set. Its
+//   entities are stored in fixed-size chunks (ECS_CHUNK_BYTES); inside a
+//   chunk every component has its own array, so a system reading Position
+//   and Velocity walks two dense arrays.
+// - Chunks are kept packed: all full except the last. Removing an entity
+//   moves the archetype's last entity into the hole.
+// - World keeps a record per entity index (archetype, chunk, row,
+//   generation). Adding or removing a component moves the entity to the
+//   neighbouring archetype; transitions are cached on the archetype.
+// - CommandBuffer records creations, additions and destructions made
+//   while systems run. They are applied after the systems' phase, in a
+//   fixed order, so the world never changes shape under an iteration.
+//
+// Scheduling:
+// - Each system declares the components it reads and writes. Two systems
+//   conflict if one writes what the other reads or writes.
+// - SystemScheduler puts each system in the first phase after every
+//   earlier system it conflicts with. Systems in one phase never conflict
+//   and run in parallel on the thread pool; conflicting systems keep their
+//   registration order, so results do not depend on the thread count.
+//
+// Components must be trivially copyable; they are moved with memcpy.
+//=============================================================================
+
+#ifndef ECS_H
+#define ECS_H
+
+#include "thread_pool.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+const int ECS_MAX_COMPONENTS = 32;
+const size_t ECS_CHUNK_BYTES = 16 * 1024;
+
+typedef unsigned ComponentMask;
+
+struct Entity {
+    unsigned index;
+    unsigned generation;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+};
+
+const Entity NULL_ENTITY = { 0xFFFFFFFF, 0 };
+
+struct ComponentInfo {
+    size_t size;
+    size_t align;
+};
+
+inline ComponentInfo* ComponentRegistry()
+{
+    static ComponentInfo infos[ECS_MAX_COMPONENTS];
+    return infos;
+}
+
+// Masks are one bit per component in an unsigned, so a 33rd component
+// type cannot be represented; that is a program error, not a runtime one
+inline int RegisterComponent(size_t size, size_t align)
+{
+    static_assert(ECS_MAX_COMPONENTS <= sizeof(ComponentMask) * 8, "one mask bit per component");
+    static std::atomic<int> count(0);
+    int id = count++;
+    if (id >= ECS_MAX_COMPONENTS)
+    {
+        std::cout << "ERROR::ECS::TOO_MANY_COMPONENT_TYPES (" << ECS_MAX_COMPONENTS << " max)" << std::endl;
+        std::abort();
+    }
+    ComponentInfo info = { size, align };
+    ComponentRegistry()[id] = info;
+    return id;
+}
+
+// Small integer id of a component type, assigned on first use
+template <typename T>
+int ComponentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "components are moved between chunks with memcpy");
+    static_assert(alignof(T) <= alignof(std::max_align_t), "chunks are only max_align_t aligned");
+    static const int id = RegisterComponent(sizeof(T), alignof(T));
+    return id;
+}
+
+template <typename... Ts>
+ComponentMask MaskOf()
+{
+    ComponentMask mask = 0;
+    int expand[] = { 0, (mask |= 1u << ComponentId<Ts>(), 0)... };
+    (void)expand;
+    return mask;
+}
+
+class World;
+
+// Structural changes recorded while systems run, applied by Apply().
+// Entities created here are referred to by the index Create() returns.
+class CommandBuffer
+{
+public:
+    int Create()
+    {
+        Command command = { CREATE, NULL_ENTITY, createdCount, -1, 0 };
+        commands.push_back(command);
+        return createdCount++;
+    }
+
+    template <typename T>
+    void Add(int created, const T& value)
+    {
+        Command command = { ADD, NULL_ENTITY, created, ComponentId<T>(), bytes.size() };
+        bytes.insert(bytes.end(), (const unsigned char*)&value, (const unsigned char*)&value + sizeof(T));
+        commands.push_back(command);
+    }
+
+    // Add or overwrite a component of an existing entity
+    template <typename T>
+    void Set(Entity entity, const T& value)
+    {
+        Command command = { SET, entity, -1, ComponentId<T>(), bytes.size() };
+        bytes.insert(bytes.end(), (const unsigned char*)&value, (const unsigned char*)&value + sizeof(T));
+        commands.push_back(command);
+    }
+
+    void Destroy(Entity entity)
+    {
+        Command command = { DESTROY, entity, -1, -1, 0 };
+        commands.push_back(command);
+    }
+
+    bool Empty() const { return commands.empty(); }
+
+    // Apply in recording order, then clear (keeping the memory)
+    inline void Apply(World& world);
+
+private:
+    enum COMMANDTYPE { CREATE, ADD, SET, DESTROY };
+    struct Command {
+        COMMANDTYPE type;
+        Entity entity;   // SET, DESTROY
+        int created;     // CREATE, ADD
+        int component;   // ADD, SET
+        size_t offset;   // ADD, SET: value in bytes
+    };
+
+    std::vector<Command> commands;
+    std::vector<unsigned char> bytes;
+    std::vector<Entity> created;
+    int createdCount = 0;
+};
+
+class World
+{
+public:
+    World() { emptyArchetype = FindArchetype(0); }
+
+    ~World()
+    {
+        for (size_t a = 0; a < archetypes.size(); a++)
+        {
+            for (size_t c = 0; c < archetypes[a]->chunks.size(); c++)
+                delete[] archetypes[a]->chunks[c].data;
+            delete archetypes[a];
+        }
+    }
+
+    // New entity with the components in mask, left uninitialized for the
+    // caller to set (no archetype moves on the way)
+    Entity Create(ComponentMask mask = 0)
+    {
+        unsigned index;
+        if (!freeIndices.empty())
+        {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+        else
+        {
+            index = (unsigned)records.size();
+            Record record = { nullptr, 0, 0, 1 };
+            records.push_back(record);
+        }
+        Entity entity = { index, records[index].generation };
+        Insert(entity, mask == 0 ? emptyArchetype : FindArchetype(mask));
+        return entity;
+    }
+
+    void Destroy(Entity entity)
+    {
+        if (!Alive(entity))
+            return;
+        Record& record = records[entity.index];
+        RemoveRow(record.archetype, record.chunk, record.row);
+        record.archetype = nullptr;
+        if (++record.generation == 0)
+            record.generation = 1;
+        freeIndices.push_back(entity.index);
+    }
+
+    bool Alive(const Entity& entity) const
+    {
+        return entity.index < records.size() && records[entity.index].generation == entity.generation &&
+               records[entity.index].archetype != nullptr;
+    }
+
+    template <typename T>
+    void Add(Entity entity, const T& value)
+    {
+        AddRaw(entity, ComponentId<T>(), &value);
+    }
+
+    // Add (or overwrite) component id from raw bytes
+    void AddRaw(Entity entity, int component, const void* value)
+    {
+        if (!Alive(entity) || component < 0)
+            return;
+        Record& record = records[entity.index];
+        ComponentMask bit = 1u << component;
+        if ((record.archetype->mask & bit) == 0)
+            MoveTo(entity, Transition(record.archetype, component, true));
+        memcpy(ComponentAt(records[entity.index], component), value, ComponentRegistry()[component].size);
+    }
+
+    template <typename T>
+    void Remove(Entity entity)
+    {
+        int component = ComponentId<T>();
+        if (!Alive(entity) || (records[entity.index].archetype->mask & (1u << component)) == 0)
+            return;
+        MoveTo(entity, Transition(records[entity.index].archetype, component, false));
+    }
+
+    // The entity's component, or nullptr if it does not have one
+    template <typename T>
+    T* Get(Entity entity)
+    {
+        int component = ComponentId<T>();
+        if (!Alive(entity) || (records[entity.index].archetype->mask & (1u << component)) == 0)
+            return nullptr;
+        return (T*)ComponentAt(records[entity.index], component);
+    }
+
+    template <typename T>
+    bool Has(Entity entity) const
+    {
+        return Alive(entity) && (records[entity.index].archetype->mask & (1u << ComponentId<T>())) != 0;
+    }
+
+    // Call f(count, entities, Ts* arrays...) for every chunk of every
+    // archetype that has all of Ts. This is the loop systems are made of.
+    template <typename... Ts, typename F>
+    void ForEachChunk(F f)
+    {
+        ComponentMask need = MaskOf<Ts...>();
+        for (size_t a = 0; a < archetypes.size(); a++)
+        {
+            Archetype& archetype = *archetypes[a];
+            if ((archetype.mask & need) != need)
+                continue;
+            for (size_t c = 0; c < archetype.chunks.size(); c++)
+            {
+                Chunk& chunk = archetype.chunks[c];
+                if (chunk.count > 0)
+                    f(chunk.count, (const Entity*)chunk.data, (Ts*)(chunk.data + archetype.offsets[ComponentId<Ts>()])...);
+            }
+        }
+    }
+
+    // Call f(entity, Ts&...) for every entity that has all of Ts
+    template <typename... Ts, typename F>
+    void ForEach(F f)
+    {
+        ForEachChunk<Ts...>([&f](int count, const Entity* entities, Ts*... arrays) {
+            for (int i = 0; i < count; i++)
+                f(entities[i], arrays[i]...);
+        });
+    }
+
+    // Entities with all of Ts
+    template <typename... Ts>
+    int Count()
+    {
+        int total = 0;
+        ForEachChunk<Ts...>([&total](int count, const Entity*, Ts*...) { total += count; });
+        return total;
+    }
+
+    int EntityCount() const { return (int)(records.size() - freeIndices.size()); }
+    int ArchetypeCount() const { return (int)archetypes.size(); }
+
+private:
+    struct Chunk {
+        unsigned char* data; // Entity array, then one array per component
+        int count;
+    };
+
+    struct Archetype {
+        ComponentMask mask;
+        int capacity;                              // entities per chunk
+        size_t offsets[ECS_MAX_COMPONENTS];        // array offset in a chunk, by component id
+        std::vector<Chunk> chunks;
+        Archetype* adding[ECS_MAX_COMPONENTS];     // cached mask | bit transitions
+        Archetype* removing[ECS_MAX_COMPONENTS];   // cached mask & ~bit transitions
+    };
+
+    struct Record {
+        Archetype* archetype; // nullptr when the index is free
+        int chunk;
+        int row;
+        unsigned generation;
+    };
+
+    std::vector<Archetype*> archetypes;
+    std::vector<Record> records;
+    std::vector<unsigned> freeIndices;
+    Archetype* emptyArchetype;
+
+    Archetype* FindArchetype(ComponentMask mask)
+    {
+        for (size_t a = 0; a < archetypes.size(); a++)
+        {
+            if (archetypes[a]->mask == mask)
+                return archetypes[a];
+        }
+
+        Archetype* archetype = new Archetype();
+        archetype->mask = mask;
+        memset(archetype->adding, 0, sizeof(archetype->adding));
+        memset(archetype->removing, 0, sizeof(archetype->removing));
+
+        // Largest capacity whose aligned arrays fit in a chunk
+        size_t perEntity = sizeof(Entity);
+        for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+        {
+            if (mask & (1u << c))
+                perEntity += ComponentRegistry()[c].size;
+        }
+        int capacity = (int)(ECS_CHUNK_BYTES / perEntity);
+        while (capacity > 1 && Layout(archetype, capacity) > ECS_CHUNK_BYTES)
+            capacity--;
+        Layout(archetype, capacity);
+        archetype->capacity = capacity;
+        archetypes.push_back(archetype);
+        return archetype;
+    }
+
+    // Fill in the array offsets for capacity entities; returns bytes used
+    static size_t Layout(Archetype* archetype, int capacity)
+    {
+        size_t offset = sizeof(Entity) * capacity;
+        for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+        {
+            archetype->offsets[c] = 0;
+            if ((archetype->mask & (1u << c)) == 0)
+                continue;
+            const ComponentInfo& info = ComponentRegistry()[c];
+            offset = (offset + info.align - 1) / info.align * info.align;
+            archetype->offsets[c] = offset;
+            offset += info.size * capacity;
+        }
+        return offset;
+    }
+
+    Archetype* Transition(Archetype* from, int component, bool add)
+    {
+        Archetype*& cached = add ? from->adding[component] : from->removing[component];
+        if (!cached)
+            cached = FindArchetype(add ? from->mask | (1u << component) : from->mask & ~(1u << component));
+        return cached;
+    }
+
+    unsigned char* ComponentAt(const Record& record, int component)
+    {
+        const Archetype& archetype = *record.archetype;
+        return archetype.chunks[record.chunk].data + archetype.offsets[component] + ComponentRegistry()[component].size * record.row;
+    }
+
+    // Append entity to archetype's last chunk (component data uninitialized)
+    void Insert(Entity entity, Archetype* archetype)
+    {
+        if (archetype->chunks.empty() || archetype->chunks.back().count == archetype->capacity)
+        {
+            Chunk chunk = { new unsigned char[ECS_CHUNK_BYTES], 0 };
+            archetype->chunks.push_back(chunk);
+        }
+        int chunkIndex = (int)archetype->chunks.size() - 1;
+        Chunk& chunk = archetype->chunks[chunkIndex];
+        int row = chunk.count++;
+        ((Entity*)chunk.data)[row] = entity;
+
+        Record& record = records[entity.index];
+        record.archetype = archetype;
+        record.chunk = chunkIndex;
+        record.row = row;
+    }
+
+    // Fill the hole at (chunk, row) with the archetype's last entity
+    void RemoveRow(Archetype* archetype, int chunkIndex, int row)
+    {
+        Chunk& last = archetype->chunks.back();
+        int lastRow = last.count - 1;
+        Chunk& chunk = archetype->chunks[chunkIndex];
+        if (&chunk != &last || row != lastRow)
+        {
+            Entity moved = ((Entity*)last.data)[lastRow];
+            ((Entity*)chunk.data)[row] = moved;
+            for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+            {
+                if ((archetype->mask & (1u << c)) == 0)
+                    continue;
+                size_t size = ComponentRegistry()[c].size;
+                memcpy(chunk.data + archetype->offsets[c] + size * row, last.data + archetype->offsets[c] + size * lastRow, size);
+            }
+            records[moved.index].chunk = chunkIndex;
+            records[moved.index].row = row;
+        }
+        if (--last.count == 0)
+        {
+            delete[] last.data;
+            archetype->chunks.pop_back();
+        }
+    }
+
+    // Move entity to another archetype, keeping the components both share
+    void MoveTo(Entity entity, Archetype* to)
+    {
+        Record from = records[entity.index];
+        Insert(entity, to);
+        const Record& now = records[entity.index];
+        ComponentMask shared = from.archetype->mask & to->mask;
+        for (int c = 0; c < ECS_MAX_COMPONENTS; c++)
+        {
+            if ((shared & (1u << c)) == 0)
+                continue;
+            size_t size = ComponentRegistry()[c].size;
+            memcpy(to->chunks[now.chunk].data + to->offsets[c] + size * now.row,
+                   from.archetype->chunks[from.chunk].data + from.archetype->offsets[c] + size * from.row, size);
+        }
+        RemoveRow(from.archetype, from.chunk, from.row);
+    }
+
+    World(const World&);
+    World& operator=(const World&);
+};
+
+inline void CommandBuffer::Apply(World& world)
+{
+    created.resize(createdCount);
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        const Command& command = commands[i];
+        if (command.type == CREATE)
+        {
+            // Create straight into the archetype of the additions that follow
+            ComponentMask mask = 0;
+            for (size_t next = i + 1; next < commands.size() && commands[next].type == ADD && commands[next].created == command.created; next++)
+                mask |= 1u << commands[next].component;
+            created[command.created] = world.Create(mask);
+        }
+        else if (command.type == ADD)
+            world.AddRaw(created[command.created], command.component, &bytes[command.offset]);
+        else if (command.type == SET)
+            world.AddRaw(command.entity, command.component, &bytes[command.offset]); // ignored if destroyed
+        else
+            world.Destroy(command.entity); // ignored if already destroyed
+    }
+    commands.clear();
+    bytes.clear();
+    createdCount = 0;
+}
+
+class SystemScheduler
+{
+public:
+    explicit SystemScheduler(int threads = 0) : pool(threads), phaseCount(0) {}
+
+    // Register a system: an object with Run(World&, CommandBuffer&) that
+    // only reads the components in reads and writes those in writes.
+    // Systems run in registration order unless they do not conflict.
+    template <typename System>
+    void Add(const char* name, ComponentMask reads, ComponentMask writes, System& system)
+    {
+        Entry entry;
+        entry.name = name;
+        entry.reads = reads;
+        entry.writes = writes;
+        entry.system = &system;
+        entry.run = &Trampoline<System>;
+        entry.phase = 0;
+        for (size_t e = 0; e < entries.size(); e++)
+        {
+            if (Conflicts(entries[e], entry))
+                entry.phase = std::max(entry.phase, entries[e].phase + 1);
+        }
+        phaseCount = std::max(phaseCount, entry.phase + 1);
+        entries.push_back(entry);
+    }
+
+    // Run every system once, phase by phase
+    void Run(World& world)
+    {
+        for (int phase = 0; phase < phaseCount; phase++)
+        {
+            RunPhase body = { this, &world, phase };
+            pool.ParallelFor((int)entries.size(), 1, body);
+            for (size_t e = 0; e < entries.size(); e++)
+            {
+                if (entries[e].phase == phase && !entries[e].commands.Empty())
+                    entries[e].commands.Apply(world);
+            }
+        }
+    }
+
+    int PhaseCount() const { return phaseCount; }
+    int SystemCount() const { return (int)entries.size(); }
+    const char* SystemName(int i) const { return entries[i].name; }
+    int SystemPhase(int i) const { return entries[i].phase; }
+    int ThreadCount() const { return pool.ThreadCount(); }
+
+private:
+    typedef void (*RunFunc)(void* system, World& world, CommandBuffer& commands);
+
+    struct Entry {
+        const char* name;
+        ComponentMask reads;
+        ComponentMask writes;
+        void* system;
+        RunFunc run;
+        int phase;
+        CommandBuffer commands;
+    };
+
+    struct RunPhase {
+        SystemScheduler* scheduler;
+        World* world;
+        int phase;
+
+        void operator()(int begin, int end) const
+        {
+            for (int e = begin; e < end; e++)
+            {
+                Entry& entry = scheduler->entries[e];
+                if (entry.phase == phase)
+                    entry.run(entry.system, *world, entry.commands);
+            }
+        }
+    };
+
+    ThreadPool pool;
+    std::vector<Entry> entries;
+    int phaseCount;
+
+    template <typename System>
+    static void Trampoline(void* system, World& world, CommandBuffer& commands)
+    {
+        static_cast<System*>(system)->Run(world, commands);
+    }
+
+    static bool Conflicts(const Entry& a, const Entry& b)
+    {
+        return (a.writes & (b.reads | b.writes)) != 0 || (b.writes & a.reads) != 0;
+    }
+};
+
+#endif
@@ -0,0 +1,412 @@
+//=============================================================================
+// File Name: ecs_arena.h
+// Version: 1.0
+//
+// Description: A brick arena built on the entity component system
+// (ecs.h) instead of the Brick / Circle / Paddle classes. Every object is
+// an entity assembled from small components, and the behavior that used to
+// live in the classes and in main() is a set of systems:
+//
+//   Entity        Components
+//   ball          Position Velocity Radius Tint
+//   brick         Position Box Tint Health
+//   moving brick  brick + Velocity Oscillator
+//   power-up      Position Velocity Box Tint PowerUp
+//   paddle        Position Box Tint PlayerPaddle
+//
+// A new entity type is a new combination. Moving bricks reuse MoveSystem
+// and only add OscillatorSystem to turn around at their ends. Power-ups
+// reuse MoveSystem to fall and add PowerUpSystem to be caught.
+//
+// Phases the scheduler builds from the declared access (same phase = run
+// in parallel):
+//   0: PaddleSystem, FlashSystem
+//   1: MoveSystem
+//   2: WallSystem, PowerUpSystem
+//   3: OscillatorSystem
+//   4: CollisionSystem
+//
+// The classic game keeps its GameState: replays, rollback, the batch
+// environment and the network protocol depend on it being one plain block.
+//=============================================================================
+
+#ifndef ECS_ARENA_H
+#define ECS_ARENA_H
+
+#include "ecs.h"
+#include "brick_game.h"
+#include <vector>
+
+struct Position { float x, y; };
+struct Velocity { float dx, dy; };
+struct Radius { float r; };
+struct Box { float halfWidth, halfHeight; };
+struct Tint { float red, green, blue; };
+struct Health { int hitPoints, maxHitPoints; };
+struct Oscillator { float minX, maxX; };
+struct PlayerPaddle { float speed; };
+
+enum POWERUPKIND { POWERUP_WIDEN, POWERUP_MULTIBALL, POWERUP_KIND_COUNT };
+struct PowerUp { POWERUPKIND kind; };
+
+struct ArenaInput {
+    bool left;
+    bool right;
+};
+
+// Moves the paddle from the player's keys
+struct PaddleSystem {
+    ArenaInput input;
+
+    void Run(World& world, CommandBuffer&)
+    {
+        float direction = (input.right ? 1.0f : 0.0f) - (input.left ? 1.0f : 0.0f);
+        world.ForEach<PlayerPaddle, Box, Position>([direction](Entity, PlayerPaddle& paddle, Box& box, Position& position) {
+            position.x += direction * paddle.speed;
+            float limit = 1.0f - box.halfWidth;
+            position.x = position.x < -limit ? -limit : (position.x > limit ? limit : position.x);
+        });
+    }
+};
+
+// Bricks turn red as they lose hit points
+struct FlashSystem {
+    void Run(World& world, CommandBuffer&)
+    {
+        world.ForEachChunk<Health, Tint>([](int count, const Entity*, Health* health, Tint* tint) {
+            for (int i = 0; i < count; i++)
+            {
+                float damage = 1.0f - (float)health[i].hitPoints / health[i].maxHitPoints;
+                tint[i].red = tint[i].red + (1.0f - tint[i].red) * damage * 0.1f;
+            }
+        });
+    }
+};
+
+// Everything with a velocity moves: balls, moving bricks, power-ups
+struct MoveSystem {
+    void Run(World& world, CommandBuffer&)
+    {
+        world.ForEachChunk<Velocity, Position>([](int count, const Entity*, Velocity* velocity, Position* position) {
+            for (int i = 0; i < count; i++)
+            {
+                position[i].x += velocity[i].dx;
+                position[i].y += velocity[i].dy;
+            }
+        });
+    }
+};
+
+// Balls bounce off the side and top walls and are lost at the bottom
+struct WallSystem {
+    int lost = 0;
+
+    void Run(World& world, CommandBuffer& commands)
+    {
+        world.ForEachChunk<Position, Radius, Velocity>([this, &commands](int count, const Entity* entities, Position* position, Radius* radius, Velocity* velocity) {
+            for (int i = 0; i < count; i++)
+            {
+                if ((position[i].x < -1.0f + radius[i].r && velocity[i].dx < 0.0f) || (position[i].x > 1.0f - radius[i].r && velocity[i].dx > 0.0f))
+                    velocity[i].dx = -velocity[i].dx;
+                if (position[i].y > 1.0f - radius[i].r && velocity[i].dy > 0.0f)
+                    velocity[i].dy = -velocity[i].dy;
+                if (position[i].y < -1.0f - radius[i].r)
+                {
+                    commands.Destroy(entities[i]);
+                    lost++;
+                }
+            }
+        });
+    }
+};
+
+// Moving bricks turn around at the ends of their track
+struct OscillatorSystem {
+    void Run(World& world, CommandBuffer&)
+    {
+        world.ForEachChunk<Position, Oscillator, Velocity>([](int count, const Entity*, Position* position, Oscillator* track, Velocity* velocity) {
+            for (int i = 0; i < count; i++)
+            {
+                if ((position[i].x < track[i].minX && velocity[i].dx < 0.0f) || (position[i].x > track[i].maxX && velocity[i].dx > 0.0f))
+                    velocity[i].dx = -velocity[i].dx;
+            }
+        });
+    }
+};
+
+// Power-ups caught by the paddle take effect; missed ones disappear
+struct PowerUpSystem {
+    int caught = 0;
+
+    void Run(World& world, CommandBuffer& commands)
+    {
+        Entity paddle = NULL_ENTITY;
+        Position paddlePosition = { 0.0f, 0.0f };
+        Box paddleBox = { 0.0f, 0.0f };
+        world.ForEach<PlayerPaddle, Position, Box>([&](Entity entity, PlayerPaddle&, Position& position, Box& box) {
+            paddle = entity;
+            paddlePosition = position;
+            paddleBox = box;
+        });
+
+        world.ForEach<PowerUp, Position, Box>([&](Entity entity, PowerUp& powerUp, Position& position, Box& box) {
+            bool overlaps = fabsf(position.x - paddlePosition.x) < box.halfWidth + paddleBox.halfWidth &&
+                            fabsf(position.y - paddlePosition.y) < box.halfHeight + paddleBox.halfHeight;
+            if (overlaps && !(paddle == NULL_ENTITY))
+            {
+                caught++;
+                if (powerUp.kind == POWERUP_WIDEN)
+                {
+                    Box wider = { paddleBox.halfWidth * 1.25f, paddleBox.halfHeight };
+                    commands.Set(paddle, wider);
+                }
+                else
+                {
+                    for (int b = 0; b < 2; b++)
+                        SpawnArenaBall(commands, paddlePosition.x, paddlePosition.y + 0.1f, b == 0 ? -0.01f : 0.01f, 0.015f);
+                }
+                commands.Destroy(entity);
+            }
+            else if (position.y < -1.1f)
+            {
+                commands.Destroy(entity);
+            }
+        });
+    }
+
+    static void SpawnArenaBall(CommandBuffer& commands, float x, float y, float dx, float dy)
+    {
+        int ball = commands.Create();
+        Position position = { x, y };
+        Velocity velocity = { dx, dy };
+        Radius radius = { 0.02f };
+        Tint tint = { 1.0f, 1.0f, 1.0f };
+        commands.Add(ball, position);
+        commands.Add(ball, velocity);
+        commands.Add(ball, radius);
+        commands.Add(ball, tint);
+    }
+};
+
+// Balls against bricks and the paddle. Bricks lose a hit point per hit and
+// every third brick destroyed drops a power-up.
+struct CollisionSystem {
+    int score = 0;
+    unsigned destroyed = 0;
+
+    struct Target {
+        Entity entity;
+        Position position;
+        Box box;
+        Health* health; // nullptr for the paddle
+    };
+    std::vector<Target> targets; // rebuilt each tick, capacity kept
+
+    void Run(World& world, CommandBuffer& commands)
+    {
+        targets.clear();
+        world.ForEachChunk<Position, Box, Health>([this](int count, const Entity* entities, Position* position, Box* box, Health* health) {
+            for (int i = 0; i < count; i++)
+            {
+                Target target = { entities[i], position[i], box[i], &health[i] };
+                targets.push_back(target);
+            }
+        });
+        world.ForEach<Position, Box, PlayerPaddle>([this](Entity entity, Position& position, Box& box, PlayerPaddle&) {
+            Target target = { entity, position, box, nullptr };
+            targets.push_back(target);
+        });
+
+        world.ForEachChunk<Position, Radius, Velocity>([&](int count, const Entity*, Position* position, Radius* radius, Velocity* velocity) {
+            for (int i = 0; i < count; i++)
+            {
+                for (size_t t = 0; t < targets.size(); t++)
+                    Collide(position[i], radius[i].r, velocity[i], targets[t], commands);
+            }
+        });
+    }
+
+    void Collide(const Position& ball, float r, Velocity& velocity, Target& target, CommandBuffer& commands)
+    {
+        float dx = ball.x - target.position.x;
+        float dy = ball.y - target.position.y;
+        float overlapX = target.box.halfWidth + r - fabsf(dx);
+        float overlapY = target.box.halfHeight + r - fabsf(dy);
+        if (overlapX <= 0.0f || overlapY <= 0.0f)
+            return;
+        if (target.health && target.health->hitPoints <= 0)
+            return; // already destroyed this tick
+
+        // Reflect on the axis of least penetration, only when moving inwards
+        bool bounced = false;
+        if (overlapX < overlapY)
+        {
+            if (dx * velocity.dx < 0.0f)
+            {
+                velocity.dx = -velocity.dx;
+                bounced = true;
+            }
+        }
+        else if (dy * velocity.dy < 0.0f)
+        {
+            velocity.dy = -velocity.dy;
+            if (!target.health)
+                velocity.dx += dx / target.box.halfWidth * 0.005f; // the paddle steers the ball
+            bounced = true;
+        }
+        if (!bounced || !target.health)
+            return;
+
+        if (--target.health->hitPoints > 0)
+            return;
+        score++;
+        commands.Destroy(target.entity);
+        if (destroyed++ % 3 == 0)
+            SpawnPowerUp(commands, target.position, (POWERUPKIND)((destroyed / 3) % POWERUP_KIND_COUNT));
+    }
+
+    static void SpawnPowerUp(CommandBuffer& commands, const Position& at, POWERUPKIND kind)
+    {
+        int entity = commands.Create();
+        Velocity velocity = { 0.0f, -0.01f };
+        Box box = { 0.03f, 0.03f };
+        Tint tint = { kind == POWERUP_WIDEN ? 0.2f : 1.0f, 0.9f, kind == POWERUP_WIDEN ? 1.0f : 0.2f };
+        PowerUp powerUp = { kind };
+        commands.Add(entity, at);
+        commands.Add(entity, velocity);
+        commands.Add(entity, box);
+        commands.Add(entity, tint);
+        commands.Add(entity, powerUp);
+    }
+};
+
+class Arena
+{
+public:
+    // balls extra balls start in play; threads as for ThreadPool
+    Arena(unsigned seed, int balls, int threads = 0) : scheduler(threads), tick(0)
+    {
+        GameRandom rng;
+        rng.Seed(seed);
+
+        Entity paddle = world.Create(MaskOf<Position, Box, Tint, PlayerPaddle>());
+        *world.Get<Position>(paddle) = Position{ 0.0f, -0.9f };
+        *world.Get<Box>(paddle) = Box{ 0.1f, 0.025f };
+        *world.Get<Tint>(paddle) = Tint{ 0.5f, 0.5f, 0.5f };
+        *world.Get<PlayerPaddle>(paddle) = PlayerPaddle{ 0.03f };
+
+        for (int row = 0; row < 5; row++)
+        {
+            for (int column = 0; column < 10; column++)
+            {
+                Entity brick = world.Create(MaskOf<Position, Box, Tint, Health>());
+                *world.Get<Position>(brick) = Position{ -0.9f + column * 0.2f, 0.3f + row * 0.12f };
+                *world.Get<Box>(brick) = Box{ 0.08f, 0.04f };
+                *world.Get<Tint>(brick) = Tint{ 0.2f + 0.15f * row, 0.3f + 0.05f * column, 0.8f - 0.1f * row };
+                *world.Get<Health>(brick) = Health{ 3, 3 };
+            }
+        }
+
+        // Moving bricks: a brick plus Velocity and Oscillator
+        for (int m = 0; m < 4; m++)
+        {
+            Entity brick = world.Create(MaskOf<Position, Box, Tint, Health, Velocity, Oscillator>());
+            *world.Get<Position>(brick) = Position{ -0.6f + m * 0.4f, 0.05f };
+            *world.Get<Box>(brick) = Box{ 0.08f, 0.03f };
+            *world.Get<Tint>(brick) = Tint{ 0.9f, 0.6f, 0.1f };
+            *world.Get<Health>(brick) = Health{ 5, 5 };
+            *world.Get<Velocity>(brick) = Velocity{ m % 2 ? 0.006f : -0.006f, 0.0f };
+            *world.Get<Oscillator>(brick) = Oscillator{ -0.8f, 0.8f };
+        }
+
+        for (int b = 0; b < balls; b++)
+        {
+            Entity ball = world.Create(MaskOf<Position, Velocity, Radius, Tint>());
+            float angle = (rng.Next() % 6283) / 1000.0f;
+            *world.Get<Position>(ball) = Position{ (rng.Next() % 18000) / 10000.0f - 0.9f, (rng.Next() % 5000) / 10000.0f - 0.6f };
+            *world.Get<Velocity>(ball) = Velocity{ cosf(angle) * 0.012f, fabsf(sinf(angle)) * 0.012f + 0.004f };
+            *world.Get<Radius>(ball) = Radius{ 0.01f };
+            *world.Get<Tint>(ball) = Tint{ (rng.Next() % 100) / 100.0f, (rng.Next() % 100) / 100.0f, 1.0f };
+        }
+
+        scheduler.Add("PaddleSystem", MaskOf<PlayerPaddle, Box>(), MaskOf<Position>(), paddleSystem);
+        scheduler.Add("FlashSystem", MaskOf<Health>(), MaskOf<Tint>(), flashSystem);
+        scheduler.Add("MoveSystem", MaskOf<Velocity>(), MaskOf<Position>(), moveSystem);
+        scheduler.Add("WallSystem", MaskOf<Position, Radius>(), MaskOf<Velocity>(), wallSystem);
+        scheduler.Add("PowerUpSystem", MaskOf<PowerUp, Position, Box, PlayerPaddle>(), 0, powerUpSystem);
+        scheduler.Add("OscillatorSystem", MaskOf<Position, Oscillator>(), MaskOf<Velocity>(), oscillatorSystem);
+        scheduler.Add("CollisionSystem", MaskOf<Position, Radius, Box, PlayerPaddle>(), MaskOf<Velocity, Health>(), collisionSystem);
+    }
+
+    void Step(const ArenaInput& input)
+    {
+        paddleSystem.input = input;
+        scheduler.Run(world);
+        tick++;
+    }
+
+    // FNV-1a over every position, in storage order
+    unsigned Hash()
+    {
+        unsigned hash = 2166136261u;
+        world.ForEachChunk<Position>([&hash](int count, const Entity*, Position* position) {
+            const unsigned char* bytes = (const unsigned char*)position;
+            for (size_t i = 0; i < count * sizeof(Position); i++)
+            {
+                hash ^= bytes[i];
+                hash *= 16777619u;
+            }
+        });
+        return hash;
+    }
+
+    World& GetWorld() { return world; }
+    const SystemScheduler& Scheduler() const { return scheduler; }
+    unsigned Tick() const { return tick; }
+    int Score() const { return collisionSystem.score; }
+    int BallsLost() const { return wallSystem.lost; }
+    int PowerUpsCaught() const { return powerUpSystem.caught; }
+
+#ifndef BRICK_HEADLESS
+    // Draw every box and ball in its tint
+    void Draw()
+    {
+        world.ForEach<Position, Box, Tint>([](Entity, Position& position, Box& box, Tint& tint) {
+            glColor3f(tint.red, tint.green, tint.blue);
+            glBegin(GL_POLYGON);
+            glVertex2f(position.x - box.halfWidth, position.y - box.halfHeight);
+            glVertex2f(position.x + box.halfWidth, position.y - box.halfHeight);
+            glVertex2f(position.x + box.halfWidth, position.y + box.halfHeight);
+            glVertex2f(position.x - box.halfWidth, position.y + box.halfHeight);
+            glEnd();
+        });
+        world.ForEach<Position, Radius, Tint>([](Entity, Position& position, Radius& radius, Tint& tint) {
+            glColor3f(tint.red, tint.green, tint.blue);
+            glBegin(GL_POLYGON);
+            for (int i = 0; i < 12; i++)
+            {
+                float angle = i * (6.2831853f / 12);
+                glVertex2f(position.x + cosf(angle) * radius.r, position.y + sinf(angle) * radius.r);
+            }
+            glEnd();
+        });
+    }
+#endif
+
+private:
+    World world;
+    SystemScheduler scheduler;
+    unsigned tick;
+    PaddleSystem paddleSystem;
+    FlashSystem flashSystem;
+    MoveSystem moveSystem;
+    WallSystem wallSystem;
+    PowerUpSystem powerUpSystem;
+    OscillatorSystem oscillatorSystem;
+    CollisionSystem collisionSystem;
+
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+};
+
+#endif
@@ -0,0 +1,245 @@
+//=============================================================================
+// File Name: frame_pacer.h
+// Version: 1.0
+//
+// Description: Selectable presentation modes for the render loops of the
+// brick game and the pyramid. A loop calls
+//   WaitBeforeInput(focused)  before polling input,
+//   WaitBeforeSwap()          before the buffer swap,
+//   FrameDone()               after it,
+// and sets the swap interval from SwapInterval(). The pacer decides which
+// of these waits:
+//
+//   vsync        swap interval 1; the driver paces, the pacer never waits
+//   uncapped     swap interval 0, no waits
+//   limited      swap interval 0; waits before the swap until the frame's
+//                deadline, so frames are presented at a steady rate
+//   low-latency  as limited, but most of the wait moves to the start of the
+//                frame: the loop sleeps until the deadline minus the work a
+//                frame is expected to take, then samples input. This only
+//                lowers latency if the loop uses that input in the same
+//                frame; a simulation on its own clock would not see it
+//                until its next tick.
+//
+// In any mode, an unfocused window waits for the background rate (a plain
+// sleep, no spinning) so a hidden game does not burn a core.
+//
+// Algorithmic Logic:
+// - Precise waits sleep until a margin before the deadline and spin the
+//   rest. The margin follows the measured oversleep: it jumps up when a
+//   sleep overshoots and decays slowly, which copes with coarse OS timers.
+// - Frame times are present-to-present intervals; their mean and variance
+//   are kept with Welford's method, so reporting needs no history.
+// - LastBusySeconds() is the last frame time minus the pacer's own waits:
+//   what the frame cost, for controllers such as dynamic resolution.
+//=============================================================================
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+enum PRESENTMODE { PRESENT_VSYNC, PRESENT_UNCAPPED, PRESENT_LIMITED, PRESENT_LOW_LATENCY };
+
+struct FrameTimeStats {
+    unsigned long long frames;
+    double mean;        // seconds
+    double m2;          // sum of squared differences from the mean
+    double shortest, longest;
+
+    void Reset()
+    {
+        frames = 0;
+        mean = m2 = 0.0;
+        shortest = 1e30;
+        longest = 0.0;
+    }
+
+    void Add(double seconds)
+    {
+        frames++;
+        double delta = seconds - mean;
+        mean += delta / frames;
+        m2 += delta * (seconds - mean);
+        shortest = seconds < shortest ? seconds : shortest;
+        longest = seconds > longest ? seconds : longest;
+    }
+
+    double Variance() const { return frames > 1 ? m2 / (frames - 1) : 0.0; }
+};
+
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    FramePacer(PRESENTMODE mode = PRESENT_VSYNC, double targetHz = 60.0, double backgroundHz = 10.0)
+        : mode(mode), backgroundFrames(0), sleepMargin(0.002), expectedWork(0.0), background(false), wasBackground(false)
+    {
+        SetRates(targetHz, backgroundHz);
+        foreground.Reset();
+        lastPresent = frameStart = deadline = Clock::now();
+        started = false;
+        waited = lastFrame = lastBusy = 0.0;
+    }
+
+    // "vsync", "uncapped", "limited" or "low-latency"
+    static bool ParseMode(const char* name, PRESENTMODE& mode)
+    {
+        const char* names[] = { "vsync", "uncapped", "limited", "low-latency" };
+        for (int i = 0; i < 4; i++)
+        {
+            if (strcmp(name, names[i]) == 0)
+            {
+                mode = (PRESENTMODE)i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static const char* ModeName(PRESENTMODE mode)
+    {
+        const char* names[] = { "vsync", "uncapped", "limited", "low-latency" };
+        return names[mode];
+    }
+
+    void SetMode(PRESENTMODE newMode) { mode = newMode; }
+
+    // targetHz paces limited and low-latency; backgroundHz <= 0 keeps the
+    // normal rate when the window loses focus
+    void SetRates(double targetHz, double backgroundHz)
+    {
+        period = targetHz > 0.0 ? 1.0 / targetHz : 1.0 / 60.0;
+        backgroundPeriod = backgroundHz > 0.0 ? 1.0 / backgroundHz : 0.0;
+    }
+
+    int SwapInterval() const { return mode == PRESENT_VSYNC ? 1 : 0; }
+
+    void WaitBeforeInput(bool focused)
+    {
+        Clock::time_point now = Clock::now();
+        if (!started)
+        {
+            started = true;
+            lastPresent = now;
+            deadline = now + Seconds(period);
+        }
+
+        background = !focused && backgroundPeriod > 0.0;
+        Clock::time_point waitStart = Clock::now();
+        if (background)
+        {
+            std::this_thread::sleep_until(lastPresent + Seconds(backgroundPeriod));
+        }
+        else if (mode == PRESENT_LOW_LATENCY)
+        {
+            // Leave time for the work of a frame plus half a millisecond
+            WaitUntil(deadline - Seconds(expectedWork + 0.0005));
+        }
+        frameStart = Clock::now();
+        waited += std::chrono::duration<double>(frameStart - waitStart).count();
+    }
+
+    void WaitBeforeSwap()
+    {
+        // Work is measured before the wait so the estimate excludes it
+        double work = std::chrono::duration<double>(Clock::now() - frameStart).count();
+        expectedWork = work > expectedWork ? work : 0.95 * expectedWork + 0.05 * work;
+        if (!background && (mode == PRESENT_LIMITED || mode == PRESENT_LOW_LATENCY))
+        {
+            Clock::time_point waitStart = Clock::now();
+            WaitUntil(deadline);
+            waited += std::chrono::duration<double>(Clock::now() - waitStart).count();
+        }
+    }
+
+    void FrameDone()
+    {
+        Clock::time_point now = Clock::now();
+        double frameTime = std::chrono::duration<double>(now - lastPresent).count();
+        lastPresent = now;
+        lastFrame = frameTime;
+        lastBusy = frameTime > waited ? frameTime - waited : 0.0;
+        waited = 0.0;
+        if (background)
+            backgroundFrames++;
+        else if (!wasBackground)
+            foreground.Add(frameTime); // the frame back from the background is not a normal one
+        wasBackground = background;
+
+        // Next deadline one period on; a frame that ran late more than a
+        // period restarts the schedule instead of rushing to catch up
+        deadline += Seconds(period);
+        if (deadline < now)
+            deadline = now + Seconds(period);
+    }
+
+    const FrameTimeStats& Stats() const { return foreground; }
+    unsigned long long BackgroundFrames() const { return backgroundFrames; }
+    PRESENTMODE Mode() const { return mode; }
+    double LastFrameSeconds() const { return lastFrame; }
+    double LastBusySeconds() const { return lastBusy; }
+
+    void Report(std::ostream& out) const
+    {
+        out << "Presentation " << ModeName(mode);
+        if (mode == PRESENT_LIMITED || mode == PRESENT_LOW_LATENCY)
+            out << " at " << 1.0 / period << " Hz";
+        out << ": " << foreground.frames << " frames";
+        if (foreground.frames > 0)
+        {
+            out << ", frame time mean " << foreground.mean * 1000.0 << " ms, std dev "
+                << std::sqrt(foreground.Variance()) * 1000.0 << " ms (variance "
+                << foreground.Variance() * 1e6 << " ms^2), min " << foreground.shortest * 1000.0
+                << " ms, max " << foreground.longest * 1000.0 << " ms";
+        }
+        out << "; " << backgroundFrames << " frames in the background" << std::endl;
+    }
+
+private:
+    PRESENTMODE mode;
+    double period;
+    double backgroundPeriod;
+    FrameTimeStats foreground;
+    unsigned long long backgroundFrames;
+    double sleepMargin;       // seconds before a deadline to stop sleeping
+    double expectedWork;      // seconds from input to swap
+    bool background;          // this frame is paced at the background rate
+    bool wasBackground;
+    bool started;
+    double waited;            // seconds spent in the pacer's waits this frame
+    double lastFrame;
+    double lastBusy;
+    Clock::time_point lastPresent;
+    Clock::time_point frameStart;
+    Clock::time_point deadline;
+
+    static Clock::duration Seconds(double seconds)
+    {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    // Sleep most of the way, then spin to the deadline
+    void WaitUntil(Clock::time_point target)
+    {
+        Clock::time_point now = Clock::now();
+        Clock::duration margin = Seconds(sleepMargin);
+        if (target - now > margin)
+        {
+            Clock::time_point wake = target - margin;
+            std::this_thread::sleep_until(wake);
+            double oversleep = std::chrono::duration<double>(Clock::now() - wake).count();
+            double wanted = oversleep + 0.0002;
+            sleepMargin = wanted > sleepMargin ? wanted : 0.99 * sleepMargin + 0.01 * wanted;
+        }
+        while (Clock::now() < target)
+            std::this_thread::yield();
+    }
+};
+
+#endif
@@ -0,0 +1,368 @@
+//=============================================================================
+// File Name: hud_text.h
+// Version: 1.0
+//
+// Description: HUD text for lives and score. At startup, a built-in 5x7
+// pixel font is baked into a signed distance field atlas. Each texel
+// stores how far it is from the nearest glyph edge (0.5 on the edge, more
+// inside). The texture is sampled with linear filtering and alpha tested
+// at 0.5, so the glyphs keep sharp edges at any size. This needs only the
+// fixed-function pipeline, not a shader.
+//
+// Data Structures:
+// - SdfFontAtlas: one A8 image with a cell per character, baked once.
+// - HudText: a fixed set of labels. Each label keeps the text it last laid
+//   out and its vertices. SetText() lays a label out again only if the
+//   text changed. Draw() rebuilds the combined vertex array only after a
+//   change, then draws all labels with one glDrawArrays call.
+//
+// Algorithmic Logic:
+// - Bake: the glyphs are made of square font pixels, so the distance from
+//   a texel to the glyph is the distance to the nearest font pixel of the
+//   other kind (to the cell border too, for texels inside). Exact, and
+//   O(texels * 35) once.
+//
+// Characters outside the font are drawn as '?'; lower case is drawn as
+// upper case.
+//=============================================================================
+
+#ifndef HUD_TEXT_H
+#define HUD_TEXT_H
+
+#ifndef BRICK_HEADLESS
+#include <GLFW\glfw3.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+const int FONT_FIRST_CHAR = 32;         // ' '
+const int FONT_LAST_CHAR = 90;          // 'Z'
+const int FONT_GLYPH_COUNT = FONT_LAST_CHAR - FONT_FIRST_CHAR + 1;
+const int FONT_COLUMNS = 5;             // font pixels per glyph
+const int FONT_ROWS = 7;
+const int FONT_ADVANCE = 6;             // font pixels from one glyph to the next
+const int SDF_SCALE = 8;                // texels per font pixel
+const int SDF_PAD = 8;                  // texels of distance field around a glyph
+const int SDF_CELL_WIDTH = FONT_COLUMNS * SDF_SCALE + 2 * SDF_PAD;
+const int SDF_CELL_HEIGHT = FONT_ROWS * SDF_SCALE + 2 * SDF_PAD;
+const int SDF_ATLAS_COLUMNS = 9;
+const int SDF_ATLAS_SIZE = 512;         // square, holds 9 x 7 cells
+
+const int MAX_HUD_LABELS = 16;
+const int MAX_LABEL_CHARS = 48;
+
+// Rows top to bottom, bit 4 is the leftmost column
+static const unsigned char FONT_5X7[FONT_GLYPH_COUNT][FONT_ROWS] = {
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+    { 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // !
+    { 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+    { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A }, // #
+    { 0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04 }, // $
+    { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 }, // %
+    { 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, // &
+    { 0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+    { 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+    { 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+    { 0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00 }, // *
+    { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // +
+    { 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ,
+    { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+    { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+    { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+    { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+    { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 1
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // 2
+    { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // 3
+    { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // 4
+    { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // 5
+    { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // 6
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+    { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // 8
+    { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+    { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 }, // ;
+    { 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 }, // <
+    { 0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00 }, // =
+    { 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 }, // >
+    { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 }, // ?
+    { 0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E }, // @
+    { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // A
+    { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // B
+    { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // C
+    { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // D
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // E
+    { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // F
+    { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // G
+    { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // H
+    { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // I
+    { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // J
+    { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+    { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // L
+    { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+    { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+    { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // O
+    { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // P
+    { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // Q
+    { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // R
+    { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // S
+    { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // U
+    { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // V
+    { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // W
+    { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // X
+    { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // Y
+    { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+};
+
+struct HudVertex {
+    float x, y;
+    float u, v;
+    unsigned color; // RGBA bytes
+};
+
+// Glyph index for a character
+inline int FontGlyph(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        c = c - 'a' + 'A';
+    if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR)
+        c = '?';
+    return c - FONT_FIRST_CHAR;
+}
+
+inline bool FontPixel(int glyph, int column, int row)
+{
+    return column >= 0 && column < FONT_COLUMNS && row >= 0 && row < FONT_ROWS &&
+           (FONT_5X7[glyph][row] >> (FONT_COLUMNS - 1 - column)) & 1;
+}
+
+class SdfFontAtlas
+{
+public:
+    std::vector<unsigned char> pixels; // SDF_ATLAS_SIZE squared, row 0 at v = 0
+
+    void Bake()
+    {
+        pixels.assign(SDF_ATLAS_SIZE * SDF_ATLAS_SIZE, 0);
+        const float spread = (float)SDF_PAD / SDF_SCALE; // in font pixels
+        for (int glyph = 0; glyph < FONT_GLYPH_COUNT; glyph++)
+        {
+            int cellX = (glyph % SDF_ATLAS_COLUMNS) * SDF_CELL_WIDTH;
+            int cellY = (glyph / SDF_ATLAS_COLUMNS) * SDF_CELL_HEIGHT;
+            for (int ty = 0; ty < SDF_CELL_HEIGHT; ty++)
+            {
+                for (int tx = 0; tx < SDF_CELL_WIDTH; tx++)
+                {
+                    // Texel center in font pixels from the glyph's top left
+                    float fx = (tx + 0.5f - SDF_PAD) / SDF_SCALE;
+                    float fy = (ty + 0.5f - SDF_PAD) / SDF_SCALE;
+                    bool inside = FontPixel(glyph, (int)floorf(fx), (int)floorf(fy));
+                    float distance = inside ? DistanceToBorder(fx, fy) : spread;
+                    for (int row = 0; row < FONT_ROWS; row++)
+                    {
+                        for (int column = 0; column < FONT_COLUMNS; column++)
+                        {
+                            if (FontPixel(glyph, column, row) != inside)
+                            {
+                                float d = DistanceToPixel(fx, fy, column, row);
+                                distance = d < distance ? d : distance;
+                            }
+                        }
+                    }
+                    float value = 0.5f + 0.5f * (inside ? distance : -distance) / spread;
+                    value = value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+                    pixels[(cellY + ty) * SDF_ATLAS_SIZE + cellX + tx] = (unsigned char)(value * 255.0f + 0.5f);
+                }
+            }
+        }
+    }
+
+    // Atlas coordinates of a glyph's cell, padding included
+    static void GlyphCell(int glyph, float& u0, float& v0, float& u1, float& v1)
+    {
+        u0 = (float)((glyph % SDF_ATLAS_COLUMNS) * SDF_CELL_WIDTH) / SDF_ATLAS_SIZE;
+        v0 = (float)((glyph / SDF_ATLAS_COLUMNS) * SDF_CELL_HEIGHT) / SDF_ATLAS_SIZE;
+        u1 = u0 + (float)SDF_CELL_WIDTH / SDF_ATLAS_SIZE;
+        v1 = v0 + (float)SDF_CELL_HEIGHT / SDF_ATLAS_SIZE;
+    }
+
+private:
+    static float DistanceToPixel(float x, float y, int column, int row)
+    {
+        float dx = x < column ? column - x : (x > column + 1 ? x - column - 1 : 0.0f);
+        float dy = y < row ? row - y : (y > row + 1 ? y - row - 1 : 0.0f);
+        return sqrtf(dx * dx + dy * dy);
+    }
+
+    // Outside the 5x7 cell every pixel is off
+    static float DistanceToBorder(float x, float y)
+    {
+        float d = x;
+        d = FONT_COLUMNS - x < d ? FONT_COLUMNS - x : d;
+        d = y < d ? y : d;
+        d = FONT_ROWS - y < d ? FONT_ROWS - y : d;
+        return d;
+    }
+};
+
+// Two triangles per visible character of text, top left at (x, y), size
+// being the height of a capital letter. Returns the vertices written to
+// out, which holds 6 * MAX_LABEL_CHARS.
+inline int LayoutHudText(const char* text, float x, float y, float size, unsigned color, HudVertex* out)
+{
+    const float unit = size / FONT_ROWS; // one font pixel
+    const float pad = (float)SDF_PAD / SDF_SCALE * unit;
+    int count = 0;
+    for (int i = 0; text[i] && i < MAX_LABEL_CHARS; i++)
+    {
+        float left = x + i * FONT_ADVANCE * unit;
+        if (text[i] == ' ')
+            continue;
+        float u0, v0, u1, v1;
+        SdfFontAtlas::GlyphCell(FontGlyph(text[i]), u0, v0, u1, v1);
+        float x0 = left - pad, x1 = left + FONT_COLUMNS * unit + pad;
+        float y0 = y + pad, y1 = y - FONT_ROWS * unit - pad; // y grows upward
+        HudVertex quad[6] = {
+            { x0, y0, u0, v0, color }, { x1, y0, u1, v0, color }, { x1, y1, u1, v1, color },
+            { x0, y0, u0, v0, color }, { x1, y1, u1, v1, color }, { x0, y1, u0, v1, color },
+        };
+        memcpy(out + count, quad, sizeof(quad));
+        count += 6;
+    }
+    return count;
+}
+
+class HudText
+{
+public:
+    HudText() : labelCount(0), vertexCount(0), layouts(0), dirty(false), texture(0)
+    {
+        atlas.Bake();
+        labels.resize(MAX_HUD_LABELS);
+        batch.resize(MAX_HUD_LABELS * MAX_LABEL_CHARS * 6);
+    }
+
+#ifndef BRICK_HEADLESS
+    ~HudText()
+    {
+        if (texture)
+            glDeleteTextures(1, &texture);
+    }
+#endif
+
+    // A label whose text starts empty. Returns -1 when all are in use.
+    int AddLabel(float x, float y, float size, float red, float green, float blue)
+    {
+        if (labelCount == MAX_HUD_LABELS)
+            return -1;
+        Label& label = labels[labelCount];
+        label.x = x;
+        label.y = y;
+        label.size = size;
+        label.color = (unsigned)(red * 255.0f) | ((unsigned)(green * 255.0f) << 8) | ((unsigned)(blue * 255.0f) << 16) | 0xFF000000u;
+        label.text[0] = '\0';
+        label.vertexCount = 0;
+        return labelCount++;
+    }
+
+    // Lays the label out again only if text differs from what it shows
+    void SetText(int label, const char* text)
+    {
+        Label& l = labels[label];
+        if (strncmp(l.text, text, MAX_LABEL_CHARS) == 0)
+            return;
+        strncpy(l.text, text, MAX_LABEL_CHARS);
+        l.text[MAX_LABEL_CHARS] = '\0';
+        l.vertexCount = LayoutHudText(l.text, l.x, l.y, l.size, l.color, l.vertices);
+        layouts++;
+        dirty = true;
+    }
+
+    // Labels laid out so far; stays put while the text does
+    unsigned long long LayoutCount() const { return layouts; }
+    int VertexCount() { Rebuild(); return vertexCount; }
+    const SdfFontAtlas& Atlas() const { return atlas; }
+
+#ifndef BRICK_HEADLESS
+    // Every label in one draw call. The atlas is uploaded on first use,
+    // when a GL context is current.
+    void Draw()
+    {
+        if (!texture)
+            Upload();
+        Rebuild();
+        if (vertexCount == 0)
+            return;
+
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glEnable(GL_ALPHA_TEST);
+        glAlphaFunc(GL_GEQUAL, 0.5f); // the glyph edge
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, sizeof(HudVertex), &batch[0].x);
+        glTexCoordPointer(2, GL_FLOAT, sizeof(HudVertex), &batch[0].u);
+        glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(HudVertex), &batch[0].color);
+        glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisable(GL_ALPHA_TEST);
+        glDisable(GL_TEXTURE_2D);
+    }
+#endif
+
+private:
+    struct Label {
+        float x, y, size;
+        unsigned color;
+        char text[MAX_LABEL_CHARS + 1];
+        HudVertex vertices[MAX_LABEL_CHARS * 6];
+        int vertexCount;
+    };
+
+    SdfFontAtlas atlas;
+    std::vector<Label> labels;
+    std::vector<HudVertex> batch;
+    int labelCount;
+    int vertexCount;
+    unsigned long long layouts;
+    bool dirty;
+    unsigned texture;
+
+    // Concatenate the labels after any of them changed
+    void Rebuild()
+    {
+        if (!dirty)
+            return;
+        vertexCount = 0;
+        for (int i = 0; i < labelCount; i++)
+        {
+            memcpy(&batch[vertexCount], labels[i].vertices, labels[i].vertexCount * sizeof(HudVertex));
+            vertexCount += labels[i].vertexCount;
+        }
+        dirty = false;
+    }
+
+#ifndef BRICK_HEADLESS
+    void Upload()
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, SDF_ATLAS_SIZE, SDF_ATLAS_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, atlas.pixels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    }
+#endif
+
+    HudText(const HudText&);
+    HudText& operator=(const HudText&);
+};
+
+#endif
@@ -0,0 +1,84 @@
+//=============================================================================
+// File Name: input_queue.h
+// Version: 1.0
+//
+// Description: Lock-free single-producer / single-consumer queue of
+// timestamped key events. The GLFW key callback (main thread) pushes every
+// press and release as it arrives; the simulation thread drains the events
+// that fall inside each tick, so short taps between two frames are kept
+// and the paddle responds to when a key went down, not when a frame was
+// drawn.
+//
+// Data Structure:
+// - Fixed ring of QUEUE_SIZE events. head is only written by the consumer,
+//   tail only by the producer; each side reads the other's index with
+//   acquire ordering.
+// - The last RELEASE_RESERVE slots only take releases. A press is refused
+//   (and counted) once the ring is that full, so every key that went down
+//   has room for its release and a full queue can never leave a key stuck.
+//=============================================================================
+
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <atomic>
+
+struct KeyEvent {
+    double time; // glfwGetTime() when the callback ran
+    int key;     // GLFW_KEY_*
+    int action;  // GLFW_PRESS or GLFW_RELEASE
+};
+
+class KeyEventQueue
+{
+public:
+    static const unsigned QUEUE_SIZE = 256; // must be a power of two
+    static const unsigned RELEASE_RESERVE = 8; // at least the keys that can be down at once
+
+    KeyEventQueue() : head(0), tail(0), droppedPresses(0) {}
+
+    // Producer side. A press is dropped (returns false) when only the
+    // reserved slots are free; a release always fits.
+    bool Push(const KeyEvent& e, bool release)
+    {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        unsigned used = t - head.load(std::memory_order_acquire);
+        if (!release && used >= QUEUE_SIZE - RELEASE_RESERVE)
+        {
+            droppedPresses++;
+            return false;
+        }
+        if (used == QUEUE_SIZE)
+            return false; // only if more keys are held than the reserve covers
+        events[t & (QUEUE_SIZE - 1)] = e;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side. Presses refused because the queue was full.
+    unsigned DroppedPresses() const { return droppedPresses; }
+
+    // Consumer side. Look at the oldest event without removing it.
+    bool Peek(KeyEvent& e) const
+    {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        e = events[h & (QUEUE_SIZE - 1)];
+        return true;
+    }
+
+    // Consumer side. Remove the event returned by the last Peek().
+    void Pop()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+private:
+    KeyEvent events[QUEUE_SIZE];
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+    unsigned droppedPresses;
+};
+
+#endif
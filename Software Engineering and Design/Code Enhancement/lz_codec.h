@@ -0,0 +1,164 @@
+//=============================================================================
+// File Name: lz_codec.h
+// Version: 1.0
+//
+// Description: Small LZ77 byte compressor in the style of LZ4, used for
+// replay keyframes. It trades ratio for speed: one hash probe per
+// position, no entropy coding, and a decoder that is a loop of copies.
+// GameState images compress well because unused pool slots, free lists
+// and repeated brick layouts are long runs of similar bytes.
+//
+// Format: a sequence of
+//   token  u8  high nibble = literal count, low nibble = match length - 4
+//              (15 in either nibble means more length bytes follow:
+//              each adds 0..255, a byte below 255 ends the length)
+//   literal bytes
+//   offset u16 distance back to the match (little endian)
+// The last sequence has literals only and ends at the end of the input.
+//
+// Time Complexity: O(n) to compress and decompress.
+//=============================================================================
+
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <cstddef>
+#include <cstring>
+
+const int LZ_MIN_MATCH = 4;
+const int LZ_HASH_BITS = 12;
+const size_t LZ_MAX_OFFSET = 65535;
+
+// Worst case output size for size input bytes
+inline size_t LzBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+inline unsigned LzHash(const unsigned char* p)
+{
+    unsigned v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+inline unsigned char* LzPutLength(unsigned char* out, size_t length)
+{
+    while (length >= 255)
+    {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// Compress size bytes from in into out, which needs LzBound(size) bytes.
+// Returns the compressed size.
+inline size_t LzCompress(const unsigned char* in, size_t size, unsigned char* out)
+{
+    const unsigned EMPTY = 0xFFFFFFFF;
+    unsigned table[1 << LZ_HASH_BITS]; // newest position with each hash
+    for (int i = 0; i < (1 << LZ_HASH_BITS); i++)
+        table[i] = EMPTY;
+
+    unsigned char* op = out;
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (i + LZ_MIN_MATCH <= size)
+    {
+        unsigned h = LzHash(in + i);
+        size_t candidate = table[h];
+        table[h] = (unsigned)i;
+        if (candidate == EMPTY || i - candidate > LZ_MAX_OFFSET || memcmp(in + candidate, in + i, LZ_MIN_MATCH) != 0)
+        {
+            i++;
+            continue;
+        }
+
+        size_t match = LZ_MIN_MATCH;
+        while (i + match < size && in[candidate + match] == in[i + match])
+            match++;
+
+        size_t literals = i - literalStart;
+        size_t extra = match - LZ_MIN_MATCH;
+        unsigned char* token = op++;
+        *token = (unsigned char)(((literals < 15 ? literals : 15) << 4) | (extra < 15 ? extra : 15));
+        if (literals >= 15)
+            op = LzPutLength(op, literals - 15);
+        memcpy(op, in + literalStart, literals);
+        op += literals;
+        size_t offset = i - candidate;
+        *op++ = (unsigned char)offset;
+        *op++ = (unsigned char)(offset >> 8);
+        if (extra >= 15)
+            op = LzPutLength(op, extra - 15);
+
+        i += match;
+        literalStart = i;
+    }
+
+    size_t literals = size - literalStart;
+    *op++ = (unsigned char)((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15)
+        op = LzPutLength(op, literals - 15);
+    memcpy(op, in + literalStart, literals);
+    op += literals;
+    return op - out;
+}
+
+inline bool LzGetLength(const unsigned char*& ip, const unsigned char* end, size_t& length)
+{
+    unsigned char byte;
+    do
+    {
+        if (ip == end)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Decompress into out, which holds capacity bytes. Returns the decoded
+// size, or -1 if the input is malformed or would overflow out.
+inline long long LzDecompress(const unsigned char* in, size_t size, unsigned char* out, size_t capacity)
+{
+    const unsigned char* ip = in;
+    const unsigned char* end = in + size;
+    size_t o = 0;
+    while (ip < end)
+    {
+        unsigned char token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !LzGetLength(ip, end, literals))
+            return -1;
+        if ((size_t)(end - ip) < literals || capacity - o < literals)
+            return -1;
+        memcpy(out + o, ip, literals);
+        ip += literals;
+        o += literals;
+        if (ip == end)
+            break; // the last sequence has no match
+
+        if (end - ip < 2)
+            return -1;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t match = (token & 0x0F);
+        if (match == 15 && !LzGetLength(ip, end, match))
+            return -1;
+        match += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || capacity - o < match)
+            return -1;
+
+        // Byte by byte: a match may overlap the bytes it produces
+        const unsigned char* from = out + o - offset;
+        for (size_t k = 0; k < match; k++)
+            out[o + k] = from[k];
+        o += match;
+    }
+    return (long long)o;
+}
+
+#endif
@@ -0,0 +1,280 @@
+//=============================================================================
+// File Name: memory_pool.h
+// Version: 1.0
+//
+// Description: Allocation-free storage for the brick game simulation.
+// - EntityPool: fixed-capacity container for one entity type (Circle,
+//   Brick, ...). Live entities are packed at the front for fast iteration;
+//   each also has a stable handle that stays valid until the entity is
+//   removed, however the packed array is reordered.
+// - FrameArena: linear allocator for data that only lives for one tick.
+//   Reset() frees everything at once.
+// - ThreadAllocationCount(): number of heap allocations made by the calling
+//   thread. Only a program that replaces the global operator new to
+//   increment it counts anything; Enhanced_brickgame.cpp does, other
+//   includers (the Python binding) always read 0. The game compares it
+//   before and after each tick to show that the steady-state loop never
+//   touches the heap.
+//
+// Data Structures:
+// - EntityPool keeps a permutation of its slots: denseToSlot[0, count) are
+//   the live entities in iteration order, the rest are free. slotToDense
+//   is the inverse and generation[slot] is bumped whenever a slot is freed,
+//   so a handle to a removed entity no longer resolves.
+// - Storage is raw bytes sized for CAPACITY entities, so the pool, and a
+//   GameState made of pools, copies with a single memcpy and never
+//   allocates.
+//=============================================================================
+
+#ifndef MEMORY_POOL_H
+#define MEMORY_POOL_H
+
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Heap allocations made by the calling thread so far
+inline unsigned long long& ThreadAllocationCount()
+{
+    static thread_local unsigned long long count = 0;
+    return count;
+}
+
+// Bump allocator for one tick's scratch data. Memory is handed out in
+// order and released all at once by Reset(). If a tick needs more than the
+// current block, extra blocks are allocated for that tick and the next
+// Reset() replaces everything with one block big enough for the peak, so
+// after warm-up the arena never allocates again.
+class FrameArena
+{
+public:
+    explicit FrameArena(size_t capacity) : block(new unsigned char[capacity]), capacity(capacity), used(0), peak(0) {}
+    ~FrameArena()
+    {
+        delete[] block;
+        ReleaseOverflow();
+    }
+
+    // Uninitialized space for count objects of type T
+    template <typename T>
+    T* Alloc(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is never destructed");
+        size_t bytes = count * sizeof(T);
+        size_t start = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (start + bytes <= capacity)
+        {
+            used = start + bytes;
+            if (used > peak)
+                peak = used;
+            return reinterpret_cast<T*>(block + start);
+        }
+
+        unsigned char* extra = new unsigned char[bytes + alignof(T)];
+        overflow.push_back(extra);
+        peak += bytes + alignof(T);
+        size_t misalign = (size_t)extra & (alignof(T) - 1);
+        return reinterpret_cast<T*>(extra + (misalign ? alignof(T) - misalign : 0));
+    }
+
+    // Release everything allocated since the last Reset()
+    void Reset()
+    {
+        if (!overflow.empty())
+        {
+            ReleaseOverflow();
+            delete[] block;
+            capacity = peak;
+            block = new unsigned char[capacity];
+        }
+        used = 0;
+    }
+
+    size_t Capacity() const { return capacity; }
+    size_t Peak() const { return peak; }
+
+private:
+    unsigned char* block;
+    size_t capacity;
+    size_t used;
+    size_t peak;   // most bytes one tick has needed
+    std::vector<unsigned char*> overflow;
+
+    void ReleaseOverflow()
+    {
+        for (size_t i = 0; i < overflow.size(); i++)
+            delete[] overflow[i];
+        overflow.clear();
+    }
+
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+};
+
+// How RemoveDead closes the gaps left by removed entities
+enum REMOVALPOLICY {
+    STABLE_REMOVAL,   // survivors keep their order; one pass from the first removal
+    UNSTABLE_REMOVAL  // each gap is filled from the back; cost depends only on removals
+};
+
+// Stable reference to a pooled entity. generation 0 is never issued.
+struct PoolHandle {
+    unsigned short slot;
+    unsigned short generation;
+};
+
+const PoolHandle INVALID_HANDLE = { 0, 0 };
+
+template <typename T, int CAPACITY>
+class EntityPool
+{
+    static_assert(std::is_trivially_copyable<T>::value, "pooled entities are copied with memcpy");
+    static_assert(CAPACITY <= 65536, "slots are 16 bit");
+
+public:
+    EntityPool() : count(0)
+    {
+        for (int i = 0; i < CAPACITY; i++)
+        {
+            denseToSlot[i] = (unsigned short)i;
+            slotToDense[i] = (unsigned short)i;
+            generation[i] = 1;
+        }
+    }
+
+    // Copy an entity into the pool. Returns INVALID_HANDLE when it is full.
+    PoolHandle Add(const T& item)
+    {
+        if (count == CAPACITY)
+            return INVALID_HANDLE;
+        unsigned short slot = denseToSlot[count];
+        slotToDense[slot] = (unsigned short)count;
+        new (&data()[count]) T(item);
+        count++;
+        PoolHandle handle = { slot, generation[slot] };
+        return handle;
+    }
+
+    // The entity a handle refers to, or nullptr if it has been removed
+    T* Get(PoolHandle handle)
+    {
+        if (handle.generation == 0 || handle.generation != generation[handle.slot])
+            return nullptr;
+        return &data()[slotToDense[handle.slot]];
+    }
+
+    PoolHandle HandleAt(int index) const
+    {
+        unsigned short slot = denseToSlot[index];
+        PoolHandle handle = { slot, generation[slot] };
+        return handle;
+    }
+
+    // Remove the entities at the packed indices deadIndices (ascending, no
+    // duplicates) in one pass. Freed slots go to the free end of the
+    // permutation and their handles are invalidated. The stable policy
+    // takes deadCount slot numbers from scratch.
+    void RemoveDead(const int* deadIndices, int deadCount, REMOVALPOLICY policy, FrameArena& scratch)
+    {
+        if (deadCount == 0)
+            return;
+
+        T* items = data();
+        for (int d = 0; d < deadCount; d++)
+            Free(denseToSlot[deadIndices[d]]);
+
+        if (policy == UNSTABLE_REMOVAL)
+        {
+            // Walking the removals from the back guarantees the last entity
+            // is either alive or the one being removed.
+            for (int d = deadCount; d-- > 0;)
+            {
+                int last = count - 1;
+                SwapDense(deadIndices[d], last);
+                items[deadIndices[d]] = items[last];
+                count--;
+            }
+            return;
+        }
+
+        int write = deadIndices[0];
+        int next = 0;
+        unsigned short* freed = scratch.Alloc<unsigned short>(deadCount);
+        for (int read = write; read < count; read++)
+        {
+            if (next < deadCount && deadIndices[next] == read)
+            {
+                freed[next++] = denseToSlot[read];
+                continue;
+            }
+            items[write] = items[read];
+            denseToSlot[write] = denseToSlot[read];
+            slotToDense[denseToSlot[write]] = (unsigned short)write;
+            write++;
+        }
+        for (int d = 0; d < deadCount; d++)
+        {
+            denseToSlot[write + d] = freed[d];
+            slotToDense[freed[d]] = (unsigned short)(write + d);
+        }
+        count = write;
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < count; i++)
+            Free(denseToSlot[i]);
+        count = 0;
+    }
+
+    T& operator[](int index) { return data()[index]; }
+    const T& operator[](int index) const { return data()[index]; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == CAPACITY; }
+
+    // Whether the bookkeeping is consistent: count in range, denseToSlot a
+    // permutation with slotToDense as its inverse, no zero generation. For
+    // pools restored from bytes that came from outside the program.
+    bool Valid() const
+    {
+        if (count < 0 || count > CAPACITY)
+            return false;
+        for (int i = 0; i < CAPACITY; i++)
+        {
+            if (denseToSlot[i] >= CAPACITY || slotToDense[denseToSlot[i]] != i || generation[i] == 0)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[CAPACITY];
+    int count;
+    unsigned short denseToSlot[CAPACITY];
+    unsigned short slotToDense[CAPACITY];
+    unsigned short generation[CAPACITY];
+
+    T* data() { return reinterpret_cast<T*>(storage); }
+    const T* data() const { return reinterpret_cast<const T*>(storage); }
+
+    void Free(unsigned short slot)
+    {
+        if (++generation[slot] == 0)
+            generation[slot] = 1;
+    }
+
+    void SwapDense(int a, int b)
+    {
+        unsigned short slotA = denseToSlot[a];
+        unsigned short slotB = denseToSlot[b];
+        denseToSlot[a] = slotB;
+        denseToSlot[b] = slotA;
+        slotToDense[slotB] = (unsigned short)a;
+        slotToDense[slotA] = (unsigned short)b;
+    }
+};
+
+#endif
@@ -0,0 +1,742 @@
+//=============================================================================
+// File Name: net_game.h
+// Version: 1.0
+//
+// Description: Authoritative multiplayer for the brick game. NetServer runs
+// headless, simulating matches of up to MAX_PLAYERS paddles with StepGame;
+// NetClient only sends its keys and rebuilds the server's state for drawing.
+//
+// Snapshots:
+// - QuantizeState packs a GameState into a fixed QSTATE_BYTES layout:
+//   positions as 16-bit fixed point over [-2, 2], colors as 8 bits.
+// - Each snapshot is sent as a delta against the newest snapshot the client
+//   has acknowledged: the XOR of the two buffers, run-length encoded over
+//   runs of zeros. Bricks and paddles that did not change cost nothing.
+//   With no usable baseline (first packet, or the ack is older than the
+//   server's history) the baseline is all zeros, which is a full snapshot.
+// - The client keeps a ring of decoded snapshots to find the baseline a
+//   delta was made against; if it no longer has it the packet is dropped
+//   and its ack stays put, so the server falls back to a full snapshot.
+//
+// Protocol (UDP, little endian, every packet starts with u32 NET_PROTOCOL_ID
+// and a u8 type):
+// - CONNECT  client -> server: u32 nonce. Repeated until accepted.
+// - ACCEPT   server -> client: u32 nonce, u8 match, u8 player.
+// - INPUT    client -> server: u32 nonce, u32 sequence, u32 ack frame,
+//            u8 keys held (left, right, launch bits). Sent every frame;
+//            it carries state rather than events, so losing one is harmless.
+// - SNAPSHOT server -> client: u32 frame, u32 baseline frame (0 = zeros),
+//            then the encoded delta.
+// - DISCONNECT server -> client: u32 nonce. Sent when the server drops a
+//            silent client and in answer to input from a client it does
+//            not know. The client also gives up on a server it has not
+//            heard from for CLIENT_TIMEOUT; either way it connects again.
+// Snapshots are numbered by a per-match frame counter rather than the game
+// tick: the tick starts over when a match restarts, the frame never does,
+// so an acknowledged frame always names exactly one snapshot.
+//
+// Paddles keep a fixed spawn slot: player p starts in the pth of
+// MAX_PLAYERS columns whatever the match size, so a player joining a
+// running match never spawns on top of another paddle's start.
+//=============================================================================
+
+#ifndef NET_GAME_H
+#define NET_GAME_H
+
+#include "net_transport.h"
+#include "brick_game.h"
+#include <cstring>
+#include <vector>
+
+const unsigned NET_PROTOCOL_ID = 0x4E4B5242; // "BRKN"
+enum NETPACKET { PACKET_CONNECT = 1, PACKET_ACCEPT, PACKET_INPUT, PACKET_SNAPSHOT, PACKET_DISCONNECT };
+enum NETKEYS { NETKEY_LEFT = 1, NETKEY_RIGHT = 2, NETKEY_LAUNCH = 4 };
+
+const int NET_MAX_PACKET = 4096;
+const int SNAPSHOT_HISTORY = 32; // snapshots kept for baselines (about half a second)
+const double CLIENT_TIMEOUT = 5.0; // seconds of silence before either side gives up
+
+// Quantized layout
+const int QSTATE_HEADER = 12;
+const int QSTATE_PADDLE = 12;
+const int QSTATE_BRICK = 12;
+const int QSTATE_BALL = 10;
+const int QSTATE_BYTES = QSTATE_HEADER + MAX_PLAYERS * QSTATE_PADDLE + MAX_BRICKS * QSTATE_BRICK + MAX_BALLS * QSTATE_BALL;
+
+inline void NetPut16(unsigned char* p, unsigned v) { p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); }
+inline void NetPut32(unsigned char* p, unsigned v) { NetPut16(p, v & 0xFFFF); NetPut16(p + 2, v >> 16); }
+inline unsigned NetGet16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+inline unsigned NetGet32(const unsigned char* p) { return NetGet16(p) | (NetGet16(p + 2) << 16); }
+
+inline unsigned QuantizePosition(float v)
+{
+    float q = (v + 2.0f) * (65535.0f / 4.0f) + 0.5f;
+    return q < 0.0f ? 0 : (q > 65535.0f ? 65535 : (unsigned)q);
+}
+inline float DequantizePosition(unsigned q) { return q * (4.0f / 65535.0f) - 2.0f; }
+
+inline unsigned char QuantizeColor(float v)
+{
+    float q = v * 255.0f + 0.5f;
+    return q < 0.0f ? 0 : (q > 255.0f ? 255 : (unsigned char)q);
+}
+
+// Pack the drawable part of a game into QSTATE_BYTES bytes. Unused slots
+// are zero so they never show up in a delta.
+inline void QuantizeState(const GameState& state, unsigned char* out)
+{
+    memset(out, 0, QSTATE_BYTES);
+    NetPut32(out, state.tick);
+    out[4] = (unsigned char)(state.lives < 0 ? 0 : (state.lives > 255 ? 255 : state.lives));
+    out[5] = state.gameOver ? 1 : 0;
+    out[6] = (unsigned char)state.playerCount;
+    out[7] = (unsigned char)state.world.size();
+    out[8] = (unsigned char)state.bricks.size();
+
+    unsigned char* p = out + QSTATE_HEADER;
+    for (int i = 0; i < MAX_PLAYERS; i++, p += QSTATE_PADDLE)
+    {
+        if (i >= state.playerCount)
+            continue;
+        const Paddle& paddle = state.paddles[i];
+        NetPut16(p, QuantizePosition(paddle.x));
+        NetPut16(p + 2, QuantizePosition(paddle.y));
+        NetPut16(p + 4, QuantizePosition(paddle.width));
+        NetPut16(p + 6, QuantizePosition(paddle.height));
+        p[8] = QuantizeColor(paddle.red);
+        p[9] = QuantizeColor(paddle.green);
+        p[10] = QuantizeColor(paddle.blue);
+    }
+    for (int i = 0; i < MAX_BRICKS; i++, p += QSTATE_BRICK)
+    {
+        if (i >= state.bricks.size())
+            continue;
+        const Brick& brick = state.bricks[i];
+        NetPut16(p, QuantizePosition(brick.x));
+        NetPut16(p + 2, QuantizePosition(brick.y));
+        NetPut16(p + 4, QuantizePosition(brick.width));
+        p[6] = QuantizeColor(brick.red);
+        p[7] = QuantizeColor(brick.green);
+        p[8] = QuantizeColor(brick.blue);
+        p[9] = brick.onoff == ON ? 1 : 0;
+        p[10] = (unsigned char)brick.brick_type;
+    }
+    for (int i = 0; i < MAX_BALLS; i++, p += QSTATE_BALL)
+    {
+        if (i >= state.world.size())
+            continue;
+        const Circle& ball = state.world[i];
+        NetPut16(p, QuantizePosition(ball.x));
+        NetPut16(p + 2, QuantizePosition(ball.y));
+        p[4] = QuantizeColor(ball.radius); // radius in 1/255 units
+        p[5] = (unsigned char)ball.direction;
+        p[6] = QuantizeColor(ball.red);
+        p[7] = QuantizeColor(ball.green);
+        p[8] = QuantizeColor(ball.blue);
+    }
+}
+
+// Rebuild a drawable GameState from a quantized snapshot. Only what the
+// renderer needs is restored; the result is not meant to be simulated.
+inline void DequantizeState(const unsigned char* in, GameState& state)
+{
+    state = GameState();
+    state.tick = NetGet32(in);
+    state.lives = in[4];
+    state.gameOver = in[5] != 0;
+    state.playerCount = in[6] < 1 ? 1 : (in[6] > MAX_PLAYERS ? MAX_PLAYERS : in[6]);
+    int balls = in[7] > MAX_BALLS ? MAX_BALLS : in[7];
+    int bricks = in[8] > MAX_BRICKS ? MAX_BRICKS : in[8];
+
+    const unsigned char* p = in + QSTATE_HEADER;
+    for (int i = 0; i < MAX_PLAYERS; i++, p += QSTATE_PADDLE)
+    {
+        if (i < state.playerCount)
+            state.paddles[i] = Paddle(DequantizePosition(NetGet16(p)), DequantizePosition(NetGet16(p + 2)),
+                                      DequantizePosition(NetGet16(p + 4)), DequantizePosition(NetGet16(p + 6)),
+                                      p[8] / 255.0f, p[9] / 255.0f, p[10] / 255.0f);
+    }
+    for (int i = 0; i < MAX_BRICKS; i++, p += QSTATE_BRICK)
+    {
+        if (i >= bricks)
+            continue;
+        Brick brick(p[10] == REFLECTIVE ? REFLECTIVE : DESTRUCTABLE, DequantizePosition(NetGet16(p)),
+                    DequantizePosition(NetGet16(p + 2)), DequantizePosition(NetGet16(p + 4)),
+                    p[6] / 255.0f, p[7] / 255.0f, p[8] / 255.0f);
+        brick.onoff = p[9] ? ON : OFF;
+        state.bricks.Add(brick);
+    }
+    for (int i = 0; i < MAX_BALLS; i++, p += QSTATE_BALL)
+    {
+        if (i >= balls)
+            continue;
+        float radius = p[4] / 255.0f;
+        state.world.Add(Circle(DequantizePosition(NetGet16(p)), DequantizePosition(NetGet16(p + 2)), radius,
+                               p[5], radius, p[6] / 255.0f, p[7] / 255.0f, p[8] / 255.0f));
+    }
+}
+
+inline int NetPutVarint(unsigned char* out, unsigned v)
+{
+    int n = 0;
+    while (v >= 0x80)
+    {
+        out[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (unsigned char)v;
+    return n;
+}
+
+inline bool NetGetVarint(const unsigned char*& p, const unsigned char* end, unsigned& v)
+{
+    v = 0;
+    for (int shift = 0; p < end && shift < 32; shift += 7)
+    {
+        unsigned char byte = *p++;
+        v |= (unsigned)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Encode current against base as (zero run, literal count, literal XOR
+// bytes) tokens. A literal run ends at the next three unchanged bytes.
+// Returns the encoded size; out needs QSTATE_BYTES + QSTATE_BYTES / 64 + 16.
+inline int EncodeDelta(const unsigned char* base, const unsigned char* current, unsigned char* out)
+{
+    int size = 0;
+    int i = 0;
+    while (i < QSTATE_BYTES)
+    {
+        int zeros = 0;
+        while (i + zeros < QSTATE_BYTES && base[i + zeros] == current[i + zeros])
+            zeros++;
+        i += zeros;
+        if (i == QSTATE_BYTES)
+            break;
+
+        int literal = 0;
+        while (i + literal < QSTATE_BYTES)
+        {
+            int same = 0;
+            while (same < 3 && i + literal + same < QSTATE_BYTES && base[i + literal + same] == current[i + literal + same])
+                same++;
+            if (same == 3 || i + literal + same == QSTATE_BYTES)
+                break;
+            literal += same + 1;
+        }
+
+        size += NetPutVarint(out + size, zeros);
+        size += NetPutVarint(out + size, literal);
+        for (int k = 0; k < literal; k++)
+            out[size++] = base[i + k] ^ current[i + k];
+        i += literal;
+    }
+    return size;
+}
+
+// Apply an encoded delta to base. Returns false on malformed input.
+inline bool DecodeDelta(const unsigned char* base, const unsigned char* data, int size, unsigned char* out)
+{
+    memcpy(out, base, QSTATE_BYTES);
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    unsigned i = 0;
+    while (p < end)
+    {
+        unsigned zeros, literal;
+        if (!NetGetVarint(p, end, zeros) || !NetGetVarint(p, end, literal))
+            return false;
+        i += zeros;
+        if (i + literal > (unsigned)QSTATE_BYTES || (size_t)(end - p) < literal)
+            return false;
+        for (unsigned k = 0; k < literal; k++)
+            out[i + k] ^= *p++;
+        i += literal;
+    }
+    return true;
+}
+
+inline int NetPacketHeader(unsigned char* out, NETPACKET type)
+{
+    NetPut32(out, NET_PROTOCOL_ID);
+    out[4] = (unsigned char)type;
+    return 5;
+}
+
+struct NetServerStats {
+    unsigned long long ticks;
+    unsigned long long fullSnapshots;
+    unsigned long long deltaSnapshots;
+    unsigned long long snapshotBytes;
+    unsigned long long fullBytes;   // of snapshotBytes, in full snapshots
+};
+
+class NetServer
+{
+public:
+    NetServer() : now(0.0), seed(1) { memset(&stats, 0, sizeof(stats)); }
+    ~NetServer()
+    {
+        for (size_t m = 0; m < matches.size(); m++)
+            delete matches[m];
+    }
+
+    bool Start(unsigned short port, const LinkSettings& link)
+    {
+        conditioner.Configure(link, 0xC0FFEE);
+        return socket.Open(port);
+    }
+
+    // Receive client packets, advance every match one tick and send each
+    // client its snapshot. now is the server clock in seconds.
+    void Tick(double time)
+    {
+        now = time;
+        conditioner.Pump(socket, now);
+        ReceivePackets();
+        DropSilentClients();
+
+        for (size_t m = 0; m < matches.size(); m++)
+        {
+            Match& match = *matches[m];
+            if (match.players == 0)
+                continue;
+
+            TickInput input;
+            for (size_t c = 0; c < clients.size(); c++)
+            {
+                if (clients[c].match == (int)m)
+                    AddClientInput(clients[c], match.state, input);
+            }
+            StepGame(match.state, input, scratch);
+            if (match.state.gameOver)
+                RestartMatch(match);
+
+            unsigned frame = ++match.frame;
+            int slot = frame % SNAPSHOT_HISTORY;
+            QuantizeState(match.state, match.history[slot]);
+            match.historyFrame[slot] = frame;
+        }
+
+        for (size_t c = 0; c < clients.size(); c++)
+            SendSnapshot(clients[c]);
+        stats.ticks++;
+    }
+
+    unsigned short Port() const { return socket.LocalPort(); }
+    int ClientCount() const { return (int)clients.size(); }
+    const NetServerStats& Stats() const { return stats; }
+    const LinkConditioner& Link() const { return conditioner; }
+
+    // The snapshot a match sent as frame, or nullptr if it is out of history
+    const unsigned char* SnapshotAt(int match, unsigned frame) const
+    {
+        if (match < 0 || match >= (int)matches.size())
+            return nullptr;
+        const Match& m = *matches[match];
+        int slot = frame % SNAPSHOT_HISTORY;
+        return frame != 0 && m.historyFrame[slot] == frame ? m.history[slot] : nullptr;
+    }
+
+private:
+    struct Client {
+        NetAddress address;
+        unsigned nonce;
+        int match;
+        int player;
+        unsigned sequence;   // newest input sequence seen
+        unsigned ackFrame;   // newest snapshot the client has
+        unsigned char keys;  // NETKEYS held
+        bool launchHeld;     // launch was held last tick (launch is a tap)
+        double lastHeard;
+    };
+
+    struct Match {
+        GameState state;
+        int players;
+        bool playerUsed[MAX_PLAYERS];
+        unsigned frame; // snapshots taken so far
+        unsigned char history[SNAPSHOT_HISTORY][QSTATE_BYTES];
+        unsigned historyFrame[SNAPSHOT_HISTORY];
+    };
+
+    UdpSocket socket;
+    LinkConditioner conditioner;
+    FrameArena scratch{ TICK_SCRATCH_BYTES };
+    std::vector<Client> clients;
+    std::vector<Match*> matches;
+    double now;
+    unsigned seed;
+    NetServerStats stats;
+    unsigned char packet[NET_MAX_PACKET];
+
+    void ReceivePackets()
+    {
+        NetAddress from;
+        int size;
+        while ((size = socket.Receive(from, packet, sizeof(packet))) >= 0)
+        {
+            if (size < 9 || NetGet32(packet) != NET_PROTOCOL_ID)
+                continue;
+            unsigned nonce = NetGet32(packet + 5);
+            Client* client = FindClient(from, nonce);
+
+            if (packet[4] == PACKET_CONNECT)
+            {
+                if (!client)
+                    client = AddClient(from, nonce);
+                if (client)
+                    SendAccept(*client);
+            }
+            else if (packet[4] == PACKET_INPUT && client && size >= 18)
+            {
+                unsigned sequence = NetGet32(packet + 9);
+                if (sequence <= client->sequence)
+                    continue; // late or duplicated
+                client->sequence = sequence;
+                unsigned ack = NetGet32(packet + 13);
+                if (ack > client->ackFrame)
+                    client->ackFrame = ack;
+                client->keys = packet[17];
+                client->lastHeard = now;
+            }
+            else if (packet[4] == PACKET_INPUT && !client)
+            {
+                SendDisconnect(from, nonce);
+            }
+        }
+    }
+
+    Client* FindClient(const NetAddress& address, unsigned nonce)
+    {
+        for (size_t c = 0; c < clients.size(); c++)
+        {
+            if (clients[c].address == address && clients[c].nonce == nonce)
+                return &clients[c];
+        }
+        return nullptr;
+    }
+
+    // Put a new client in the first match with a free paddle. An empty
+    // match starts a new game; otherwise the paddle joins the running one.
+    Client* AddClient(const NetAddress& address, unsigned nonce)
+    {
+        int m = 0;
+        while (m < (int)matches.size() && matches[m]->players == MAX_PLAYERS)
+            m++;
+        if (m == (int)matches.size())
+        {
+            Match* match = new Match();
+            match->players = 0;
+            match->frame = 0;
+            memset(match->playerUsed, 0, sizeof(match->playerUsed));
+            memset(match->historyFrame, 0, sizeof(match->historyFrame));
+            matches.push_back(match);
+        }
+
+        Match& match = *matches[m];
+        int player = 0;
+        while (match.playerUsed[player])
+            player++;
+        match.playerUsed[player] = true;
+        bool empty = match.players == 0;
+        match.players = std::max(match.players, player + 1);
+        if (empty)
+        {
+            RestartMatch(match);
+        }
+        else
+        {
+            GameState& state = match.state;
+            state.playerCount = match.players;
+            state.paddles[player] = StartingPaddle(player, MAX_PLAYERS);
+            for (int k = 0; k < GAMEKEY_COUNT; k++)
+                state.keyDown[player][k] = false;
+        }
+
+        Client client = { address, nonce, m, player, 0, 0, 0, false, now };
+        clients.push_back(client);
+        return &clients.back();
+    }
+
+    void DropSilentClients()
+    {
+        size_t kept = 0;
+        for (size_t c = 0; c < clients.size(); c++)
+        {
+            if (now - clients[c].lastHeard < CLIENT_TIMEOUT)
+            {
+                clients[kept++] = clients[c];
+                continue;
+            }
+            SendDisconnect(clients[c].address, clients[c].nonce);
+            Match& match = *matches[clients[c].match];
+            match.playerUsed[clients[c].player] = false;
+            while (match.players > 0 && !match.playerUsed[match.players - 1])
+                match.players--;
+            if (match.players > 0)
+            {
+                match.state.playerCount = match.players;
+                if (clients[c].player < match.players)
+                    ParkPaddle(match.state, clients[c].player);
+            }
+        }
+        clients.resize(kept);
+    }
+
+    // New game for the match's players, each paddle in its fixed spawn
+    // slot. Free paddles below the last used one are parked.
+    void RestartMatch(Match& match)
+    {
+        ResetGame(match.state, seed++, match.players);
+        for (int p = 0; p < match.players; p++)
+        {
+            if (match.playerUsed[p])
+                match.state.paddles[p] = StartingPaddle(p, MAX_PLAYERS);
+            else
+                ParkPaddle(match.state, p);
+        }
+    }
+
+    // StepGame moves and collides every paddle below playerCount. A free
+    // one among them is moved below the floor, where balls have already
+    // left play, and its keys are released.
+    static void ParkPaddle(GameState& state, int player)
+    {
+        state.paddles[player].x = state.paddles[player].prevX = 0.0f;
+        state.paddles[player].y = -2.0f;
+        for (int k = 0; k < GAMEKEY_COUNT; k++)
+            state.keyDown[player][k] = false;
+    }
+
+    // Turn the keys a client holds into this tick's events for its paddle
+    void AddClientInput(Client& client, const GameState& state, TickInput& input)
+    {
+        bool left = (client.keys & NETKEY_LEFT) != 0;
+        bool right = (client.keys & NETKEY_RIGHT) != 0;
+        bool launch = (client.keys & NETKEY_LAUNCH) != 0;
+        if (state.keyDown[client.player][KEY_LEFT] != left)
+            input.Add(0.0f, KEY_LEFT, left, client.player);
+        if (state.keyDown[client.player][KEY_RIGHT] != right)
+            input.Add(0.0f, KEY_RIGHT, right, client.player);
+        if (launch && !client.launchHeld)
+        {
+            input.Add(0.0f, KEY_LAUNCH, true, client.player);
+            input.Add(0.0f, KEY_LAUNCH, false, client.player);
+        }
+        client.launchHeld = launch;
+    }
+
+    void SendAccept(const Client& client)
+    {
+        int size = NetPacketHeader(packet, PACKET_ACCEPT);
+        NetPut32(packet + size, client.nonce);
+        packet[size + 4] = (unsigned char)client.match;
+        packet[size + 5] = (unsigned char)client.player;
+        conditioner.Send(socket, client.address, packet, size + 6, now);
+    }
+
+    void SendDisconnect(const NetAddress& address, unsigned nonce)
+    {
+        int size = NetPacketHeader(packet, PACKET_DISCONNECT);
+        NetPut32(packet + size, nonce);
+        conditioner.Send(socket, address, packet, size + 4, now);
+    }
+
+    void SendSnapshot(const Client& client)
+    {
+        static const unsigned char zeros[QSTATE_BYTES] = {};
+
+        unsigned frame = matches[client.match]->frame;
+        const unsigned char* current = SnapshotAt(client.match, frame);
+        if (!current)
+            return;
+
+        unsigned baseFrame = client.ackFrame < frame ? client.ackFrame : 0;
+        const unsigned char* base = SnapshotAt(client.match, baseFrame);
+        if (!base)
+        {
+            base = zeros;
+            baseFrame = 0;
+        }
+
+        int size = NetPacketHeader(packet, PACKET_SNAPSHOT);
+        NetPut32(packet + size, frame);
+        NetPut32(packet + size + 4, baseFrame);
+        size += 8;
+        size += EncodeDelta(base, current, packet + size);
+        conditioner.Send(socket, client.address, packet, size, now);
+
+        stats.snapshotBytes += size;
+        if (baseFrame == 0)
+        {
+            stats.fullSnapshots++;
+            stats.fullBytes += size;
+        }
+        else
+            stats.deltaSnapshots++;
+    }
+};
+
+struct NetClientStats {
+    unsigned long long snapshots;   // applied
+    unsigned long long stale;       // older than what we had
+    unsigned long long noBaseline;  // baseline no longer in the ring
+    unsigned long long bytes;
+    unsigned long long disconnects; // times the server dropped us or went quiet
+};
+
+class NetClient
+{
+public:
+    NetClient()
+        : accepted(false), match(-1), player(-1), keys(0), sequence(0), latestFrame(0), lastConnect(-1.0), lastHeard(0.0)
+    {
+        memset(&stats, 0, sizeof(stats));
+        memset(ringFrame, 0, sizeof(ringFrame));
+    }
+
+    bool Connect(const NetAddress& serverAddress, const LinkSettings& link, unsigned clientNonce)
+    {
+        server = serverAddress;
+        nonce = clientNonce;
+        conditioner.Configure(link, clientNonce);
+        return socket.Open(0);
+    }
+
+    void SetKeys(bool left, bool right, bool launch)
+    {
+        keys = (left ? NETKEY_LEFT : 0) | (right ? NETKEY_RIGHT : 0) | (launch ? NETKEY_LAUNCH : 0);
+    }
+
+    // Send this frame's input (or a connect request) and apply every
+    // snapshot that has arrived. now is the client clock in seconds.
+    void Update(double now)
+    {
+        conditioner.Pump(socket, now);
+
+        int size;
+        if (!accepted)
+        {
+            if (now - lastConnect >= 0.25)
+            {
+                size = NetPacketHeader(packet, PACKET_CONNECT);
+                NetPut32(packet + size, nonce);
+                conditioner.Send(socket, server, packet, size + 4, now);
+                lastConnect = now;
+            }
+        }
+        else
+        {
+            size = NetPacketHeader(packet, PACKET_INPUT);
+            NetPut32(packet + size, nonce);
+            NetPut32(packet + size + 4, ++sequence);
+            NetPut32(packet + size + 8, latestFrame);
+            packet[size + 12] = keys;
+            conditioner.Send(socket, server, packet, size + 13, now);
+        }
+
+        NetAddress from;
+        while ((size = socket.Receive(from, packet, sizeof(packet))) >= 0)
+        {
+            if (!(from == server) || size < 5 || NetGet32(packet) != NET_PROTOCOL_ID)
+                continue;
+            stats.bytes += size;
+            if (packet[4] == PACKET_ACCEPT && size >= 11 && NetGet32(packet + 5) == nonce)
+            {
+                if (!accepted)
+                    lastHeard = now;
+                accepted = true;
+                match = packet[9];
+                player = packet[10];
+            }
+            else if (packet[4] == PACKET_SNAPSHOT && size >= 13 && accepted)
+            {
+                lastHeard = now;
+                ApplySnapshot(NetGet32(packet + 5), NetGet32(packet + 9), packet + 13, size - 13);
+            }
+            else if (packet[4] == PACKET_DISCONNECT && size >= 9 && NetGet32(packet + 5) == nonce && accepted)
+            {
+                Disconnect();
+            }
+        }
+        if (accepted && now - lastHeard >= CLIENT_TIMEOUT)
+            Disconnect();
+    }
+
+    bool HasState() const { return latestFrame != 0; }
+    unsigned LatestFrame() const { return latestFrame; }
+    const unsigned char* LatestSnapshot() const { return ring[latestFrame % SNAPSHOT_HISTORY]; }
+    int Match() const { return match; }
+    int Player() const { return player; }
+    bool Connected() const { return accepted; }
+    const NetClientStats& Stats() const { return stats; }
+
+private:
+    UdpSocket socket;
+    LinkConditioner conditioner;
+    NetAddress server;
+    unsigned nonce;
+    bool accepted;
+    int match;
+    int player;
+    unsigned char keys;
+    unsigned sequence;
+    unsigned latestFrame;
+    double lastConnect;
+    double lastHeard;    // last packet from the server while connected
+    NetClientStats stats;
+    unsigned char ring[SNAPSHOT_HISTORY][QSTATE_BYTES];
+    unsigned ringFrame[SNAPSHOT_HISTORY];
+    unsigned char packet[NET_MAX_PACKET];
+
+    // Forget the match and go back to sending CONNECT. The server starts a
+    // reconnected client from a full snapshot, so the ring is cleared too.
+    void Disconnect()
+    {
+        accepted = false;
+        match = -1;
+        player = -1;
+        sequence = 0;
+        latestFrame = 0;
+        memset(ringFrame, 0, sizeof(ringFrame));
+        stats.disconnects++;
+    }
+
+    void ApplySnapshot(unsigned frame, unsigned baseFrame, const unsigned char* data, int size)
+    {
+        static const unsigned char zeros[QSTATE_BYTES] = {};
+
+        if (frame <= latestFrame)
+        {
+            stats.stale++;
+            return;
+        }
+
+        const unsigned char* base = zeros;
+        if (baseFrame != 0)
+        {
+            int baseSlot = baseFrame % SNAPSHOT_HISTORY;
+            if (ringFrame[baseSlot] != baseFrame)
+            {
+                stats.noBaseline++;
+                return;
+            }
+            base = ring[baseSlot];
+        }
+
+        int slot = frame % SNAPSHOT_HISTORY;
+        unsigned char decoded[QSTATE_BYTES];
+        if (!DecodeDelta(base, data, size, decoded))
+            return;
+        memcpy(ring[slot], decoded, QSTATE_BYTES);
+        ringFrame[slot] = frame;
+        latestFrame = frame;
+        stats.snapshots++;
+    }
+};
+
+#endif
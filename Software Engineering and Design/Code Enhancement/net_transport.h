@@ -0,0 +1,264 @@
+//=============================================================================
+// File Name: net_transport.h
+// Version: 1.0
+//
+// Description: Non-blocking UDP sockets for the multiplayer server and
+// client (Winsock on Windows, BSD sockets elsewhere), plus a link
+// conditioner that drops and delays outgoing packets so the protocol can
+// be tested on localhost under loss and latency.
+//
+// Link Conditioner:
+// - Every packet handed to Send() is dropped with probability lossPercent
+//   or queued until now + latency + random jitter. Pump() sends whatever
+//   is due. Time is supplied by the caller, so a test can run on a
+//   simulated clock as fast as the CPU allows.
+//=============================================================================
+
+#ifndef NET_TRANSPORT_H
+#define NET_TRANSPORT_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX // windows.h min/max macros break std::min and std::max
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef SOCKET NetSocketHandle;
+const NetSocketHandle NET_INVALID_SOCKET = INVALID_SOCKET;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int NetSocketHandle;
+const NetSocketHandle NET_INVALID_SOCKET = -1;
+#endif
+
+#include "brick_game.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+// IPv4 address and port, host byte order
+struct NetAddress {
+    unsigned ip;
+    unsigned short port;
+
+    bool operator==(const NetAddress& other) const { return ip == other.ip && port == other.port; }
+};
+
+const unsigned NET_LOCALHOST = 0x7F000001; // 127.0.0.1
+
+// Must be called once before any socket is opened (Winsock needs it)
+inline bool NetStartup()
+{
+#ifdef _WIN32
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+    return true;
+#endif
+}
+
+inline void NetShutdown()
+{
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+// Parse "a.b.c.d:port" or "localhost:port"
+inline bool ParseAddress(const char* text, NetAddress& address)
+{
+    const char* colon = strrchr(text, ':');
+    if (!colon)
+        return false;
+    address.port = (unsigned short)atoi(colon + 1);
+
+    char host[64];
+    size_t length = colon - text;
+    if (length == 0 || length >= sizeof(host))
+        return false;
+    memcpy(host, text, length);
+    host[length] = 0;
+    if (strcmp(host, "localhost") == 0) {
+        address.ip = NET_LOCALHOST;
+        return address.port != 0;
+    }
+
+    in_addr parsed;
+    if (inet_pton(AF_INET, host, &parsed) != 1)
+        return false;
+    address.ip = ntohl(parsed.s_addr);
+    return address.port != 0;
+}
+
+class UdpSocket
+{
+public:
+    UdpSocket() : handle(NET_INVALID_SOCKET) {}
+    ~UdpSocket() { Close(); }
+
+    // Bind to port on all interfaces (0 picks a free port) and make the
+    // socket non-blocking
+    bool Open(unsigned short port)
+    {
+        handle = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (handle == NET_INVALID_SOCKET) {
+            std::cout << "ERROR::NET::SOCKET" << std::endl;
+            return false;
+        }
+
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons(port);
+        if (bind(handle, (const sockaddr*)&local, sizeof(local)) != 0) {
+            std::cout << "ERROR::NET::BIND port " << port << std::endl;
+            Close();
+            return false;
+        }
+
+#ifdef _WIN32
+        u_long nonBlocking = 1;
+        ioctlsocket(handle, FIONBIO, &nonBlocking);
+#else
+        fcntl(handle, F_SETFL, fcntl(handle, F_GETFL, 0) | O_NONBLOCK);
+#endif
+        return true;
+    }
+
+    void Close()
+    {
+        if (handle == NET_INVALID_SOCKET)
+            return;
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        close(handle);
+#endif
+        handle = NET_INVALID_SOCKET;
+    }
+
+    bool Send(const NetAddress& to, const void* data, int size)
+    {
+        sockaddr_in remote;
+        memset(&remote, 0, sizeof(remote));
+        remote.sin_family = AF_INET;
+        remote.sin_addr.s_addr = htonl(to.ip);
+        remote.sin_port = htons(to.port);
+        return sendto(handle, (const char*)data, size, 0, (const sockaddr*)&remote, sizeof(remote)) == size;
+    }
+
+    // Returns the packet size, or -1 when nothing is waiting
+    int Receive(NetAddress& from, void* data, int capacity)
+    {
+        sockaddr_in remote;
+        socklen_t remoteSize = sizeof(remote);
+        int size = (int)recvfrom(handle, (char*)data, capacity, 0, (sockaddr*)&remote, &remoteSize);
+        if (size < 0)
+            return -1;
+        from.ip = ntohl(remote.sin_addr.s_addr);
+        from.port = ntohs(remote.sin_port);
+        return size;
+    }
+
+    unsigned short LocalPort() const
+    {
+        sockaddr_in local;
+        socklen_t localSize = sizeof(local);
+        if (getsockname(handle, (sockaddr*)&local, &localSize) != 0)
+            return 0;
+        return ntohs(local.sin_port);
+    }
+
+private:
+    NetSocketHandle handle;
+
+    UdpSocket(const UdpSocket&);
+    UdpSocket& operator=(const UdpSocket&);
+};
+
+struct LinkSettings {
+    float lossPercent;  // chance that a packet is dropped
+    double latency;     // one-way delay in seconds
+    double jitter;      // extra random delay, 0..jitter seconds
+};
+
+const LinkSettings PERFECT_LINK = { 0.0f, 0.0, 0.0 };
+
+// Sits in front of a socket's sends and simulates a bad network
+class LinkConditioner
+{
+public:
+    LinkConditioner() : sent(0), dropped(0), bytesSent(0), settings(PERFECT_LINK) { rng.Seed(12345); }
+
+    void Configure(const LinkSettings& link, unsigned seed)
+    {
+        settings = link;
+        rng.Seed(seed);
+    }
+
+    void Send(UdpSocket& socket, const NetAddress& to, const void* data, int size, double now)
+    {
+        sent++;
+        bytesSent += size;
+        if ((rng.Next() % 10000) < (unsigned)(settings.lossPercent * 100.0f)) {
+            dropped++;
+            return;
+        }
+        double delay = settings.latency + settings.jitter * (rng.Next() % 1000) / 1000.0;
+        if (delay <= 0.0) {
+            socket.Send(to, data, size);
+            return;
+        }
+
+        DelayedPacket packet;
+        packet.due = now + delay;
+        packet.to = to;
+        packet.bytes.assign((const unsigned char*)data, (const unsigned char*)data + size);
+        queue.push_back(packet);
+    }
+
+    // Send every delayed packet whose time has come
+    void Pump(UdpSocket& socket, double now)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < queue.size(); i++) {
+            if (queue[i].due <= now)
+                socket.Send(queue[i].to, queue[i].bytes.data(), (int)queue[i].bytes.size());
+            else
+                queue[kept++].swap(queue[i]);
+        }
+        queue.resize(kept);
+    }
+
+    unsigned long long sent;      // packets handed to Send()
+    unsigned long long dropped;   // of those, deliberately lost
+    unsigned long long bytesSent; // payload bytes handed to Send()
+
+private:
+    struct DelayedPacket {
+        double due;
+        NetAddress to;
+        std::vector<unsigned char> bytes;
+
+        void swap(DelayedPacket& other)
+        {
+            std::swap(due, other.due);
+            std::swap(to, other.to);
+            bytes.swap(other.bytes);
+        }
+    };
+
+    LinkSettings settings;
+    GameRandom rng;
+    std::vector<DelayedPacket> queue;
+};
+
+#endif
@@ -0,0 +1,223 @@
+//=============================================================================
+// File Name: particles.h
+// Version: 1.0
+//
+// Description: CPU particle system for brick debris. Particles are purely
+// visual, so they live on the render thread and never enter GameState:
+// the renderer emits a burst when it sees a brick switch off between two
+// snapshots, and replays, rollback and the network stay unaffected.
+//
+// Data Structures:
+// - Structure of arrays (x, y, vx, vy, life, 1/lifetime, color) used as a
+//   ring buffer: Emit() writes at the head and overwrites the oldest
+//   particle when full, so emitting never allocates or searches.
+// - Update() also writes an interleaved position array and an RGBA color
+//   array, which Draw() hands to OpenGL as one GL_POINTS draw call.
+//
+// Algorithmic Logic:
+// - Update() advances gravity, motion, a bounce on the floor and the fade
+//   four particles at a time with SSE2 (scalar fallback otherwise), in
+//   blocks of PARTICLE_BLOCK spread over a thread pool.
+// - Dead particles stay in the ring with alpha 0 until overwritten; the
+//   update handles them with the same branch-free code.
+//
+// Time Complexity: Emit O(count); Update O(ring slots used) / threads.
+//=============================================================================
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#ifndef BRICK_HEADLESS
+#include <GLFW\glfw3.h>
+#endif
+#include "brick_game.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <math.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_SSE2 1
+#endif
+
+const int PARTICLE_BLOCK = 16384;       // particles per thread pool chunk (multiple of 4)
+const float PARTICLE_GRAVITY = 2.5f;    // units per second squared
+const float PARTICLE_FLOOR = -1.0f;
+
+class ParticleSystem
+{
+public:
+    // capacity is rounded up to a multiple of 4; threads as for ThreadPool
+    explicit ParticleSystem(int capacity, int threads = 0)
+        : capacity((capacity + 3) & ~3), head(0), used(0), live(0), pool(threads),
+          x(this->capacity), y(this->capacity), vx(this->capacity), vy(this->capacity),
+          life(this->capacity, 0.0f), invLifetime(this->capacity, 0.0f), color(this->capacity, 0),
+          renderXY(2 * (size_t)this->capacity), renderColor(this->capacity, 0)
+    {
+        rng.Seed(0x5EED);
+    }
+
+    // Spray count particles from (px, py) in every direction, up to speed
+    // units per second, living around lifetime seconds
+    void Emit(float px, float py, float red, float green, float blue, int count, float speed = 0.8f, float lifetime = 1.2f)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            float angle = (rng.Next() % 62832) / 10000.0f;
+            float velocity = speed * (0.2f + 0.8f * (rng.Next() % 1000) / 1000.0f);
+            float shade = 0.6f + 0.4f * (rng.Next() % 1000) / 1000.0f;
+
+            int p = head;
+            head = head + 1 == capacity ? 0 : head + 1;
+            x[p] = px;
+            y[p] = py;
+            vx[p] = cosf(angle) * velocity;
+            vy[p] = sinf(angle) * velocity;
+            life[p] = lifetime * (0.6f + 0.8f * (rng.Next() % 1000) / 1000.0f);
+            invLifetime[p] = 1.0f / life[p];
+            color[p] = PackColor(red * shade, green * shade, blue * shade);
+        }
+        // Slots in use, rounded to whole groups of four for the SIMD path
+        long long total = (long long)usedEmitted + count;
+        usedEmitted = total > capacity ? capacity : (int)total;
+        used = (usedEmitted + 3) & ~3;
+    }
+
+    // Advance every particle by dt seconds and refresh the draw arrays
+    void Update(float dt)
+    {
+        UpdateRange body = { this, dt };
+        live.store(0);
+        pool.ParallelFor(used, PARTICLE_BLOCK, body);
+    }
+
+#ifndef BRICK_HEADLESS
+    // One draw call for every particle; dead ones have alpha 0
+    void Draw(float pointSize = 2.0f) const
+    {
+        if (used == 0)
+            return;
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glPointSize(pointSize);
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glEnableClientState(GL_COLOR_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, renderXY.data());
+        glColorPointer(4, GL_UNSIGNED_BYTE, 0, renderColor.data());
+        glDrawArrays(GL_POINTS, 0, used);
+        glDisableClientState(GL_COLOR_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+        glDisable(GL_BLEND);
+    }
+#endif
+
+    int Capacity() const { return capacity; }
+    int LiveCount() const { return live.load(); } // as of the last Update()
+    int ThreadCount() const { return pool.ThreadCount(); }
+
+private:
+    int capacity;
+    int head;              // next slot Emit() writes
+    int usedEmitted = 0;   // slots ever written, up to capacity
+    int used;              // usedEmitted rounded up to a multiple of 4
+    std::atomic<int> live;
+    ThreadPool pool;
+    GameRandom rng;
+
+    std::vector<float> x, y, vx, vy;
+    std::vector<float> life;         // seconds left; <= 0 is dead
+    std::vector<float> invLifetime;  // 1 / starting life, for the fade
+    std::vector<unsigned> color;     // RGB, alpha filled in by Update()
+    std::vector<float> renderXY;     // x0 y0 x1 y1 ...
+    std::vector<unsigned> renderColor;
+
+    static unsigned PackColor(float red, float green, float blue)
+    {
+        unsigned r = (unsigned)(red > 1.0f ? 255 : red * 255.0f);
+        unsigned g = (unsigned)(green > 1.0f ? 255 : green * 255.0f);
+        unsigned b = (unsigned)(blue > 1.0f ? 255 : blue * 255.0f);
+        return r | (g << 8) | (b << 16);
+    }
+
+    struct UpdateRange {
+        ParticleSystem* system;
+        float dt;
+
+        void operator()(int begin, int end) const { system->UpdateBlock(begin, end, dt); }
+    };
+
+    void UpdateBlock(int begin, int end, float dt)
+    {
+        int alive = 0;
+        int i = begin;
+#ifdef PARTICLES_SSE2
+        const __m128 vdt = _mm_set1_ps(dt);
+        const __m128 fall = _mm_set1_ps(PARTICLE_GRAVITY * dt);
+        const __m128 floor = _mm_set1_ps(PARTICLE_FLOOR);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 bounce = _mm_set1_ps(-0.4f);
+        const __m128 friction = _mm_set1_ps(0.8f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        for (; i + 4 <= end; i += 4)
+        {
+            __m128 l = _mm_sub_ps(_mm_loadu_ps(&life[i]), vdt);
+            __m128 px = _mm_loadu_ps(&x[i]);
+            __m128 py = _mm_loadu_ps(&y[i]);
+            __m128 pvx = _mm_loadu_ps(&vx[i]);
+            __m128 pvy = _mm_sub_ps(_mm_loadu_ps(&vy[i]), fall);
+            px = _mm_add_ps(px, _mm_mul_ps(pvx, vdt));
+            py = _mm_add_ps(py, _mm_mul_ps(pvy, vdt));
+
+            // Below the floor and falling: reflect and slow down
+            __m128 hit = _mm_and_ps(_mm_cmplt_ps(py, floor), _mm_cmplt_ps(pvy, zero));
+            pvy = _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(pvy, bounce)), _mm_andnot_ps(hit, pvy));
+            pvx = _mm_or_ps(_mm_and_ps(hit, _mm_mul_ps(pvx, friction)), _mm_andnot_ps(hit, pvx));
+            py = _mm_or_ps(_mm_and_ps(hit, floor), _mm_andnot_ps(hit, py));
+
+            _mm_storeu_ps(&life[i], l);
+            _mm_storeu_ps(&x[i], px);
+            _mm_storeu_ps(&y[i], py);
+            _mm_storeu_ps(&vx[i], pvx);
+            _mm_storeu_ps(&vy[i], pvy);
+
+            __m128 fade = _mm_min_ps(_mm_max_ps(_mm_mul_ps(l, _mm_loadu_ps(&invLifetime[i])), zero), one);
+            __m128i alpha = _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(fade, scale)), 24);
+            __m128i rgba = _mm_or_si128(_mm_loadu_si128((const __m128i*)&color[i]), alpha);
+            _mm_storeu_si128((__m128i*)&renderColor[i], rgba);
+            _mm_storeu_ps(&renderXY[2 * (size_t)i], _mm_unpacklo_ps(px, py));
+            _mm_storeu_ps(&renderXY[2 * (size_t)i + 4], _mm_unpackhi_ps(px, py));
+
+            int mask = _mm_movemask_ps(_mm_cmpgt_ps(l, zero));
+            alive += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+        }
+#endif
+        for (; i < end; i++)
+        {
+            life[i] -= dt;
+            vy[i] -= PARTICLE_GRAVITY * dt;
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            if (y[i] < PARTICLE_FLOOR && vy[i] < 0.0f)
+            {
+                vy[i] *= -0.4f;
+                vx[i] *= 0.8f;
+                y[i] = PARTICLE_FLOOR;
+            }
+
+            float fade = life[i] * invLifetime[i];
+            fade = fade < 0.0f ? 0.0f : (fade > 1.0f ? 1.0f : fade);
+            renderColor[i] = color[i] | ((unsigned)(fade * 255.0f) << 24);
+            renderXY[2 * (size_t)i] = x[i];
+            renderXY[2 * (size_t)i + 1] = y[i];
+            alive += life[i] > 0.0f;
+        }
+        live.fetch_add(alive);
+    }
+
+    ParticleSystem(const ParticleSystem&);
+    ParticleSystem& operator=(const ParticleSystem&);
+};
+
+#endif
@@ -0,0 +1,339 @@
+//=============================================================================
+// File Name: brickenv.cpp
+// Version: 1.0
+//
+// Description: Python bindings for the batched brick game environment
+// (batch_env.h). Build with "python setup.py build_ext --inplace" in this
+// folder.
+//
+//     import numpy as np, brickenv
+//     env = brickenv.BatchEnv(4096, seed=1)
+//     obs, rew, done = env.observations, env.rewards, env.dones
+//     env.step(np.random.randint(0, brickenv.NUM_ACTIONS, env.num_envs))
+//     # obs, rew and done now hold the new step; nothing was copied
+//
+// Design:
+// - observations, rewards and dones are NumPy arrays over the engine's own
+//   buffers (float32 N x OBS_SIZE, float32 N, bool N). They are updated in
+//   place by every step() and keep the environment alive while referenced.
+//   Each access builds a new view, so fetch them once.
+// - step() and reset() release the GIL while the engine runs, so several
+//   Python threads can each drive their own BatchEnv shard in parallel. A
+//   single BatchEnv must not be stepped from two threads at once; that
+//   raises RuntimeError.
+// - The arrays are exported through the buffer protocol, so the module
+//   builds without NumPy headers. Without NumPy installed the attributes
+//   are memoryviews instead.
+//=============================================================================
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <cctype>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#define BRICK_HEADLESS
+#include "../batch_env.h"
+
+//-----------------------------------------------------------------------------
+// EnvBuffer: exports one of a BatchEnv's buffers and holds a reference to it
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    PyObject_HEAD
+    PyObject* owner;
+    void* data;
+    const char* format;
+    Py_ssize_t itemsize;
+    int ndim;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+} EnvBufferObject;
+
+static void EnvBuffer_dealloc(EnvBufferObject* self)
+{
+    Py_XDECREF(self->owner);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int EnvBuffer_getbuffer(PyObject* obj, Py_buffer* view, int flags)
+{
+    EnvBufferObject* self = (EnvBufferObject*)obj;
+    Py_ssize_t count = 1;
+    for (int i = 0; i < self->ndim; i++)
+        count *= self->shape[i];
+
+    view->buf = self->data;
+    view->obj = obj;
+    Py_INCREF(obj);
+    view->len = count * self->itemsize;
+    view->readonly = 0;
+    view->itemsize = self->itemsize;
+    view->format = (flags & PyBUF_FORMAT) ? (char*)self->format : NULL;
+    view->ndim = self->ndim;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    return 0;
+}
+
+static PyBufferProcs EnvBuffer_as_buffer = { EnvBuffer_getbuffer, NULL };
+
+static PyTypeObject EnvBufferType = { PyVarObject_HEAD_INIT(NULL, 0) "brickenv._EnvBuffer" };
+
+//-----------------------------------------------------------------------------
+// BatchEnv
+//-----------------------------------------------------------------------------
+
+typedef struct {
+    PyObject_HEAD
+    BatchEnv* env;
+    std::vector<int>* actions; // actions converted to int
+    int stepping;              // set while the GIL is released in step()
+} BrickEnvObject;
+
+static PyObject* gNumpyAsarray = NULL; // numpy.asarray, or NULL without NumPy
+
+// Wrap one engine buffer as a NumPy array (or a memoryview without NumPy)
+static PyObject* MakeView(BrickEnvObject* owner, void* data, const char* format, Py_ssize_t itemsize,
+                          Py_ssize_t rows, Py_ssize_t columns)
+{
+    EnvBufferObject* buffer = PyObject_New(EnvBufferObject, &EnvBufferType);
+    if (!buffer)
+        return NULL;
+    Py_INCREF(owner);
+    buffer->owner = (PyObject*)owner;
+    buffer->data = data;
+    buffer->format = format;
+    buffer->itemsize = itemsize;
+    buffer->ndim = columns > 0 ? 2 : 1;
+    buffer->shape[0] = rows;
+    buffer->shape[1] = columns;
+    buffer->strides[0] = (columns > 0 ? columns : 1) * itemsize;
+    buffer->strides[1] = itemsize;
+
+    PyObject* view = gNumpyAsarray
+        ? PyObject_CallFunctionObjArgs(gNumpyAsarray, (PyObject*)buffer, NULL)
+        : PyMemoryView_FromObject((PyObject*)buffer);
+    Py_DECREF(buffer);
+    return view;
+}
+
+static int BrickEnv_init(BrickEnvObject* self, PyObject* args, PyObject* kwargs)
+{
+    static const char* keywords[] = { "num_envs", "seed", "threads", NULL };
+    int numEnvs = 0;
+    unsigned int seed = 0;
+    int threads = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "i|Ii", (char**)keywords, &numEnvs, &seed, &threads))
+        return -1;
+    if (numEnvs <= 0) {
+        PyErr_SetString(PyExc_ValueError, "num_envs must be positive");
+        return -1;
+    }
+    if (self->env) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is already initialized");
+        return -1;
+    }
+
+    try {
+        self->env = new BatchEnv(numEnvs, seed, threads);
+        self->actions = new std::vector<int>(numEnvs);
+    }
+    catch (const std::bad_alloc&) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+static void BrickEnv_dealloc(BrickEnvObject* self)
+{
+    delete self->env;
+    delete self->actions;
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static bool CheckInitialized(BrickEnvObject* self)
+{
+    if (!self->env) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is not initialized");
+        return false;
+    }
+    return true;
+}
+
+// step() and reset() may not overlap on one BatchEnv
+static bool CheckReady(BrickEnvObject* self)
+{
+    if (!CheckInitialized(self))
+        return false;
+    if (self->stepping) {
+        PyErr_SetString(PyExc_RuntimeError, "BatchEnv is being stepped by another thread");
+        return false;
+    }
+    return true;
+}
+
+// Read the actions buffer into self->actions. Any C-contiguous 1-D integer
+// buffer of length num_envs is accepted (int8 to int64).
+static bool ReadActions(BrickEnvObject* self, PyObject* actions)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(actions, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+        return false;
+
+    bool ok = false;
+    char code = view.format ? view.format[strlen(view.format) - 1] : 'B';
+    Py_ssize_t count = view.itemsize > 0 ? view.len / view.itemsize : 0;
+    if (!strchr("bBhHiIlLqQ", code))
+        PyErr_SetString(PyExc_TypeError, "actions must be an integer array");
+    else if (count != self->env->EnvCount())
+        PyErr_Format(PyExc_ValueError, "expected %d actions, got %zd", self->env->EnvCount(), count);
+    else {
+        int* out = self->actions->data();
+        const char* in = (const char*)view.buf;
+        bool isSigned = islower(code) != 0;
+        for (Py_ssize_t i = 0; i < count; i++, in += view.itemsize) {
+            switch (view.itemsize) {
+            case 1: out[i] = isSigned ? *(const signed char*)in : *(const unsigned char*)in; break;
+            case 2: out[i] = isSigned ? *(const short*)in : *(const unsigned short*)in; break;
+            case 4: out[i] = *(const int*)in; break;
+            default: out[i] = (int)*(const long long*)in; break;
+            }
+        }
+        ok = true;
+    }
+    PyBuffer_Release(&view);
+    return ok;
+}
+
+static PyObject* BrickEnv_step(BrickEnvObject* self, PyObject* actions)
+{
+    if (!CheckReady(self) || !ReadActions(self, actions))
+        return NULL;
+
+    self->stepping = 1;
+    Py_BEGIN_ALLOW_THREADS
+    self->env->Step(self->actions->data());
+    Py_END_ALLOW_THREADS
+    self->stepping = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject* BrickEnv_reset(BrickEnvObject* self, PyObject* args)
+{
+    unsigned int seed = 0;
+    if (!PyArg_ParseTuple(args, "|I", &seed) || !CheckReady(self))
+        return NULL;
+
+    self->stepping = 1;
+    Py_BEGIN_ALLOW_THREADS
+    self->env->Reset(seed);
+    Py_END_ALLOW_THREADS
+    self->stepping = 0;
+    Py_RETURN_NONE;
+}
+
+static PyObject* BrickEnv_observations(BrickEnvObject* self, void*)
+{
+    if (!CheckInitialized(self))
+        return NULL;
+    return MakeView(self, self->env->Observations(), "f", sizeof(float), self->env->EnvCount(), OBS_SIZE);
+}
+
+static PyObject* BrickEnv_rewards(BrickEnvObject* self, void*)
+{
+    if (!CheckInitialized(self))
+        return NULL;
+    return MakeView(self, self->env->Rewards(), "f", sizeof(float), self->env->EnvCount(), 0);
+}
+
+static PyObject* BrickEnv_dones(BrickEnvObject* self, void*)
+{
+    if (!CheckInitialized(self))
+        return NULL;
+    return MakeView(self, self->env->Dones(), "?", 1, self->env->EnvCount(), 0);
+}
+
+static PyObject* BrickEnv_num_envs(BrickEnvObject* self, void*)
+{
+    return PyLong_FromLong(self->env ? self->env->EnvCount() : 0);
+}
+
+static PyObject* BrickEnv_num_threads(BrickEnvObject* self, void*)
+{
+    return PyLong_FromLong(self->env ? self->env->ThreadCount() : 0);
+}
+
+static PyMethodDef BrickEnv_methods[] = {
+    { "step", (PyCFunction)BrickEnv_step, METH_O,
+      "step(actions)\n\nAdvance every game by one tick. actions is an integer array of num_envs\n"
+      "actions (NONE, LEFT, RIGHT, LAUNCH). observations, rewards and dones are\n"
+      "updated in place; finished games are reset automatically." },
+    { "reset", (PyCFunction)BrickEnv_reset, METH_VARARGS,
+      "reset(seed=0)\n\nStart every game over from seed." },
+    { NULL }
+};
+
+static PyGetSetDef BrickEnv_getset[] = {
+    { (char*)"observations", (getter)BrickEnv_observations, NULL, (char*)"float32 (num_envs, OBS_SIZE) view of the observations", NULL },
+    { (char*)"rewards", (getter)BrickEnv_rewards, NULL, (char*)"float32 (num_envs,) view of the last step's rewards", NULL },
+    { (char*)"dones", (getter)BrickEnv_dones, NULL, (char*)"bool (num_envs,) view, True where a game ended last step", NULL },
+    { (char*)"num_envs", (getter)BrickEnv_num_envs, NULL, (char*)"number of games", NULL },
+    { (char*)"num_threads", (getter)BrickEnv_num_threads, NULL, (char*)"threads used by step()", NULL },
+    { NULL }
+};
+
+static PyTypeObject BrickEnvType = { PyVarObject_HEAD_INIT(NULL, 0) "brickenv.BatchEnv" };
+
+static PyModuleDef brickenvModule = {
+    PyModuleDef_HEAD_INIT, "brickenv",
+    "Batched headless brick game environment with zero-copy NumPy buffers.", -1, NULL
+};
+
+PyMODINIT_FUNC PyInit_brickenv(void)
+{
+    EnvBufferType.tp_basicsize = sizeof(EnvBufferObject);
+    EnvBufferType.tp_dealloc = (destructor)EnvBuffer_dealloc;
+    EnvBufferType.tp_as_buffer = &EnvBuffer_as_buffer;
+    EnvBufferType.tp_flags = Py_TPFLAGS_DEFAULT;
+    EnvBufferType.tp_doc = "Buffer over BatchEnv memory";
+    if (PyType_Ready(&EnvBufferType) < 0)
+        return NULL;
+
+    BrickEnvType.tp_basicsize = sizeof(BrickEnvObject);
+    BrickEnvType.tp_dealloc = (destructor)BrickEnv_dealloc;
+    BrickEnvType.tp_flags = Py_TPFLAGS_DEFAULT;
+    BrickEnvType.tp_doc = "BatchEnv(num_envs, seed=0, threads=0)\n\nnum_envs independent brick games stepped together. threads=0 uses\none thread per core.";
+    BrickEnvType.tp_methods = BrickEnv_methods;
+    BrickEnvType.tp_getset = BrickEnv_getset;
+    BrickEnvType.tp_init = (initproc)BrickEnv_init;
+    BrickEnvType.tp_new = PyType_GenericNew;
+    if (PyType_Ready(&BrickEnvType) < 0)
+        return NULL;
+
+    PyObject* module = PyModule_Create(&brickenvModule);
+    if (!module)
+        return NULL;
+
+    Py_INCREF(&BrickEnvType);
+    PyModule_AddObject(module, "BatchEnv", (PyObject*)&BrickEnvType);
+    PyModule_AddIntConstant(module, "OBS_SIZE", OBS_SIZE);
+    PyModule_AddIntConstant(module, "NUM_ACTIONS", ACTION_COUNT);
+    PyModule_AddIntConstant(module, "ACTION_NONE", ACTION_NONE);
+    PyModule_AddIntConstant(module, "ACTION_LEFT", ACTION_LEFT);
+    PyModule_AddIntConstant(module, "ACTION_RIGHT", ACTION_RIGHT);
+    PyModule_AddIntConstant(module, "ACTION_LAUNCH", ACTION_LAUNCH);
+
+    // NumPy is optional: without it the buffers come back as memoryviews
+    PyObject* numpy = PyImport_ImportModule("numpy");
+    if (numpy) {
+        gNumpyAsarray = PyObject_GetAttrString(numpy, "asarray");
+        Py_DECREF(numpy);
+    }
+    PyErr_Clear();
+    return module;
+}
@@ -0,0 +1,32 @@
+#==============================================================================
+# File Name: setup.py
+# Version: 1.0
+#
+# Description: Builds the brickenv Python module (brickenv.cpp), the batched
+# brick game environment with zero-copy NumPy buffers.
+#
+#     python setup.py build_ext --inplace
+#==============================================================================
+
+import sys
+from setuptools import setup, Extension
+
+if sys.platform == "win32":
+    compile_args = ["/O2", "/std:c++14", "/EHsc"]
+else:
+    compile_args = ["-O2", "-std=c++14"]
+
+setup(
+    name="brickenv",
+    version="1.0",
+    description="Batched headless brick game environment",
+    ext_modules=[
+        Extension(
+            "brickenv",
+            sources=["brickenv.cpp"],
+            include_dirs=[".."],
+            extra_compile_args=compile_args,
+            language="c++",
+        )
+    ],
+)
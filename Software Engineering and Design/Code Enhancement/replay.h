@@ -0,0 +1,292 @@
+//=============================================================================
+// File Name: replay.h
+// Version: 1.0
+//
+// Description: Recording and headless replay of brick game sessions.
+// A session is the seed passed to ResetGame, the number of ticks played,
+// the key events of every tick and a hash of the game state after every
+// tick. Because the simulation only depends on the seed and the input,
+// replaying the events through StepGame must reproduce every hash; any
+// difference points at the first tick where a simulation change altered
+// behavior.
+//
+// File Format (little endian):
+// - Header: "BRKR", u32 version, u32 seed, u32 tick count,
+//   u32 input byte count, u32 hash count.
+// - Input: one record per tick that had events:
+//   varint ticks since the previous record, u8 event count, then per event
+//   u8 (key | player << 2 | pressed << 7) and u16 offset (1/65535 of a
+//   tick). Single-player sessions only ever have player 0.
+//   Ticks without events cost nothing.
+// - Hashes: u32 per tick.
+//=============================================================================
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "brick_game.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// FNV-1a over the parts of the state that define the game: the circles in
+// world, the bricks, the paddles, lives and the random generator.
+class StateHasher
+{
+public:
+    unsigned hash = 2166136261u;
+
+    void Add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    }
+
+    void Add(float value) { Add(&value, sizeof(value)); }
+    void Add(int value) { Add(&value, sizeof(value)); }
+    void Add(unsigned value) { Add(&value, sizeof(value)); }
+};
+
+inline unsigned HashGameState(const GameState& state)
+{
+    StateHasher h;
+    h.Add((unsigned)state.world.size());
+    for (int i = 0; i < state.world.size(); i++)
+    {
+        const Circle& c = state.world[i];
+        h.Add(c.x); h.Add(c.y); h.Add(c.radius); h.Add(c.direction);
+        h.Add(c.red); h.Add(c.green); h.Add(c.blue);
+    }
+    for (int i = 0; i < state.bricks.size(); i++)
+    {
+        const Brick& b = state.bricks[i];
+        h.Add((int)b.onoff); h.Add(b.hit_points);
+        h.Add(b.red); h.Add(b.green); h.Add(b.blue);
+    }
+    for (int p = 0; p < state.playerCount; p++)
+        h.Add(state.paddles[p].x);
+    h.Add(state.lives);
+    h.Add(state.rng.state);
+    return h.hash;
+}
+
+class SessionLog
+{
+public:
+    static const unsigned VERSION = 1;
+
+    unsigned seed = 0;
+    unsigned tickCount = 0;
+    std::vector<unsigned char> input;   // encoded tick records
+    std::vector<unsigned> hashes;       // state hash after each tick
+
+    void Begin(unsigned sessionSeed)
+    {
+        seed = sessionSeed;
+        tickCount = 0;
+        lastRecordTick = 0;
+        input.clear();
+        hashes.clear();
+    }
+
+    // Append one simulated tick: its input and the resulting state hash
+    void RecordTick(const TickInput& tickInput, unsigned stateHash)
+    {
+        tickCount++;
+        hashes.push_back(stateHash);
+        if (tickInput.count == 0)
+            return;
+
+        PutVarint(tickCount - lastRecordTick);
+        lastRecordTick = tickCount;
+        input.push_back((unsigned char)tickInput.count);
+        for (int i = 0; i < tickInput.count; i++)
+        {
+            const InputEvent& e = tickInput.events[i];
+            unsigned offset = (unsigned)(e.offset * INPUT_OFFSET_STEPS + 0.5f);
+            input.push_back((unsigned char)(e.key | (e.player << 2) | (e.pressed ? 0x80 : 0)));
+            input.push_back((unsigned char)(offset & 0xFF));
+            input.push_back((unsigned char)(offset >> 8));
+        }
+    }
+
+    bool Save(const char* path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cout << "ERROR::REPLAY::CANNOT_WRITE " << path << std::endl;
+            return false;
+        }
+        unsigned header[5] = { VERSION, seed, tickCount, (unsigned)input.size(), (unsigned)hashes.size() };
+        file.write("BRKR", 4);
+        file.write((const char*)header, sizeof(header));
+        file.write((const char*)input.data(), input.size());
+        file.write((const char*)hashes.data(), hashes.size() * sizeof(unsigned));
+        return (bool)file;
+    }
+
+    bool Load(const char* path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4];
+        unsigned header[5];
+        if (!file.read(magic, 4) || memcmp(magic, "BRKR", 4) != 0 ||
+            !file.read((char*)header, sizeof(header)) || header[0] != VERSION)
+        {
+            std::cout << "ERROR::REPLAY::BAD_FILE " << path << std::endl;
+            return false;
+        }
+
+        // The sizes come from the file; check them against what is left of
+        // it before allocating anything
+        std::streampos body = file.tellg();
+        file.seekg(0, std::ios::end);
+        unsigned long long remaining = (unsigned long long)(file.tellg() - body);
+        file.seekg(body);
+        if (header[4] != header[2] || header[3] > remaining || header[4] > (remaining - header[3]) / sizeof(unsigned))
+        {
+            std::cout << "ERROR::REPLAY::TRUNCATED " << path << std::endl;
+            return false;
+        }
+
+        seed = header[1];
+        tickCount = header[2];
+        input.resize(header[3]);
+        hashes.resize(header[4]);
+        file.read((char*)input.data(), input.size());
+        file.read((char*)hashes.data(), hashes.size() * sizeof(unsigned));
+        if (!file || hashes.size() != tickCount)
+        {
+            std::cout << "ERROR::REPLAY::TRUNCATED " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Sequential reader over encoded input records: a whole log, or any
+    // span of records in the same format (e.g. a segment of a seekable
+    // replay file, read in place)
+    class Reader
+    {
+    public:
+        explicit Reader(const SessionLog& log) : Reader(log.input.data(), log.input.size(), log.tickCount) {}
+
+        Reader(const unsigned char* data, size_t size, unsigned tickCount)
+            : data(data), size(size), tickCount(tickCount), pos(0), tick(0), nextRecordTick(0)
+        {
+            ReadRecordTick();
+        }
+
+        // Fill the input for the next tick. Returns false past the last tick.
+        bool NextTick(TickInput& tickInput)
+        {
+            if (tick == tickCount)
+                return false;
+            tick++;
+            tickInput.count = 0;
+            if (tick != nextRecordTick)
+                return true;
+
+            int count = pos < size ? data[pos++] : 0;
+            for (int i = 0; i < count && pos + 3 <= size; i++)
+            {
+                unsigned char keyBits = data[pos];
+                unsigned offset = data[pos + 1] | (data[pos + 2] << 8);
+                pos += 3;
+                if ((keyBits & 0x03) >= GAMEKEY_COUNT)
+                    continue; // corrupt: two key bits, three keys
+                tickInput.Add(offset / INPUT_OFFSET_STEPS, (GAMEKEY)(keyBits & 0x03), (keyBits & 0x80) != 0, (keyBits >> 2) & 0x1F);
+            }
+            ReadRecordTick();
+            return true;
+        }
+
+    private:
+        const unsigned char* data;
+        size_t size;
+        unsigned tickCount;
+        size_t pos;
+        unsigned tick;
+        unsigned nextRecordTick;
+
+        void ReadRecordTick()
+        {
+            unsigned delta = 0;
+            int shift = 0;
+            while (pos < size && shift < 32)
+            {
+                unsigned char byte = data[pos++];
+                delta |= (unsigned)(byte & 0x7F) << shift;
+                shift += 7;
+                if ((byte & 0x80) == 0)
+                {
+                    nextRecordTick = tick + delta;
+                    return;
+                }
+            }
+            // No more records, or a varint longer than 32 bits: the rest of
+            // the data is corrupt and is ignored
+            pos = size;
+            nextRecordTick = 0;
+        }
+    };
+
+private:
+    unsigned lastRecordTick = 0;
+
+    void PutVarint(unsigned value)
+    {
+        while (value >= 0x80)
+        {
+            input.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        input.push_back((unsigned char)value);
+    }
+};
+
+struct ReplayResult {
+    bool matched;
+    unsigned ticks;          // ticks simulated
+    unsigned firstMismatch;  // 1-based tick of the first bad hash, 0 if none
+    double seconds;          // wall time spent simulating
+    unsigned long long allocations; // heap allocations made while simulating
+};
+
+// Run a recorded session through StepGame as fast as possible, without a
+// window, and compare the state hash after every tick.
+inline ReplayResult ReplaySession(const SessionLog& log)
+{
+    ReplayResult result = { true, 0, 0, 0.0, 0 };
+
+    GameState state;
+    ResetGame(state, log.seed);
+    SessionLog::Reader reader(log);
+    TickInput tickInput;
+    FrameArena scratch(TICK_SCRATCH_BYTES);
+
+    unsigned long long allocationsBefore = ThreadAllocationCount();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (reader.NextTick(tickInput))
+    {
+        StepGame(state, tickInput, scratch);
+        if (HashGameState(state) != log.hashes[result.ticks] && result.matched)
+        {
+            result.matched = false;
+            result.firstMismatch = result.ticks + 1;
+        }
+        result.ticks++;
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.allocations = ThreadAllocationCount() - allocationsBefore;
+    return result;
+}
+
+#endif
@@ -0,0 +1,99 @@
+//=============================================================================
+// File Name: rollback.h
+// Version: 1.0
+//
+// Description: Saving and restoring the whole simulation for rollback
+// netcode and speculative ("what if") simulation. A GameState is one
+// contiguous block of plain data, with no pointers or heap memory:
+// balls and bricks sit in fixed-capacity pools and the random generator
+// is a single word. Snapshotting it is a single memcpy, and a snapshot
+// stays valid wherever the block is copied to.
+//
+// - RollbackBuffer keeps the state before each of the last FRAMES ticks
+//   together with that tick's input. Rollback() goes back to a tick,
+//   replaces its input (a late remote key press, an AI's alternative
+//   move) and simulates forward to the present again.
+//
+// Time Complexity: Record is O(sizeof(GameState)); Rollback(n) is one
+// copy plus n ticks of StepGame.
+//=============================================================================
+
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+#include "brick_game.h"
+#include <cstring>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<GameState>::value, "GameState is snapshotted with memcpy");
+
+// Frames of input a rollback session can correct
+const int ROLLBACK_FRAMES = 8;
+
+inline void SaveState(const GameState& state, GameState& snapshot)
+{
+    memcpy(&snapshot, &state, sizeof(GameState));
+}
+
+inline void RestoreState(const GameState& snapshot, GameState& state)
+{
+    memcpy(&state, &snapshot, sizeof(GameState));
+}
+
+template <int FRAMES>
+class RollbackBuffer
+{
+public:
+    RollbackBuffer() : newest(0), count(0) {}
+
+    // Call before StepGame with the input about to be applied
+    void Record(const GameState& state, const TickInput& input)
+    {
+        int slot = state.tick % (FRAMES + 1);
+        SaveState(state, states[slot]);
+        inputs[slot] = input;
+        newest = state.tick;
+        count = count < FRAMES + 1 ? count + 1 : count;
+    }
+
+    // Can the tick that started at state.tick == tick still be replayed?
+    bool Contains(unsigned tick) const
+    {
+        return count > 0 && tick <= newest && newest - tick < (unsigned)count;
+    }
+
+    // Go back to the start of tick, apply input there instead of what was
+    // recorded, and re-simulate up to where state was. Returns the number
+    // of ticks simulated, or -1 if tick is no longer held.
+    int Rollback(GameState& state, unsigned tick, const TickInput& input, FrameArena& scratch)
+    {
+        if (!Contains(tick))
+            return -1;
+        unsigned end = state.tick;
+        inputs[tick % (FRAMES + 1)] = input;
+
+        RestoreState(states[tick % (FRAMES + 1)], state);
+        int simulated = 0;
+        while (state.tick < end)
+        {
+            int slot = state.tick % (FRAMES + 1);
+            if (state.tick != tick)
+                SaveState(state, states[slot]);
+            StepGame(state, inputs[slot], scratch);
+            simulated++;
+            if (state.gameOver)
+                break; // StepGame no longer advances the tick
+        }
+        return simulated;
+    }
+
+    const TickInput& InputAt(unsigned tick) const { return inputs[tick % (FRAMES + 1)]; }
+
+private:
+    GameState states[FRAMES + 1]; // one more than FRAMES: the start of the oldest tick
+    TickInput inputs[FRAMES + 1];
+    unsigned newest;
+    int count;
+};
+
+#endif
@@ -0,0 +1,357 @@
+//=============================================================================
+// File Name: seekable_replay.h
+// Version: 1.0
+//
+// Description: Replay files that can be opened at any tick. A .brkr
+// session (replay.h) only holds input, so reaching tick N means
+// simulating N ticks. A seekable file splits the session into segments
+// of a fixed number of ticks. Each segment starts with a compressed
+// keyframe, which is the raw GameState at its first tick, followed by that
+// segment's input. Seeking restores one keyframe and simulates at most one
+// segment.
+// The file is read through a memory mapping: opening it only reads the
+// footer, and a seek touches just the keyframe and input it needs.
+//
+// File Format (little endian):
+// - Header: "BRKS", u32 version, u32 seed, u32 tick count,
+//   u32 keyframe interval, u32 sizeof(GameState).
+// - Segments: keyframe (LZ compressed, lz_codec.h), then input records in
+//   the .brkr format with ticks counted from the segment start.
+// - Hashes: u32 state hash after each tick, as in .brkr.
+// - Index: one SeekIndexEntry per segment, in tick order.
+// - Footer: u64 index offset, u64 hashes offset, u32 segment count,
+//   "BRKI". The footer is found from the end of the file.
+// Hashes and index start on 8-byte boundaries so they can be read in place.
+//
+// Keyframes are memory images of GameState, so a file only opens in a
+// build with the same GameState layout (checked through the header). A
+// file is still untrusted input: offsets are bounds checked and every
+// restored keyframe goes through ValidGameState before it is stepped.
+//
+// Time Complexity: Seek is O(log segments) for the index lookup, plus one
+// keyframe decompression, plus at most interval ticks of StepGame.
+//=============================================================================
+
+#ifndef SEEKABLE_REPLAY_H
+#define SEEKABLE_REPLAY_H
+
+#include "replay.h"
+#include "lz_codec.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const unsigned SEEK_VERSION = 1;
+const unsigned DEFAULT_KEYFRAME_INTERVAL = 300; // ticks, 5 seconds at 60 Hz
+
+struct SeekIndexEntry {
+    unsigned tick;          // ticks played before the keyframe
+    unsigned keyframeSize;  // compressed bytes
+    unsigned inputSize;     // input record bytes
+    unsigned tickCount;     // ticks of input in the segment
+    unsigned long long keyframeOffset;
+    unsigned long long inputOffset;
+};
+
+struct SeekFooter {
+    unsigned long long indexOffset;
+    unsigned long long hashesOffset;
+    unsigned segmentCount;
+    char magic[4];
+};
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() : data(nullptr), size(0)
+    {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+    ~MappedFile() { Close(); }
+
+    bool Open(const char* path)
+    {
+        Close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return false;
+        size = (size_t)fileSize.QuadPart;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+            return false;
+        data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        size = (size_t)info.st_size;
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping keeps the file open
+        data = view == MAP_FAILED ? nullptr : (const unsigned char*)view;
+#endif
+        if (!data)
+            size = 0;
+        return data != nullptr;
+    }
+
+    void Close()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#else
+        if (data)
+            munmap((void*)data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const unsigned char* Data() const { return data; }
+    size_t Size() const { return size; }
+
+private:
+    const unsigned char* data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// Pad with zeros to the next 8-byte boundary
+inline void AlignFile(std::ofstream& file)
+{
+    static const char zeros[8] = {};
+    file.write(zeros, (8 - (unsigned long long)file.tellp() % 8) % 8);
+}
+
+// Re-simulate a recorded session and write it as a seekable file with a
+// keyframe every interval ticks
+inline bool WriteSeekableReplay(const SessionLog& log, const char* path, unsigned interval = DEFAULT_KEYFRAME_INTERVAL)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file || interval == 0)
+    {
+        std::cout << "ERROR::REPLAY::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+    unsigned header[5] = { SEEK_VERSION, log.seed, log.tickCount, interval, (unsigned)sizeof(GameState) };
+    file.write("BRKS", 4);
+    file.write((const char*)header, sizeof(header));
+
+    GameState state;
+    ResetGame(state, log.seed);
+    SessionLog::Reader reader(log);
+    FrameArena scratch(TICK_SCRATCH_BYTES);
+    std::vector<unsigned char> compressed(LzBound(sizeof(GameState)));
+    std::vector<SeekIndexEntry> index;
+
+    TickInput tickInput;
+    unsigned tick = 0;
+    while (tick < log.tickCount)
+    {
+        SeekIndexEntry entry;
+        entry.tick = tick;
+        entry.keyframeOffset = (unsigned long long)file.tellp();
+        entry.keyframeSize = (unsigned)LzCompress((const unsigned char*)&state, sizeof(GameState), compressed.data());
+        file.write((const char*)compressed.data(), entry.keyframeSize);
+
+        SessionLog segment;
+        segment.Begin(log.seed);
+        for (unsigned t = 0; t < interval && reader.NextTick(tickInput); t++, tick++)
+        {
+            StepGame(state, tickInput, scratch);
+            segment.RecordTick(tickInput, 0);
+        }
+        entry.tickCount = segment.tickCount;
+        entry.inputOffset = (unsigned long long)file.tellp();
+        entry.inputSize = (unsigned)segment.input.size();
+        file.write((const char*)segment.input.data(), segment.input.size());
+        index.push_back(entry);
+    }
+
+    SeekFooter footer;
+    AlignFile(file);
+    footer.hashesOffset = (unsigned long long)file.tellp();
+    file.write((const char*)log.hashes.data(), log.hashes.size() * sizeof(unsigned));
+    AlignFile(file);
+    footer.indexOffset = (unsigned long long)file.tellp();
+    file.write((const char*)index.data(), index.size() * sizeof(SeekIndexEntry));
+    footer.segmentCount = (unsigned)index.size();
+    memcpy(footer.magic, "BRKI", 4);
+    file.write((const char*)&footer, sizeof(footer));
+    return (bool)file;
+}
+
+class SeekableReplay
+{
+public:
+    SeekableReplay() : seed(0), tickCount(0), interval(0), index(nullptr), hashes(nullptr), segmentCount(0) {}
+
+    bool Open(const char* path)
+    {
+        if (!map.Open(path))
+        {
+            std::cout << "ERROR::REPLAY::CANNOT_MAP " << path << std::endl;
+            return false;
+        }
+        const unsigned char* data = map.Data();
+        size_t size = map.Size();
+
+        unsigned header[5];
+        SeekFooter footer;
+        if (size < 4 + sizeof(header) + sizeof(footer) || memcmp(data, "BRKS", 4) != 0)
+            return Fail(path, "BAD_FILE");
+        memcpy(header, data + 4, sizeof(header));
+        memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+        if (header[0] != SEEK_VERSION || memcmp(footer.magic, "BRKI", 4) != 0)
+            return Fail(path, "BAD_FILE");
+        if (header[4] != sizeof(GameState))
+            return Fail(path, "DIFFERENT_STATE_LAYOUT");
+
+        seed = header[1];
+        tickCount = header[2];
+        interval = header[3];
+        segmentCount = footer.segmentCount;
+        unsigned long long body = size - sizeof(footer);
+        if (footer.indexOffset > body || footer.hashesOffset > footer.indexOffset ||
+            segmentCount > (body - footer.indexOffset) / sizeof(SeekIndexEntry) ||
+            tickCount > (footer.indexOffset - footer.hashesOffset) / sizeof(unsigned))
+            return Fail(path, "TRUNCATED");
+        // Both are read in place; the mapping itself is page aligned
+        if (footer.indexOffset % alignof(SeekIndexEntry) != 0 || footer.hashesOffset % alignof(unsigned) != 0)
+            return Fail(path, "BAD_FILE");
+        index = (const SeekIndexEntry*)(data + footer.indexOffset);
+        hashes = (const unsigned*)(data + footer.hashesOffset);
+        return true;
+    }
+
+    // Put state where the game was after tick ticks (0 = before the first
+    // tick). Returns the ticks simulated after the keyframe, or -1.
+    int Seek(unsigned tick, GameState& state, FrameArena& scratch) const
+    {
+        if (!index || tick > tickCount || segmentCount == 0)
+            return -1;
+
+        // Last keyframe at or before tick
+        unsigned low = 0, high = segmentCount;
+        while (high - low > 1)
+        {
+            unsigned mid = (low + high) / 2;
+            if (index[mid].tick <= tick)
+                low = mid;
+            else
+                high = mid;
+        }
+        return SimulateFrom(low, tick, state, scratch);
+    }
+
+    // Restore the keyframe of segment and simulate from there to tick,
+    // reading the input of as many segments as that takes. Seek uses the
+    // nearest keyframe; SimulateFrom(0, ...) is what a file without
+    // keyframes would cost. Returns the ticks simulated, or -1.
+    int SimulateFrom(unsigned segment, unsigned tick, GameState& state, FrameArena& scratch) const
+    {
+        if (!index || segment >= segmentCount || tick > tickCount || tick < index[segment].tick)
+            return -1;
+        const SeekIndexEntry& keyframe = index[segment];
+        if (!InFile(keyframe.keyframeOffset, keyframe.keyframeSize) ||
+            LzDecompress(map.Data() + keyframe.keyframeOffset, keyframe.keyframeSize, (unsigned char*)&state, sizeof(GameState)) != (long long)sizeof(GameState))
+            return -1;
+
+        // The keyframe is a memory image from disk; refuse one whose counts
+        // or indices would take StepGame out of bounds
+        if (!ValidGameState(state))
+            return -1;
+
+        // Counted in session ticks: after game over StepGame leaves
+        // state.tick alone while the recording goes on
+        int simulated = 0;
+        for (unsigned s = segment; s < segmentCount && keyframe.tick + simulated < tick; s++)
+        {
+            const SeekIndexEntry& entry = index[s];
+            if (!InFile(entry.inputOffset, entry.inputSize))
+                return -1;
+            SessionLog::Reader reader(map.Data() + entry.inputOffset, entry.inputSize, entry.tickCount);
+            TickInput tickInput;
+            while (keyframe.tick + simulated < tick && reader.NextTick(tickInput))
+            {
+                StepGame(state, tickInput, scratch);
+                simulated++;
+            }
+        }
+        return simulated;
+    }
+
+    // Recorded state hash after tick (1-based, like SessionLog::hashes).
+    // False for tick 0 and past the end, which have none.
+    bool HashAfter(unsigned tick, unsigned& hash) const
+    {
+        if (!hashes || tick == 0 || tick > tickCount)
+            return false;
+        hash = hashes[tick - 1];
+        return true;
+    }
+
+    unsigned Seed() const { return seed; }
+    unsigned TickCount() const { return tickCount; }
+    unsigned Interval() const { return interval; }
+    unsigned SegmentCount() const { return segmentCount; }
+    const SeekIndexEntry& Segment(unsigned i) const { return index[i]; }
+    size_t FileSize() const { return map.Size(); }
+
+private:
+    MappedFile map;
+    unsigned seed;
+    unsigned tickCount;
+    unsigned interval;
+    const SeekIndexEntry* index;
+    const unsigned* hashes;
+    unsigned segmentCount;
+
+    bool InFile(unsigned long long offset, unsigned long long size) const
+    {
+        return offset <= map.Size() && size <= map.Size() - offset;
+    }
+
+    bool Fail(const char* path, const char* reason)
+    {
+        std::cout << "ERROR::REPLAY::" << reason << " " << path << std::endl;
+        map.Close();
+        index = nullptr;
+        hashes = nullptr;
+        return false;
+    }
+};
+
+#endif
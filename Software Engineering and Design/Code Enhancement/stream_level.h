@@ -0,0 +1,184 @@
+//=============================================================================
+// File Name: stream_level.h
+// Version: 1.0
+//
+// Description: Endless climbing mode on top of the chunk streamer
+// (chunk_streamer.h). The view scrolls up at a steady rate. The paddle
+// rides along the bottom of the view, and the ball breaks the bricks of
+// whatever chunks are resident. Only the chunks around the view are kept,
+// so the level has no height limit and memory does not grow with it.
+//
+// The mode keeps its own small state rather than GameState, whose twelve
+// bricks and fixed pools are what replays, rollback and the network
+// protocol depend on.
+//=============================================================================
+
+#ifndef STREAM_LEVEL_H
+#define STREAM_LEVEL_H
+
+#ifndef BRICK_HEADLESS
+#include <GLFW\glfw3.h>
+#endif
+#include "chunk_streamer.h"
+
+const float LEVEL_SCROLL_SPEED = 0.12f;   // world units per second
+const float LEVEL_BALL_SPEED = 1.1f;
+const float LEVEL_BALL_RADIUS = 0.025f;
+const float LEVEL_PADDLE_HALF_WIDTH = 0.15f;
+const float LEVEL_PADDLE_SPEED = 1.8f;
+const size_t LEVEL_CHUNK_BUDGET = 64 * 1024; // bytes of resident chunks
+
+struct LevelInput {
+    bool left;
+    bool right;
+};
+
+class StreamLevel
+{
+public:
+    StreamLevel(unsigned seed, size_t budgetBytes = LEVEL_CHUNK_BUDGET, const char* directory = NULL)
+        : streamer(seed, budgetBytes, directory), cameraY(0.0f), paddleX(0.0f), lives(3), score(0)
+    {
+        ServeBall();
+    }
+
+    // Advance one fixed tick
+    void Step(const LevelInput& input)
+    {
+        const float dt = (float)SIM_TICK;
+        if (lives == 0)
+            return;
+        cameraY += LEVEL_SCROLL_SPEED * dt;
+        streamer.Update(ViewBottom(), ViewTop());
+
+        if (input.left)
+            paddleX -= LEVEL_PADDLE_SPEED * dt;
+        if (input.right)
+            paddleX += LEVEL_PADDLE_SPEED * dt;
+        float limit = 1.0f - LEVEL_PADDLE_HALF_WIDTH;
+        paddleX = paddleX < -limit ? -limit : (paddleX > limit ? limit : paddleX);
+
+        ballX += ballDX * dt;
+        ballY += ballDY * dt;
+        if ((ballX < -1.0f + LEVEL_BALL_RADIUS && ballDX < 0.0f) || (ballX > 1.0f - LEVEL_BALL_RADIUS && ballDX > 0.0f))
+            ballDX = -ballDX;
+        if (ballY > ViewTop() - LEVEL_BALL_RADIUS && ballDY > 0.0f)
+            ballDY = -ballDY;
+
+        // Paddle: the bounce angle follows where the ball lands on it
+        float paddleY = PaddleY();
+        if (ballDY < 0.0f && ballY - LEVEL_BALL_RADIUS < paddleY && ballY > paddleY - 0.05f &&
+            fabsf(ballX - paddleX) < LEVEL_PADDLE_HALF_WIDTH + LEVEL_BALL_RADIUS)
+        {
+            float offset = (ballX - paddleX) / (LEVEL_PADDLE_HALF_WIDTH + LEVEL_BALL_RADIUS);
+            ballDX = offset * LEVEL_BALL_SPEED * 0.8f;
+            ballDY = sqrtf(LEVEL_BALL_SPEED * LEVEL_BALL_SPEED - ballDX * ballDX);
+        }
+
+        HitBricks();
+
+        if (ballY < ViewBottom())
+        {
+            lives--;
+            if (lives > 0)
+                ServeBall();
+        }
+    }
+
+#ifndef BRICK_HEADLESS
+    void Draw()
+    {
+        glPushMatrix();
+        glTranslatef(0.0f, -cameraY, 0.0f);
+        for (int index = ChunkAt(ViewBottom()); index <= ChunkAt(ViewTop()); index++)
+        {
+            const LevelChunk* chunk = streamer.Find(index);
+            if (!chunk)
+                continue;
+            for (int i = 0; i < chunk->brickCount; i++)
+            {
+                const ChunkBrick& brick = chunk->bricks[i];
+                if (brick.onoff == OFF)
+                    continue;
+                glColor3f(brick.red, brick.green, brick.blue);
+                glRectf(brick.x - brick.halfSize * 2.0f, brick.y - brick.halfSize, brick.x + brick.halfSize * 2.0f, brick.y + brick.halfSize);
+            }
+        }
+
+        glColor3f(0.0f, 1.0f, 0.0f);
+        glRectf(paddleX - LEVEL_PADDLE_HALF_WIDTH, PaddleY() - 0.03f, paddleX + LEVEL_PADDLE_HALF_WIDTH, PaddleY());
+
+        glColor3f(1.0f, 1.0f, 1.0f);
+        glBegin(GL_POLYGON);
+        for (int i = 0; i < 16; i++)
+        {
+            float angle = i * 6.2831853f / 16;
+            glVertex2f(ballX + cosf(angle) * LEVEL_BALL_RADIUS, ballY + sinf(angle) * LEVEL_BALL_RADIUS);
+        }
+        glEnd();
+        glPopMatrix();
+    }
+#endif
+
+    float ViewBottom() const { return cameraY - 1.0f; }
+    float ViewTop() const { return cameraY + 1.0f; }
+    float Height() const { return cameraY; }
+    int Lives() const { return lives; }
+    int Score() const { return score; }
+    ChunkStreamer& Streamer() { return streamer; }
+
+private:
+    ChunkStreamer streamer;
+    float cameraY;
+    float paddleX;
+    float ballX, ballY, ballDX, ballDY;
+    int lives;
+    int score;
+
+    float PaddleY() const { return ViewBottom() + 0.1f; }
+
+    void ServeBall()
+    {
+        ballX = paddleX;
+        ballY = PaddleY() + LEVEL_BALL_RADIUS;
+        ballDX = LEVEL_BALL_SPEED * 0.3f;
+        ballDY = sqrtf(LEVEL_BALL_SPEED * LEVEL_BALL_SPEED - ballDX * ballDX);
+    }
+
+    // Bounce off the first brick the ball overlaps, in the chunks it touches.
+    // Bricks are twice as wide as tall, as drawn.
+    void HitBricks()
+    {
+        for (int index = ChunkAt(ballY - LEVEL_BALL_RADIUS); index <= ChunkAt(ballY + LEVEL_BALL_RADIUS); index++)
+        {
+            LevelChunk* chunk = streamer.Find(index);
+            if (!chunk)
+                continue; // still loading: nothing to hit yet
+            for (int i = 0; i < chunk->brickCount; i++)
+            {
+                ChunkBrick& brick = chunk->bricks[i];
+                float overlapX = brick.halfSize * 2.0f + LEVEL_BALL_RADIUS - fabsf(ballX - brick.x);
+                float overlapY = brick.halfSize + LEVEL_BALL_RADIUS - fabsf(ballY - brick.y);
+                if (brick.onoff == OFF || overlapX <= 0.0f || overlapY <= 0.0f)
+                    continue;
+
+                if (overlapX < overlapY)
+                    ballDX = ballX < brick.x ? -fabsf(ballDX) : fabsf(ballDX);
+                else
+                    ballDY = ballY < brick.y ? -fabsf(ballDY) : fabsf(ballDY);
+                if (brick.type == DESTRUCTABLE)
+                {
+                    if (--brick.hitPoints == 0)
+                    {
+                        brick.onoff = OFF;
+                        score++;
+                    }
+                    streamer.MarkDirty(*chunk);
+                }
+                return;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+//=============================================================================
+// File Name: triple_buffer.h
+// Version: 1.0
+//
+// Description: Lock-free single-producer / single-consumer triple buffer.
+// The simulation thread fills the back slot and publishes it; the render
+// thread picks up the most recently published slot. Neither side ever waits
+// on the other, and a slot is never written while the reader holds it, so a
+// published snapshot is immutable for as long as the reader uses it.
+//
+// Algorithmic Logic:
+// - Three slots: one owned by the writer (back), one by the reader (front)
+//   and one parked in the middle.
+// - Publish() swaps back with middle and sets a "fresh" bit.
+// - Consume() swaps front with middle only if the fresh bit is set, so the
+//   reader always sees the newest state and stale states are dropped.
+//=============================================================================
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() : slots(), back(0), front(1), middle(2) {}
+
+    // Writer side: the slot to fill before calling Publish().
+    T& WriteSlot() { return slots[back]; }
+
+    // Writer side: make the write slot visible to the reader.
+    void Publish()
+    {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader side: switch to the newest published slot if there is one.
+    // Returns true when the slot changed since the last call.
+    bool Consume()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    // Reader side: the slot obtained by the last Consume().
+    const T& ReadSlot() const { return slots[front]; }
+
+private:
+    static const int FRESH = 4;
+    static const int INDEX_MASK = 3;
+
+    T slots[3];
+    int back;
+    int front;
+    std::atomic<int> middle;
+};
+
+#endif